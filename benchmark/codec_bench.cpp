@@ -0,0 +1,336 @@
+/**
+ * Micro-benchmarks of every CODECFactory and IntersectionFactory scheme on
+ * sorted lists from the synthetic.h generators, to pick codecs with data.
+ *
+ *   hellcat_codec_bench [--format csv|json]
+ *                       [--distributions uniform,clustered,zipfian]
+ *                       [--densities 0.001,0.01,0.1,0.5]
+ *                       [--sizes 1000,100000,1000000]
+ *                       [--ratios 1,10,100,1000]
+ *                       [--codecs name,...] [--intersections name,...]
+ *                       [--repeat 3] [--seed 1]
+ *
+ * A list of size n and density d holds n integers out of [0, n / d). For
+ * zipfian lists the gaps follow a Zipf law instead, with the same mean
+ * gap, so most gaps are small and a few are very large, as in the
+ * posting lists of frequent terms.
+ *
+ * One row per codec and list: bits/int and encode/decode speed in
+ * millions of integers per second. One row per intersection and pair of
+ * lists, the smaller of size n, the larger of size n * ratio, both of
+ * density d: speed in millions of input integers per second. Every
+ * measurement is repeated until at least 10 million integers went
+ * through, and at least --repeat times, decoded lists and intersections
+ * are checked against the input.
+ */
+
+#include "../src/simd_compression/codecfactory.h"
+#include "../src/simd_compression/intersection.h"
+#include "../src/simd_compression/synthetic.h"
+#include "../src/simd_compression/timer.h"
+
+using namespace std;
+
+struct Options {
+    string format;
+    vector<string> distributions;
+    vector<double> densities;
+    vector<uint32_t> sizes;
+    vector<uint32_t> ratios;
+    vector<string> codecs;
+    vector<string> intersections;
+    size_t repeat;
+    uint32_t seed;
+
+    Options() :
+        format("csv"), distributions( { "uniform", "clustered", "zipfian" }),
+        densities( { 0.001, 0.01, 0.1, 0.5 }), sizes( { 1000, 100000, 1000000 }),
+        ratios( { 1, 10, 100, 1000 }), codecs(CODECFactory::allNames()),
+        intersections(IntersectionFactory::allNames()), repeat(3), seed(1) {
+    }
+};
+
+static vector<string> split(const string &list) {
+    vector<string> ans;
+    stringstream in(list);
+    string item;
+    while (getline(in, item, ','))
+        if (!item.empty())
+            ans.push_back(item);
+    return ans;
+}
+
+template <class T>
+static vector<T> splitNumbers(const string &list) {
+    vector<T> ans;
+    for (const string &item : split(list))
+        ans.push_back(static_cast<T>(stod(item)));
+    return ans;
+}
+
+static void usage(const char *program) {
+    cerr << "usage: " << program << " [--format csv|json] [--distributions uniform,clustered,zipfian]"
+         << " [--densities d,...] [--sizes n,...] [--ratios r,...] [--codecs name,...]"
+         << " [--intersections name,...] [--repeat n] [--seed n]" << endl;
+    cerr << "codecs:";
+    for (const string &name : CODECFactory::allNames())
+        cerr << " " << name;
+    cerr << endl << "intersections:";
+    for (const string &name : IntersectionFactory::allNames())
+        cerr << " " << name;
+    cerr << endl;
+}
+
+static bool parse(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const string flag = argv[i];
+        if (flag == "--help" or i + 1 == argc)
+            return false;
+        const string value = argv[++i];
+        if (flag == "--format")
+            options.format = value;
+        else if (flag == "--distributions")
+            options.distributions = split(value);
+        else if (flag == "--densities")
+            options.densities = splitNumbers<double>(value);
+        else if (flag == "--sizes")
+            options.sizes = splitNumbers<uint32_t>(value);
+        else if (flag == "--ratios")
+            options.ratios = splitNumbers<uint32_t>(value);
+        else if (flag == "--codecs")
+            options.codecs = split(value);
+        else if (flag == "--intersections")
+            options.intersections = split(value);
+        else if (flag == "--repeat")
+            options.repeat = static_cast<size_t>(stoul(value));
+        else if (flag == "--seed")
+            options.seed = static_cast<uint32_t>(stoul(value));
+        else
+            return false;
+    }
+    if (options.format != "csv" and options.format != "json")
+        return false;
+    for (const string &name : options.codecs)
+        if (!CODECFactory::valid(name))
+            return false;
+    for (const string &name : options.intersections)
+        if (!IntersectionFactory::valid(name))
+            return false;
+    for (double density : options.densities)
+        if (density <= 0 or density > 1)
+            return false;
+    return true;
+}
+
+/**
+ * n sorted distinct integers, density n / Max.
+ */
+static vector<uint32_t> generate(const string &distribution, uint32_t n, double density, uint32_t seed) {
+    const double range = n / density;
+    if (range >= 4294967296.0)
+        throw runtime_error("list too sparse for 32-bit integers");
+    const uint32_t Max = static_cast<uint32_t>(range);
+    if (distribution == "uniform") {
+        UniformDataGenerator gen(seed);
+        return gen.generate(n, Max);
+    }
+    if (distribution == "clustered") {
+        ClusteredDataGenerator gen(seed);
+        return gen.generate(n, Max);
+    }
+    if (distribution == "zipfian") {
+        // gaps of 1 to 2 * meangap with Zipf probabilities, scaled so the
+        // mean gap is Max / n
+        const uint32_t meangap = max<uint32_t>(static_cast<uint32_t>(1 / density), 1);
+        ZipfianGenerator gen(seed);
+        gen.init(std::min<uint32_t>(2 * meangap, 1 << 20), 1.0);
+        vector<double> gaps(n);
+        double total = 0;
+        for (uint32_t k = 0; k < n; ++k)
+            total += gaps[k] = 1 + gen.nextInt();
+        const double scale = total > n ? (range - n) / (total - n) : 0;
+        vector<uint32_t> ans(n);
+        double value = -1;
+        for (uint32_t k = 0; k < n; ++k) {
+            value += 1 + (gaps[k] - 1) * scale;
+            ans[k] = static_cast<uint32_t>(value);
+            // rounding can make two integers equal
+            if (k > 0 and ans[k] <= ans[k - 1])
+                ans[k] = ans[k - 1] + 1;
+        }
+        return ans;
+    }
+    throw runtime_error("unknown distribution " + distribution);
+}
+
+/**
+ * Rows are written as they are measured, in CSV or as a JSON array.
+ */
+class Report {
+public:
+    Report(const string &format) : json(format == "json"), rows(0) {
+        if (json)
+            cout << "[" << endl;
+        else
+            cout << "kind,scheme,distribution,density,size,ratio,bits_per_int,encode_mis,decode_mis,result,mis" << endl;
+    }
+
+    ~Report() {
+        if (json)
+            cout << endl << "]" << endl;
+    }
+
+    void codec(const string &scheme, const string &distribution, double density, size_t size,
+               double bitsperint, double encodemis, double decodemis) {
+        if (json) {
+            begin();
+            cout << "{\"kind\":\"codec\",\"scheme\":\"" << scheme << "\",\"distribution\":\"" << distribution
+                 << "\",\"density\":" << density << ",\"size\":" << size << ",\"bits_per_int\":" << bitsperint
+                 << ",\"encode_mis\":" << encodemis << ",\"decode_mis\":" << decodemis << "}";
+        } else {
+            cout << "codec," << scheme << "," << distribution << "," << density << "," << size << ",,"
+                 << bitsperint << "," << encodemis << "," << decodemis << ",," << endl;
+        }
+    }
+
+    void intersection(const string &scheme, const string &distribution, double density, size_t size,
+                      uint32_t ratio, size_t result, double mis) {
+        if (json) {
+            begin();
+            cout << "{\"kind\":\"intersection\",\"scheme\":\"" << scheme << "\",\"distribution\":\"" << distribution
+                 << "\",\"density\":" << density << ",\"size\":" << size << ",\"ratio\":" << ratio
+                 << ",\"result\":" << result << ",\"mis\":" << mis << "}";
+        } else {
+            cout << "intersection," << scheme << "," << distribution << "," << density << "," << size << ","
+                 << ratio << ",,,," << result << "," << mis << endl;
+        }
+    }
+
+private:
+    const bool json;
+    size_t rows;
+
+    void begin() {
+        if (rows++ > 0)
+            cout << "," << endl;
+    }
+};
+
+static size_t repetitions(size_t n, size_t repeat) {
+    const size_t minimum = 10 * 1000 * 1000;
+    return max<size_t>(repeat, (minimum + n - 1) / max<size_t>(n, 1));
+}
+
+static double mis(size_t integers, uint64_t microseconds) {
+    return static_cast<double>(integers) / static_cast<double>(max<uint64_t>(microseconds, 1));
+}
+
+static void benchCodec(IntegerCODEC &codec, const string &scheme, const vector<uint32_t> &data,
+                       const string &distribution, double density, size_t repeat, Report &report) {
+    const size_t n = data.size();
+    const size_t reps = repetitions(n, repeat);
+    // Some codecs encode in place, every repetition gets its own copy
+    // made ahead of the clock. Long lists get fewer copies, reused.
+    const size_t copies = std::min<size_t>(reps, max<size_t>(1, (64 << 20) / max<size_t>(n, 1)));
+    vector<vector<uint32_t>> inputs(copies, data);
+    vector<uint32_t> compressed(2 * n + 4096);
+    size_t words = 0;
+    WallClockTimer timer;
+    uint64_t encodetime = 0;
+    for (size_t r = 0; r < reps; r += copies) {
+        const size_t batch = std::min<size_t>(copies, reps - r);
+        timer.reset();
+        for (size_t c = 0; c < batch; ++c) {
+            words = compressed.size();
+            codec.encodeArray(inputs[c].data(), n, compressed.data(), words);
+        }
+        encodetime += timer.split();
+        for (size_t c = 0; c < batch; ++c)
+            inputs[c] = data;
+    }
+    vector<uint32_t> recovered(n + 4096);
+    size_t count = 0;
+    timer.reset();
+    for (size_t r = 0; r < reps; ++r) {
+        count = recovered.size();
+        codec.decodeArray(compressed.data(), words, recovered.data(), count);
+    }
+    const uint64_t decodetime = timer.split();
+    recovered.resize(count);
+    if (recovered != data)
+        throw runtime_error(scheme + " did not decode what it encoded");
+    report.codec(scheme, distribution, density, n, 32.0 * words / max<size_t>(n, 1),
+                 mis(n * reps, encodetime), mis(n * reps, decodetime));
+}
+
+static void benchIntersection(intersectionfunction function, const string &scheme, const vector<uint32_t> &small,
+                              const vector<uint32_t> &large, const string &distribution, double density,
+                              uint32_t ratio, size_t repeat, Report &report) {
+    const vector<uint32_t> expected = intersect(small, large);
+    vector<uint32_t> out(small.size() + 4096);
+    const size_t reps = repetitions(small.size() + large.size(), repeat);
+    size_t result = 0;
+    WallClockTimer timer;
+    for (size_t r = 0; r < reps; ++r)
+        result = function(small.data(), small.size(), large.data(), large.size(), out.data());
+    const uint64_t time = timer.split();
+    out.resize(result);
+    if (out != expected)
+        throw runtime_error(scheme + " did not find the intersection");
+    report.intersection(scheme, distribution, density, small.size(), ratio, result,
+                        mis((small.size() + large.size()) * reps, time));
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+    cout << setprecision(4);
+    cerr << "intersections dispatch to " << IntersectionFactory::selected() << endl;
+    Report report(options.format);
+    uint32_t seed = options.seed;
+    for (const string &distribution : options.distributions) {
+        for (double density : options.densities) {
+            for (uint32_t size : options.sizes) {
+                vector<uint32_t> data;
+                try {
+                    data = generate(distribution, size, density, seed++);
+                } catch (const exception &e) {
+                    cerr << "skipping " << distribution << " " << density << " " << size << ": " << e.what() << endl;
+                    continue;
+                }
+                for (const string &name : options.codecs) {
+                    try {
+                        benchCodec(*CODECFactory::getFromName(name), name, data, distribution, density,
+                                   options.repeat, report);
+                    } catch (const exception &e) {
+                        cerr << name << " failed on " << distribution << " " << density << " " << size << ": "
+                             << e.what() << endl;
+                    }
+                }
+                for (uint32_t ratio : options.ratios) {
+                    vector<uint32_t> large;
+                    try {
+                        large = generate(distribution, size * ratio, density, seed++);
+                    } catch (const exception &e) {
+                        cerr << "skipping " << distribution << " " << density << " " << size << " x" << ratio
+                             << ": " << e.what() << endl;
+                        continue;
+                    }
+                    for (const string &name : options.intersections) {
+                        try {
+                            benchIntersection(IntersectionFactory::getFromName(name), name, data, large,
+                                              distribution, density, ratio, options.repeat, report);
+                        } catch (const exception &e) {
+                            cerr << name << " failed on " << distribution << " " << density << " " << size
+                                 << " x" << ratio << ": " << e.what() << endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include "string_ref.h"
 
 using namespace std;
@@ -11,6 +12,23 @@ typedef struct
     uint32_t value_length;
 } hcat_keypair;
 
+class hcat_transaction;
+
+// Follows the transactions it is added to, for state kept in memory next
+// to what they write.
+class hcat_transaction_listener
+{
+public:
+    virtual ~hcat_transaction_listener() { };
+
+    // Right before the commit, what is written to tx commits with it.
+    virtual void committing(hcat_transaction* tx) { };
+    virtual void committed(hcat_transaction* tx) { };
+
+    // Also called when the commit fails.
+    virtual void aborted(hcat_transaction* tx) { };
+};
+
 class hcat_transaction
 {
 public:
@@ -19,6 +37,14 @@ public:
     virtual int abort() = 0;
     virtual int get(hcat_keypair* pair) = 0;
     virtual int set(hcat_keypair* pair) = 0;
+
+    // Calls visit with the pairs of pair->keyspace from pair->key on, in
+    // key order, until it returns false. The pair is reused for each one.
+    virtual int scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit) = 0;
+
+    // Calls the listener back when the transaction ends, once however
+    // many times it was added.
+    virtual void add_listener(hcat_transaction_listener* listener) = 0;
 };
 
 #define HCAT_SUCCESS              0
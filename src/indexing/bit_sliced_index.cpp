@@ -0,0 +1,245 @@
+#include <string.h>
+#include "bit_sliced_index.h"
+#include "../simd_compression/boolarray.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        typedef struct
+        {
+            BoolArray exists;
+            std::vector<BoolArray> slices;
+        } bsi_chunk;
+
+        static const size_t chunk_words = BitSlicedIndex::ChunkSize / 64;
+        static const size_t chunk_header_size = 2 * sizeof(uint32_t);
+
+        static std::string chunk_key(const std::string& prefix, uint32_t chunk)
+        {
+            return prefix + ":" + std::to_string(chunk);
+        }
+
+        static void load_chunk(std::string_ref keyspace, const std::string& key, hcat_transaction* tx, bsi_chunk& chunk)
+        {
+            chunk.exists = BoolArray(BitSlicedIndex::ChunkSize);
+            chunk.slices.clear();
+
+            hcat_keypair pair;
+            pair.keyspace = keyspace;
+            pair.key = key;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return;
+            }
+            const uint8_t* value = reinterpret_cast<const uint8_t*>(pair.value);
+            uint32_t slice_count;
+            memcpy(&slice_count, value, sizeof(slice_count));
+            value += chunk_header_size;
+            memcpy(chunk.exists.buffer.data(), value, chunk_words * sizeof(uint64_t));
+            chunk.slices.resize(slice_count, BoolArray(BitSlicedIndex::ChunkSize));
+            for (uint32_t i = 0; i < slice_count; i++)
+            {
+                value += chunk_words * sizeof(uint64_t);
+                memcpy(chunk.slices[i].buffer.data(), value, chunk_words * sizeof(uint64_t));
+            }
+        }
+
+        static void store_chunk(std::string_ref keyspace, const std::string& key, const bsi_chunk& chunk, hcat_transaction* tx)
+        {
+            uint32_t header[2] = { static_cast<uint32_t>(chunk.slices.size()), 0 };
+            std::vector<uint8_t> value(chunk_header_size + (chunk.slices.size() + 1) * chunk_words * sizeof(uint64_t));
+            uint8_t* position = value.data();
+            memcpy(position, header, chunk_header_size);
+            position += chunk_header_size;
+            memcpy(position, chunk.exists.buffer.data(), chunk_words * sizeof(uint64_t));
+            for (auto& slice : chunk.slices)
+            {
+                position += chunk_words * sizeof(uint64_t);
+                memcpy(position, slice.buffer.data(), chunk_words * sizeof(uint64_t));
+            }
+
+            hcat_keypair pair;
+            pair.keyspace = keyspace;
+            pair.key = key;
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size());
+            tx->set(&pair);
+        }
+
+        // Records of the chunk with a value <= bound.
+        static void less_equal(const bsi_chunk& chunk, uint64_t bound, BoolArray& result)
+        {
+            size_t slice_count = chunk.slices.size();
+            result = chunk.exists;
+            if (slice_count < 64 && (bound >> slice_count) != 0)
+            {
+                // The bound doesn't fit in the slices, every value is below.
+                return;
+            }
+
+            // equal holds the records whose bits above i match the bound, a
+            // 0 in a record where the bound has a 1 makes it less.
+            BoolArray less(BitSlicedIndex::ChunkSize);
+            BoolArray& equal = result;
+            BoolArray below;
+            for (size_t i = slice_count; i-- > 0;)
+            {
+                if (bound & (static_cast<uint64_t>(1) << i))
+                {
+                    below = equal;
+                    below.SIMDinplaceAndNot(chunk.slices[i]);
+                    less.SIMDinplaceUnion(below);
+                    equal.SIMDinplaceIntersect(chunk.slices[i]);
+                }
+                else
+                {
+                    equal.SIMDinplaceAndNot(chunk.slices[i]);
+                }
+            }
+            result.SIMDinplaceUnion(less);
+        }
+
+        BitSlicedIndex::BitSlicedIndex(std::string_ref keyspace, std::string_ref field) :
+            keyspace(keyspace), prefix("$bsi:" + field.str())
+        {
+        }
+
+        BitSlicedIndex::~BitSlicedIndex()
+        {
+        }
+
+        uint32_t BitSlicedIndex::GetChunkCount(hcat_transaction* tx)
+        {
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = prefix;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return 0;
+            }
+            uint32_t count;
+            memcpy(&count, pair.value, sizeof(count));
+            return count;
+        }
+
+        void BitSlicedIndex::Set(uint32_t record_id, uint64_t value, hcat_transaction* tx)
+        {
+            uint32_t chunk_id = record_id / ChunkSize;
+            size_t bit = record_id % ChunkSize;
+            std::string key = chunk_key(prefix, chunk_id);
+            bsi_chunk chunk;
+            load_chunk(this->keyspace, key, tx, chunk);
+
+            size_t bits = 0;
+            while (bits < 64 && (value >> bits) != 0)
+            {
+                bits++;
+            }
+            if (chunk.slices.size() < bits)
+            {
+                chunk.slices.resize(bits, BoolArray(ChunkSize));
+            }
+            chunk.exists.set(bit);
+            for (size_t i = 0; i < chunk.slices.size(); i++)
+            {
+                if (value & (static_cast<uint64_t>(1) << i))
+                {
+                    chunk.slices[i].set(bit);
+                }
+                else
+                {
+                    chunk.slices[i].unset(bit);
+                }
+            }
+            store_chunk(this->keyspace, key, chunk, tx);
+
+            uint32_t count = GetChunkCount(tx);
+            if (chunk_id >= count)
+            {
+                count = chunk_id + 1;
+                hcat_keypair pair;
+                pair.keyspace = this->keyspace;
+                pair.key = prefix;
+                pair.value = &count;
+                pair.value_length = sizeof(count);
+                tx->set(&pair);
+            }
+        }
+
+        void BitSlicedIndex::Remove(uint32_t record_id, hcat_transaction* tx)
+        {
+            std::string key = chunk_key(prefix, record_id / ChunkSize);
+            size_t bit = record_id % ChunkSize;
+            bsi_chunk chunk;
+            load_chunk(this->keyspace, key, tx, chunk);
+            if (!chunk.exists.get(bit))
+            {
+                return;
+            }
+            chunk.exists.unset(bit);
+            for (auto& slice : chunk.slices)
+            {
+                slice.unset(bit);
+            }
+            store_chunk(this->keyspace, key, chunk, tx);
+        }
+
+        bool BitSlicedIndex::Get(uint32_t record_id, hcat_transaction* tx, uint64_t& value)
+        {
+            bsi_chunk chunk;
+            load_chunk(this->keyspace, chunk_key(prefix, record_id / ChunkSize), tx, chunk);
+            size_t bit = record_id % ChunkSize;
+            value = 0;
+            if (!chunk.exists.get(bit))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < chunk.slices.size(); i++)
+            {
+                if (chunk.slices[i].get(bit))
+                {
+                    value |= static_cast<uint64_t>(1) << i;
+                }
+            }
+            return true;
+        }
+
+        void BitSlicedIndex::Range(uint64_t low, uint64_t high, hcat_transaction* tx, BoolArray& records)
+        {
+            uint32_t chunk_count = GetChunkCount(tx);
+            records = BoolArray(static_cast<size_t>(chunk_count) * ChunkSize);
+            if (low > high)
+            {
+                return;
+            }
+
+            bsi_chunk chunk;
+            BoolArray matches;
+            BoolArray excluded;
+            for (uint32_t c = 0; c < chunk_count; c++)
+            {
+                load_chunk(this->keyspace, chunk_key(prefix, c), tx, chunk);
+                less_equal(chunk, high, matches);
+                if (low > 0)
+                {
+                    less_equal(chunk, low - 1, excluded);
+                    matches.SIMDinplaceAndNot(excluded);
+                }
+                memcpy(records.buffer.data() + c * chunk_words, matches.buffer.data(), chunk_words * sizeof(uint64_t));
+            }
+        }
+
+        void BitSlicedIndex::Range(uint64_t low, uint64_t high, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            BoolArray records;
+            Range(low, high, tx, records);
+            record_ids.resize(records.sizeInBits());
+            record_ids.resize(records.toInts(record_ids.data()));
+        }
+
+        void BitSlicedIndex::Equal(uint64_t value, hcat_transaction* tx, BoolArray& records)
+        {
+            Range(value, value, tx, records);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+class BoolArray;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Bit-sliced index (O'Neil & Quass) over an unsigned numeric field.
+        // Slice i is the bitmap of the records whose value has bit i set, an
+        // extra bitmap marks the records that have a value at all. Range and
+        // equality predicates become a pass of AND/OR/ANDNOT over the
+        // slices, from the most significant down, no values are compared.
+        //
+        // Record ids are split into chunks of ChunkSize ids stored under
+        //
+        //   $bsi:<field>          [chunk count]
+        //   $bsi:<field>:<chunk>  [slice count][0][exists][slice 0]...
+        //
+        // so a write rewrites one chunk and a chunk only carries as many
+        // slices as its largest value needs. Signed or decimal values have
+        // to be offset or scaled into uint64_t by the caller.
+        class BitSlicedIndex
+        {
+        public:
+            static const uint32_t ChunkSize = 8192;
+
+            BitSlicedIndex(std::string_ref keyspace, std::string_ref field);
+            ~BitSlicedIndex();
+
+            void Set(uint32_t record_id, uint64_t value, hcat_transaction* tx);
+            void Remove(uint32_t record_id, hcat_transaction* tx);
+            bool Get(uint32_t record_id, hcat_transaction* tx, uint64_t& value);
+
+            // Records with low <= value <= high. The bitmap spans every
+            // chunk and can filter a term query through IndexReader::And.
+            void Range(uint64_t low, uint64_t high, hcat_transaction* tx, BoolArray& records);
+            void Range(uint64_t low, uint64_t high, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            void Equal(uint64_t value, hcat_transaction* tx, BoolArray& records);
+        private:
+            std::string_ref keyspace;
+            const std::string prefix;
+
+            uint32_t GetChunkCount(hcat_transaction* tx);
+        };
+    }
+}
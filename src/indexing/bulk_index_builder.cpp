@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include "bulk_index_builder.h"
+#include "tokenizer.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        BulkIndexBuilder::BulkIndexBuilder(std::string_ref keyspace, IndexDictionary* dictionary, size_t thread_count, size_t batch_size,
+                                           bool frequencies, bool positions, SegmentMerger* merger) :
+            keyspace(keyspace), dictionary(dictionary), merger(merger), segments(keyspace), ranked_postings(keyspace), sketches(keyspace), pool(thread_count),
+            batch_size(batch_size == 0 ? 1 : batch_size), frequencies(frequencies), positions(positions), batch(), runs_lock(), runs(), lengths()
+        {
+        }
+
+        BulkIndexBuilder::~BulkIndexBuilder()
+        {
+            pool.Wait();
+        }
+
+        void BulkIndexBuilder::AddDocument(uint32_t record_id, std::string_ref text)
+        {
+            document doc = { record_id, text.str() };
+            batch.push_back(std::move(doc));
+            if (batch.size() >= batch_size)
+            {
+                Dispatch();
+            }
+        }
+
+        void BulkIndexBuilder::Dispatch()
+        {
+            if (batch.empty())
+            {
+                return;
+            }
+            std::shared_ptr<std::vector<document>> documents(new std::vector<document>());
+            documents->swap(batch);
+            pool.Submit([this, documents] { BuildRun(*documents); });
+        }
+
+        void BulkIndexBuilder::BuildRun(const std::vector<document>& documents)
+        {
+            // Terms are numbered locally so the run doesn't need the
+            // dictionary (or the transaction) while it is being built.
+            std::unique_ptr<run> output(new run());
+            std::unordered_map<std::string, uint32_t> local_ids;
+            std::unordered_map<uint32_t, std::vector<uint32_t>> token_positions;
+            std::vector<std::string> tokens;
+            for (auto& doc : documents)
+            {
+                tokens.clear();
+                Tokenize(doc.text, tokens);
+                for (size_t i = 0; i < tokens.size(); i++)
+                {
+                    auto inserted = local_ids.insert(std::make_pair(tokens[i], static_cast<uint32_t>(output->terms.size())));
+                    if (inserted.second)
+                    {
+                        output->terms.push_back(tokens[i]);
+                    }
+                    output->postings.push_back(static_cast<uint64_t>(inserted.first->second) << 32 | doc.record_id);
+                    if (positions)
+                    {
+                        token_positions[inserted.first->second].push_back(static_cast<uint32_t>(i));
+                    }
+                }
+                output->lengths.push_back(std::make_pair(doc.record_id, static_cast<uint32_t>(tokens.size())));
+
+                for (auto& term : token_positions)
+                {
+                    encoded_positions encoded;
+                    encoded.term_id = term.first;
+                    encoded.record_id = doc.record_id;
+                    PositionsStore::Encode(term.second.data(), term.second.size(), encoded.value);
+                    output->positions.push_back(std::move(encoded));
+                }
+                token_positions.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(runs_lock);
+            runs.push_back(std::move(output));
+        }
+
+        void BulkIndexBuilder::MergeRuns(uint64_t from_term, uint64_t to_term, std::vector<encoded_segment>& output)
+        {
+            typedef std::pair<uint64_t, size_t> head;
+            std::vector<std::pair<const uint64_t*, const uint64_t*>> cursors;
+            std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+            for (auto& r : runs)
+            {
+                const uint64_t* first = r->postings.data();
+                const uint64_t* last = first + r->postings.size();
+                // to_term is 2^32 past the last term id, which has no key.
+                const uint64_t* begin = std::lower_bound(first, last, from_term << 32);
+                const uint64_t* end = to_term > UINT32_MAX ? last : std::lower_bound(begin, last, to_term << 32);
+                if (begin != end)
+                {
+                    heads.push(head(*begin, cursors.size()));
+                    cursors.push_back(std::make_pair(begin + 1, end));
+                }
+            }
+
+            // Repeats of a (term, record id) pair are the term frequency.
+            std::vector<uint32_t> record_ids;
+            std::vector<uint32_t> term_frequencies;
+            uint32_t term_id = 0;
+            while (!heads.empty())
+            {
+                head top = heads.top();
+                heads.pop();
+                auto& cursor = cursors[top.second];
+                if (cursor.first != cursor.second)
+                {
+                    heads.push(head(*cursor.first++, top.second));
+                }
+
+                uint32_t next_term = static_cast<uint32_t>(top.first >> 32);
+                uint32_t record_id = static_cast<uint32_t>(top.first);
+                if (next_term != term_id && !record_ids.empty())
+                {
+                    Encode(term_id, record_ids, term_frequencies, output);
+                }
+                term_id = next_term;
+                if (record_ids.empty() || record_ids.back() != record_id)
+                {
+                    record_ids.push_back(record_id);
+                    term_frequencies.push_back(1);
+                }
+                else
+                {
+                    term_frequencies.back()++;
+                }
+            }
+            if (!record_ids.empty())
+            {
+                Encode(term_id, record_ids, term_frequencies, output);
+            }
+        }
+
+        void BulkIndexBuilder::Encode(uint32_t term_id, std::vector<uint32_t>& record_ids, std::vector<uint32_t>& term_frequencies,
+                                      std::vector<encoded_segment>& output)
+        {
+            encoded_segment encoded;
+            encoded.term_id = term_id;
+            encoded.segment = segments.EncodeSegment(record_ids.data(), record_ids.size(), encoded.value);
+            HyperLogLog sketch(TermSketches::Precision);
+            for (uint32_t record_id : record_ids)
+            {
+                sketch.add(TermSketches::Hash(record_id));
+            }
+            encoded.sketch.resize(sketch.serialized_size());
+            sketch.write(encoded.sketch.data());
+            if (frequencies)
+            {
+                std::vector<uint32_t> document_lengths;
+                for (uint32_t record_id : record_ids)
+                {
+                    document_lengths.push_back(lengths.find(record_id)->second);
+                }
+                RankedPostings::Encode(record_ids.data(), term_frequencies.data(), document_lengths.data(), record_ids.size(), encoded.ranked);
+            }
+            output.push_back(std::move(encoded));
+            record_ids.clear();
+            term_frequencies.clear();
+        }
+
+        void BulkIndexBuilder::WriteRanked(encoded_segment& encoded, hcat_transaction* tx)
+        {
+            const uint8_t* existing;
+            size_t existing_length;
+            if (!ranked_postings.GetPostings(encoded.term_id, tx, existing, existing_length))
+            {
+                ranked_postings.SetPostings(encoded.term_id, encoded.ranked, tx);
+                return;
+            }
+
+            // Decoding gives block minimums for the lengths, the exact ones
+            // of this batch are still in lengths.
+            std::vector<uint32_t> new_records, new_frequencies, new_lengths;
+            RankedPostings::Decode(encoded.ranked.data(), encoded.ranked.size(), new_records, new_frequencies, new_lengths);
+            for (size_t i = 0; i < new_records.size(); i++)
+            {
+                new_lengths[i] = lengths.find(new_records[i])->second;
+            }
+
+            // Records usually come in increasing order, then the new blocks
+            // just go after the existing ones.
+            std::vector<uint8_t> value;
+            if (RankedPostings::Append(existing, existing_length, new_records.data(), new_frequencies.data(), new_lengths.data(),
+                                       new_records.size(), value))
+            {
+                ranked_postings.SetPostings(encoded.term_id, value, tx);
+                return;
+            }
+
+            // Otherwise fold the earlier postings of the term in, newer ones
+            // win when a record was indexed again.
+            std::vector<uint32_t> old_records, old_frequencies, old_lengths;
+            RankedPostings::Decode(existing, existing_length, old_records, old_frequencies, old_lengths);
+
+            std::vector<uint32_t> records, term_frequencies, document_lengths;
+            size_t i = 0;
+            size_t j = 0;
+            while (i < old_records.size() || j < new_records.size())
+            {
+                if (j == new_records.size() || (i < old_records.size() && old_records[i] < new_records[j]))
+                {
+                    // Lengths of this batch aren't stored until the end.
+                    auto found = lengths.find(old_records[i]);
+                    uint32_t length = found != lengths.end() ? found->second : ranked_postings.GetLength(old_records[i], tx);
+                    records.push_back(old_records[i]);
+                    term_frequencies.push_back(old_frequencies[i]);
+                    document_lengths.push_back(length != 0 ? length : old_lengths[i]);
+                    i++;
+                    continue;
+                }
+                if (i < old_records.size() && old_records[i] == new_records[j])
+                {
+                    i++;
+                }
+                records.push_back(new_records[j]);
+                term_frequencies.push_back(new_frequencies[j]);
+                document_lengths.push_back(new_lengths[j]);
+                j++;
+            }
+            RankedPostings::Encode(records.data(), term_frequencies.data(), document_lengths.data(), records.size(), value);
+            ranked_postings.SetPostings(encoded.term_id, value, tx);
+        }
+
+        void BulkIndexBuilder::WritePositions(hcat_transaction* tx)
+        {
+            PositionsStore store(keyspace);
+            for (auto& r : runs)
+            {
+                for (auto& encoded : r->positions)
+                {
+                    store.PutPositions(encoded.term_id, encoded.record_id, encoded.value, tx);
+                }
+            }
+        }
+
+        void BulkIndexBuilder::Finish(hcat_transaction* tx)
+        {
+            Dispatch();
+            pool.Wait();
+
+            // Resolving ids needs the transaction so it stays on this
+            // thread, each run is rewritten and sorted in the pool as soon
+            // as its terms are known.
+            uint32_t max_term_id = 0;
+            for (auto& r : runs)
+            {
+                if (frequencies)
+                {
+                    for (auto& length : r->lengths)
+                    {
+                        lengths[length.first] = length.second;
+                    }
+                }
+                std::shared_ptr<std::vector<uint32_t>> term_ids(new std::vector<uint32_t>(r->terms.size()));
+                for (size_t i = 0; i < r->terms.size(); i++)
+                {
+                    (*term_ids)[i] = dictionary->AddTerm(r->terms[i], tx);
+                    if ((*term_ids)[i] > max_term_id)
+                    {
+                        max_term_id = (*term_ids)[i];
+                    }
+                }
+                run* target = r.get();
+                pool.Submit([target, term_ids] {
+                    for (auto& posting : target->postings)
+                    {
+                        posting = static_cast<uint64_t>((*term_ids)[posting >> 32]) << 32 | static_cast<uint32_t>(posting);
+                    }
+                    std::sort(target->postings.begin(), target->postings.end());
+                    for (auto& encoded : target->positions)
+                    {
+                        encoded.term_id = (*term_ids)[encoded.term_id];
+                    }
+                    std::vector<std::string>().swap(target->terms);
+                });
+            }
+            pool.Wait();
+
+            // More partitions than threads so an expensive range doesn't
+            // leave the other threads idle.
+            size_t partition_count = pool.Size() * 8;
+            uint64_t term_range = static_cast<uint64_t>(max_term_id) + 1;
+            uint64_t partition_width = (term_range + partition_count - 1) / partition_count;
+            std::vector<std::vector<encoded_segment>> partitions(partition_count);
+            for (size_t i = 0; i < partition_count; i++)
+            {
+                uint64_t from_term = static_cast<uint64_t>(i) * partition_width;
+                if (from_term >= term_range)
+                {
+                    break;
+                }
+                uint64_t to_term = std::min(from_term + partition_width, term_range);
+                std::vector<encoded_segment>* output = &partitions[i];
+                pool.Submit([this, from_term, to_term, output] { MergeRuns(from_term, to_term, *output); });
+            }
+            pool.Wait();
+            if (positions)
+            {
+                WritePositions(tx);
+            }
+            runs.clear();
+
+            std::vector<segment_info> directory;
+            HyperLogLog sketch(TermSketches::Precision);
+            for (auto& partition : partitions)
+            {
+                for (auto& encoded : partition)
+                {
+                    segments.PutSegment(encoded.term_id, encoded.segment, encoded.value, tx);
+                    segments.GetSegments(encoded.term_id, tx, directory);
+                    directory.push_back(encoded.segment);
+                    segments.SetSegments(encoded.term_id, directory, tx);
+                    if (merger != NULL && directory.size() >= merger->GetMergeFactor())
+                    {
+                        merger->Schedule(encoded.term_id);
+                    }
+                    sketch.read(encoded.sketch.data(), encoded.sketch.size());
+                    sketches.Merge(encoded.term_id, sketch, tx);
+                    if (frequencies)
+                    {
+                        WriteRanked(encoded, tx);
+                    }
+                }
+            }
+
+            if (frequencies)
+            {
+                for (auto& length : lengths)
+                {
+                    ranked_postings.SetLength(length.first, length.second, tx);
+                }
+                lengths.clear();
+            }
+            dictionary->Flush(tx);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+#include "index_dictionary.h"
+#include "positions.h"
+#include "ranked_postings.h"
+#include "segment_merger.h"
+#include "segment_store.h"
+#include "term_sketches.h"
+#include "thread_pool.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Builds the postings of a large batch of documents at once instead
+        // of one SetRecord per (term, record). Runs as a pipeline over a
+        // thread pool:
+        //
+        //   1. batches of documents are tokenized into runs of
+        //      (local term, record id) pairs, one run per batch
+        //   2. the local terms of each run are resolved to term ids through
+        //      the dictionary, on the thread that owns the transaction
+        //   3. each run is rewritten to (term id, record id) and sorted
+        //   4. the runs are merged per term id range and every term's
+        //      postings are compressed into one segment
+        //   5. the segments are written in term id order, each term's
+        //      sketch is merged with the sketch of its records in the batch
+        //
+        // Runs stay in memory until Finish, call it every few million
+        // documents to bound memory. Each call adds one segment per term,
+        // and appends blocks to the ranked postings when its record ids
+        // come after the earlier ones.
+        //
+        // With frequencies on the builder also writes ranked postings and
+        // document lengths for TopK queries, with positions on it writes the
+        // token positions for phrase queries. Positions are compressed
+        // while tokenizing, in step 1.
+        //
+        // Given a merger, terms whose directory reaches its merge factor are
+        // scheduled by Finish, like IndexWriter does when sealing.
+        class BulkIndexBuilder
+        {
+        public:
+            BulkIndexBuilder(std::string_ref keyspace, IndexDictionary* dictionary, size_t thread_count = 0, size_t batch_size = 16384,
+                             bool frequencies = false, bool positions = false, SegmentMerger* merger = NULL);
+            ~BulkIndexBuilder();
+
+            void AddDocument(uint32_t record_id, std::string_ref text);
+
+            // Writes everything added so far and flushes the dictionary.
+            void Finish(hcat_transaction* tx);
+        private:
+            typedef struct
+            {
+                uint32_t record_id;
+                std::string text;
+            } document;
+
+            typedef struct
+            {
+                uint32_t term_id;
+                uint32_t record_id;
+                std::vector<uint32_t> value;
+            } encoded_positions;
+
+            typedef struct
+            {
+                std::vector<std::string> terms;
+                // local term index << 32 | record id until resolved, then
+                // term id << 32 | record id
+                std::vector<uint64_t> postings;
+                // record id, number of terms
+                std::vector<std::pair<uint32_t, uint32_t>> lengths;
+                // local term index until resolved, then term id
+                std::vector<encoded_positions> positions;
+            } run;
+
+            typedef struct
+            {
+                uint32_t term_id;
+                segment_info segment;
+                std::vector<uint32_t> value;
+                std::vector<uint8_t> ranked;
+                std::vector<uint8_t> sketch;
+            } encoded_segment;
+
+            std::string_ref keyspace;
+            IndexDictionary* dictionary;
+            SegmentMerger* merger;
+            SegmentStore segments;
+            RankedPostingsStore ranked_postings;
+            TermSketches sketches;
+            ThreadPool pool;
+            const size_t batch_size;
+            const bool frequencies;
+            const bool positions;
+
+            std::vector<document> batch;
+            std::mutex runs_lock;
+            std::vector<std::unique_ptr<run>> runs;
+            std::unordered_map<uint32_t, uint32_t> lengths;
+
+            BulkIndexBuilder(const BulkIndexBuilder&) = delete;
+            BulkIndexBuilder& operator=(const BulkIndexBuilder&) = delete;
+
+            void Dispatch();
+            void BuildRun(const std::vector<document>& documents);
+            void MergeRuns(uint64_t from_term, uint64_t to_term, std::vector<encoded_segment>& output);
+            void Encode(uint32_t term_id, std::vector<uint32_t>& record_ids, std::vector<uint32_t>& term_frequencies,
+                        std::vector<encoded_segment>& output);
+            void WriteRanked(encoded_segment& encoded, hcat_transaction* tx);
+            void WritePositions(hcat_transaction* tx);
+        };
+    }
+}
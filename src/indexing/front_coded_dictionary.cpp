@@ -0,0 +1,224 @@
+#include <string.h>
+#include "front_coded_dictionary.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static const uint32_t front_coded_magic = 0x44434648; // "HFCD"
+        static const size_t front_coded_header_size = 4 * sizeof(uint32_t);
+
+        static inline uint32_t load_uint32(const uint8_t* in)
+        {
+            uint32_t value;
+            memcpy(&value, in, sizeof(uint32_t));
+            return value;
+        }
+
+        static inline void append_uint32(std::vector<uint8_t>& out, uint32_t value)
+        {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(uint32_t));
+        }
+
+        static inline const uint8_t* read_varint(const uint8_t* in, uint32_t& value)
+        {
+            value = 0;
+            for (unsigned int shift = 0; ; shift += 7)
+            {
+                uint8_t c = *in++;
+                value |= static_cast<uint32_t>(c & 127) << shift;
+                if ((c & 128) == 0)
+                {
+                    return in;
+                }
+            }
+        }
+
+        static inline void append_varint(std::vector<uint8_t>& out, uint32_t value)
+        {
+            while (value >= 128)
+            {
+                out.push_back(static_cast<uint8_t>(value | 128));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        FrontCodedDictionary::FrontCodedDictionary(const uint8_t* data, size_t length) :
+            data(NULL), term_count(0), block_size(0), block_count(0), offsets(NULL), blocks(NULL)
+        {
+            if (data == NULL || length < front_coded_header_size || load_uint32(data) != front_coded_magic)
+            {
+                return;
+            }
+            this->term_count = load_uint32(data + 4);
+            this->block_size = load_uint32(data + 8);
+            this->block_count = load_uint32(data + 12);
+            if (front_coded_header_size + block_count * sizeof(uint32_t) > length)
+            {
+                return;
+            }
+            this->data = data;
+            this->offsets = data + front_coded_header_size;
+            this->blocks = offsets + block_count * sizeof(uint32_t);
+        }
+
+        std::string_ref FrontCodedDictionary::FirstTerm(uint32_t block) const
+        {
+            uint32_t length;
+            const uint8_t* position = read_varint(blocks + load_uint32(offsets + block * sizeof(uint32_t)), length);
+            return std::string_ref(reinterpret_cast<const char*>(position), length);
+        }
+
+        FrontCodedDictionary::Iterator::Iterator(const FrontCodedDictionary* dictionary, uint32_t block) :
+            dictionary(dictionary), block(block), index(0), position(NULL), term(), id(0)
+        {
+            LoadBlock();
+        }
+
+        void FrontCodedDictionary::Iterator::LoadBlock()
+        {
+            index = 0;
+            if (!Valid())
+            {
+                return;
+            }
+            uint32_t length;
+            position = read_varint(dictionary->blocks + load_uint32(dictionary->offsets + block * sizeof(uint32_t)), length);
+            term.assign(reinterpret_cast<const char*>(position), length);
+            position = read_varint(position + length, id);
+        }
+
+        void FrontCodedDictionary::Iterator::Next()
+        {
+            index++;
+            if (index == dictionary->block_size || block * dictionary->block_size + index == dictionary->term_count)
+            {
+                block++;
+                LoadBlock();
+                return;
+            }
+            uint32_t shared;
+            uint32_t suffix;
+            position = read_varint(position, shared);
+            position = read_varint(position, suffix);
+            term.resize(shared);
+            term.append(reinterpret_cast<const char*>(position), suffix);
+            position = read_varint(position + suffix, id);
+        }
+
+        FrontCodedDictionary::Iterator FrontCodedDictionary::Begin() const
+        {
+            return Iterator(this, 0);
+        }
+
+        FrontCodedDictionary::Iterator FrontCodedDictionary::LowerBound(std::string_ref term) const
+        {
+            // Binary search for the last block whose first term is <= term,
+            // only that block (and the start of the next) has to be decoded.
+            uint32_t low = 0;
+            uint32_t high = block_count;
+            while (high - low > 1)
+            {
+                uint32_t middle = (low + high) / 2;
+                if (FirstTerm(middle) <= term)
+                {
+                    low = middle;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+
+            Iterator it(this, low);
+            while (it.Valid() && it.Term() < term)
+            {
+                it.Next();
+            }
+            return it;
+        }
+
+        uint32_t FrontCodedDictionary::Find(std::string_ref term) const
+        {
+            if (!Valid())
+            {
+                return 0;
+            }
+            Iterator it = LowerBound(term);
+            if (it.Valid() && it.Term() == term)
+            {
+                return it.Id();
+            }
+            return 0;
+        }
+
+        void FrontCodedDictionary::ExpandPrefix(std::string_ref prefix, std::vector<uint32_t>& ids) const
+        {
+            if (!Valid())
+            {
+                return;
+            }
+            for (Iterator it = LowerBound(prefix); it.Valid() && it.Term().starts_with(prefix); it.Next())
+            {
+                ids.push_back(it.Id());
+            }
+        }
+
+        void FrontCodedDictionary::ExpandRange(std::string_ref from, std::string_ref to, std::vector<uint32_t>& ids) const
+        {
+            if (!Valid())
+            {
+                return;
+            }
+            for (Iterator it = LowerBound(from); it.Valid() && (to.empty() || it.Term() < to); it.Next())
+            {
+                ids.push_back(it.Id());
+            }
+        }
+
+        FrontCodedDictionaryBuilder::FrontCodedDictionaryBuilder(uint32_t block_size) :
+            block_size(block_size), term_count(0), previous(), offsets(), blocks()
+        {
+        }
+
+        void FrontCodedDictionaryBuilder::Add(std::string_ref term, uint32_t id)
+        {
+            if (term_count % block_size == 0)
+            {
+                offsets.push_back(static_cast<uint32_t>(blocks.size()));
+                append_varint(blocks, static_cast<uint32_t>(term.length()));
+                blocks.insert(blocks.end(), term.begin(), term.end());
+            }
+            else
+            {
+                size_t shared = 0;
+                while (shared < previous.length() && shared < term.length() && previous[shared] == term[shared])
+                {
+                    shared++;
+                }
+                append_varint(blocks, static_cast<uint32_t>(shared));
+                append_varint(blocks, static_cast<uint32_t>(term.length() - shared));
+                blocks.insert(blocks.end(), term.begin() + shared, term.end());
+            }
+            append_varint(blocks, id);
+            previous.assign(term.data(), term.length());
+            term_count++;
+        }
+
+        void FrontCodedDictionaryBuilder::Finish(std::vector<uint8_t>& out)
+        {
+            out.clear();
+            out.reserve(front_coded_header_size + offsets.size() * sizeof(uint32_t) + blocks.size());
+            append_uint32(out, front_coded_magic);
+            append_uint32(out, term_count);
+            append_uint32(out, block_size);
+            append_uint32(out, static_cast<uint32_t>(offsets.size()));
+            for (uint32_t offset : offsets)
+            {
+                append_uint32(out, offset);
+            }
+            out.insert(out.end(), blocks.begin(), blocks.end());
+        }
+    }
+}
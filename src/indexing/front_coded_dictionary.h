@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../string_ref.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        // Immutable sorted term -> term id dictionary stored as front coded
+        // blocks. Every block starts with a full term and the following
+        // terms only store the suffix that differs from the previous term.
+        //
+        // Layout (uint32 fields are little endian and unaligned):
+        //
+        //   uint32 magic, term_count, block_size, block_count
+        //   uint32 block_offsets[block_count]
+        //   blocks: varint length, term bytes, varint id
+        //           (varint shared prefix, varint suffix length, suffix bytes, varint id)*
+        //
+        // The dictionary never copies the buffer it is given, so it can be
+        // used directly over a value returned by the LMDB memory map.
+        class FrontCodedDictionary
+        {
+        public:
+            FrontCodedDictionary(const uint8_t* data, size_t length);
+
+            class Iterator
+            {
+            public:
+                bool Valid() const { return block < dictionary->block_count; }
+                void Next();
+                std::string_ref Term() const { return term; }
+                uint32_t Id() const { return id; }
+            private:
+                friend class FrontCodedDictionary;
+                Iterator(const FrontCodedDictionary* dictionary, uint32_t block);
+
+                const FrontCodedDictionary* dictionary;
+                uint32_t block;
+                uint32_t index;
+                const uint8_t* position;
+                std::string term;
+                uint32_t id;
+
+                void LoadBlock();
+            };
+
+            bool Valid() const { return data != NULL; }
+            uint32_t Size() const { return term_count; }
+
+            // Returns the id of the term or 0 if it isn't in the dictionary.
+            uint32_t Find(std::string_ref term) const;
+
+            Iterator Begin() const;
+
+            // Positions an iterator on the first term >= term.
+            Iterator LowerBound(std::string_ref term) const;
+
+            // Appends the ids of every term starting with prefix.
+            void ExpandPrefix(std::string_ref prefix, std::vector<uint32_t>& ids) const;
+
+            // Appends the ids of every term in [from, to). An empty to means
+            // no upper bound.
+            void ExpandRange(std::string_ref from, std::string_ref to, std::vector<uint32_t>& ids) const;
+        private:
+            const uint8_t* data;
+            uint32_t term_count;
+            uint32_t block_size;
+            uint32_t block_count;
+            const uint8_t* offsets;
+            const uint8_t* blocks;
+
+            std::string_ref FirstTerm(uint32_t block) const;
+        };
+
+        // Builds a FrontCodedDictionary from terms added in sorted order.
+        class FrontCodedDictionaryBuilder
+        {
+        public:
+            FrontCodedDictionaryBuilder(uint32_t block_size = 16);
+            void Add(std::string_ref term, uint32_t id);
+            void Finish(std::vector<uint8_t>& out);
+            uint32_t Size() const { return term_count; }
+        private:
+            uint32_t block_size;
+            uint32_t term_count;
+            std::string previous;
+            std::vector<uint32_t> offsets;
+            std::vector<uint8_t> blocks;
+        };
+    }
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <string.h>
 #include "index_dictionary.h"
 #include "../hellcat.h"
 #include "../string_ref.h"
@@ -8,23 +10,24 @@ using namespace hellcat::storage;
 
 namespace hellcat {
     namespace indexing {
-        
-        IndexDictionary::IndexDictionary(std::string_ref keyspace)
+
+        IndexDictionary::IndexDictionary(std::string_ref keyspace, uint32_t id_block_size, size_t flush_batch_size) :
+            keyspace(keyspace), cache(), id_block_size(id_block_size), flush_batch_size(flush_batch_size),
+            allocation_lock(), id_blocks(), pending_lock(), pending_terms(), unflushed_terms(0), flush_lock()
         {
-            this->keyspace = keyspace;
         }
-        
+
         IndexDictionary::~IndexDictionary()
         {
-            
+
         }
-        
+
         uint32_t IndexDictionary::GetCurrentTermCount(hcat_transaction* tx)
         {
             hcat_keypair pair;
             pair.keyspace = this->keyspace;
             pair.key = string_ref("$current_term");
-            
+
             int rc = tx->get(&pair);
             if (rc == 0)
             {
@@ -40,7 +43,7 @@ namespace hellcat {
             }
             return 0;
         }
-        
+
         void IndexDictionary::SetCurrentTermCount(uint32_t count, hcat_transaction* tx)
         {
             hcat_keypair pair;
@@ -50,50 +53,468 @@ namespace hellcat {
             pair.value_length = sizeof(uint32_t);
             tx->set(&pair);
         }
-        
+
         uint32_t IndexDictionary::GetTermId(std::string_ref term, hcat_transaction* tx)
         {
-            //string term_count_key;
-            //term_count_key.append(term.data());
-            //term_count_key.append("$term");
+            uint32_t term_id = cache.Get(term);
+            if (term_id == 0)
+            {
+                term_id = LookupTermId(term, tx);
+                if (term_id != 0)
+                {
+                    cache.Put(term, term_id);
+                }
+            }
+            return term_id;
+        }
 
+        uint32_t IndexDictionary::GetLexiconLevels(hcat_transaction* tx, bool* legacy)
+        {
             hcat_keypair pair;
             pair.keyspace = this->keyspace;
-            pair.key = term.data(); //term_count_key;
+            pair.key = string_ref("$lexicon");
             if (tx->get(&pair) == HCAT_SUCCESS)
             {
-                uint32_t count = *reinterpret_cast<uint32_t*>(pair.value);
-                return count;
+                if (legacy != NULL)
+                {
+                    *legacy = false;
+                }
+                return *reinterpret_cast<uint32_t*>(pair.value);
+            }
+
+            // Keyspaces started with lexicon levels have $lexicon from the
+            // first reservation of ids on, so ids without it are legacy.
+            if (legacy != NULL)
+            {
+                *legacy = GetCurrentTermCount(tx) != 0;
             }
             return 0;
         }
-        
-        void IndexDictionary::SetTermId(std::string_ref term, uint32_t id, hcat_transaction* tx)
+
+        bool IndexDictionary::GetLegacyTermId(hcat_keypair* pair, uint32_t& term_id)
+        {
+            // Terms used to be keys of their own holding the id, the store
+            // hands back one byte more than was set.
+            if (pair->key.empty() || pair->key[0] == '$' || pair->value_length != sizeof(uint32_t) + 1)
+            {
+                return false;
+            }
+            memcpy(&term_id, pair->value, sizeof(uint32_t));
+            return term_id != 0;
+        }
+
+        void IndexDictionary::ScanLegacyTerms(std::string_ref from, std::string_ref to, hcat_transaction* tx,
+                                              std::function<void(std::string_ref term, uint32_t term_id)> visit)
+        {
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = from;
+            tx->scan(&pair, [&](hcat_keypair* found) {
+                if (!to.empty() && found->key >= to)
+                {
+                    return false;
+                }
+                uint32_t term_id;
+                if (GetLegacyTermId(found, term_id))
+                {
+                    visit(found->key, term_id);
+                }
+                return true;
+            });
+        }
+
+        void IndexDictionary::SetLexiconLevels(uint32_t levels, hcat_transaction* tx)
         {
-            //string term_count_key;
-            //term_count_key.append(term.data());
-            //term_count_key.append("$term");
-            
             hcat_keypair pair;
             pair.keyspace = this->keyspace;
-            pair.key = term.data(); //term_count_key;
-            pair.value = &id;
+            pair.key = string_ref("$lexicon");
+            pair.value = &levels;
             pair.value_length = sizeof(uint32_t);
             tx->set(&pair);
         }
-        
+
+        FrontCodedDictionary IndexDictionary::GetLexicon(uint32_t level, hcat_transaction* tx)
+        {
+            std::string key = "$lexicon:" + std::to_string(level);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                // Points straight into the store, nothing is copied.
+                return FrontCodedDictionary(reinterpret_cast<const uint8_t*>(pair.value), pair.value_length);
+            }
+            return FrontCodedDictionary(NULL, 0);
+        }
+
+        void IndexDictionary::SetLexicon(uint32_t level, std::vector<uint8_t>& lexicon, hcat_transaction* tx)
+        {
+            std::string key = "$lexicon:" + std::to_string(level);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = lexicon.data();
+            pair.value_length = static_cast<uint32_t>(lexicon.size());
+            tx->set(&pair);
+        }
+
+        void IndexDictionary::ClearLexicon(uint32_t level, hcat_transaction* tx)
+        {
+            // The store has no delete, shrink the emptied level to one byte
+            // instead, which reads back as an empty lexicon. The value must
+            // not be NULL, LMDBStore copies a byte past value_length.
+            static const uint8_t empty = 0;
+            std::string key = "$lexicon:" + std::to_string(level);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = const_cast<uint8_t*>(&empty);
+            pair.value_length = 0;
+            tx->set(&pair);
+        }
+
+        uint32_t IndexDictionary::LookupTermId(std::string_ref term, hcat_transaction* tx)
+        {
+            bool legacy = false;
+            uint32_t levels = GetLexiconLevels(tx, &legacy);
+            if (legacy)
+            {
+                hcat_keypair pair;
+                pair.keyspace = this->keyspace;
+                pair.key = term;
+                uint32_t term_id = 0;
+                if (tx->get(&pair) == HCAT_SUCCESS && GetLegacyTermId(&pair, term_id))
+                {
+                    return term_id;
+                }
+            }
+
+            // Levels never share a term so the first hit is the answer.
+            for (uint32_t level = 0; levels != 0; level++, levels >>= 1)
+            {
+                if (levels & 1)
+                {
+                    uint32_t term_id = GetLexicon(level, tx).Find(term);
+                    if (term_id != 0)
+                    {
+                        return term_id;
+                    }
+                }
+            }
+            return 0;
+        }
+
+        uint32_t IndexDictionary::AllocateTermId(hcat_transaction* tx)
+        {
+            std::lock_guard<std::mutex> lock(allocation_lock);
+            term_id_block& block = id_blocks[std::this_thread::get_id()];
+            if (block.next == block.end)
+            {
+                // Reserve a whole block of ids with one update of the shared
+                // counter instead of bumping $current_term for every term.
+                uint32_t reserved = GetCurrentTermCount(tx);
+                if (reserved == 0)
+                {
+                    // A new keyspace, no legacy terms to look for.
+                    SetLexiconLevels(0, tx);
+                }
+                block.next = reserved + 1;
+                block.end = reserved + 1 + id_block_size;
+                block.reserved_in = tx;
+                SetCurrentTermCount(reserved + id_block_size, tx);
+                tx->add_listener(this);
+            }
+            return block.next++;
+        }
+
+        void IndexDictionary::ReleaseTermId(uint32_t id)
+        {
+            // Hand the id back if nothing was allocated after it, otherwise
+            // it is left as a gap in the id space.
+            std::lock_guard<std::mutex> lock(allocation_lock);
+            term_id_block& block = id_blocks[std::this_thread::get_id()];
+            if (block.next == id + 1)
+            {
+                block.next--;
+            }
+        }
+
         uint32_t IndexDictionary::AddTerm(std::string_ref term, hcat_transaction* tx)
         {
-            uint32_t term_id = GetTermId(term, tx);
-            if (term_id == 0)
+            uint32_t term_id = cache.Get(term);
+            if (term_id != 0)
             {
-                term_id = GetCurrentTermCount(tx);
-                term_id++;
-                SetTermId(term, term_id, tx);
-                SetCurrentTermCount(term_id, tx);
+                return term_id;
+            }
+
+            term_id = LookupTermId(term, tx);
+            if (term_id != 0)
+            {
+                return cache.Put(term, term_id);
+            }
+
+            uint32_t allocated_id = AllocateTermId(tx);
+            term_id = cache.Put(term, allocated_id);
+            if (term_id != allocated_id)
+            {
+                // Another writer added the same term first.
+                ReleaseTermId(allocated_id);
+                return term_id;
+            }
+
+            bool flush = false;
+            {
+                std::lock_guard<std::mutex> lock(pending_lock);
+                pending_terms.push_back(pending_term { term.str(), term_id, tx, NULL });
+                unflushed_terms++;
+                flush = unflushed_terms >= flush_batch_size;
+            }
+            tx->add_listener(this);
+            if (flush)
+            {
+                Flush(tx);
             }
             return term_id;
-            //cout << term.data() << " " << term_id << endl;
+        }
+
+        void IndexDictionary::Flush(hcat_transaction* tx)
+        {
+            // The batch stays in pending_terms until tx commits, so readers
+            // whose snapshot doesn't have the new level yet still find it.
+            // ExpandPrefix and ExpandRange hold flush_lock too and never see
+            // a level half written.
+            std::lock_guard<std::mutex> lock(flush_lock);
+            std::vector<std::pair<std::string, uint32_t>> batch;
+            {
+                std::lock_guard<std::mutex> pending(pending_lock);
+                for (auto& term : pending_terms)
+                {
+                    if (term.flushed_in == NULL)
+                    {
+                        batch.push_back(std::make_pair(term.term, term.id));
+                        term.flushed_in = tx;
+                    }
+                }
+                unflushed_terms = 0;
+            }
+
+            bool legacy = false;
+            uint32_t levels = GetLexiconLevels(tx, &legacy);
+            if (legacy)
+            {
+                // The first level takes in the terms of the legacy layout,
+                // from then on only the levels are read.
+                ScanLegacyTerms(std::string_ref(), std::string_ref(), tx, [&](std::string_ref term, uint32_t term_id) {
+                    batch.push_back(std::make_pair(term.str(), term_id));
+                });
+            }
+            if (batch.empty())
+            {
+                return;
+            }
+            tx->add_listener(this);
+
+            // The lexicon is a log structured set of immutable front coded
+            // levels. Level n holds roughly 2^n batches, a new batch is
+            // carried into the next level while the current one is taken,
+            // the same way a binary counter carries.
+            std::sort(batch.begin(), batch.end());
+            std::vector<uint8_t> lexicon;
+            FrontCodedDictionaryBuilder builder;
+            for (auto& term : batch)
+            {
+                builder.Add(term.first, term.second);
+            }
+            builder.Finish(lexicon);
+
+            uint32_t level = 0;
+            for (; levels & (1U << level); level++)
+            {
+                FrontCodedDictionary carried(lexicon.data(), lexicon.size());
+                FrontCodedDictionary existing = GetLexicon(level, tx);
+                FrontCodedDictionaryBuilder merged;
+                FrontCodedDictionary::Iterator a = carried.Begin();
+                FrontCodedDictionary::Iterator b = existing.Begin();
+                while (a.Valid() || b.Valid())
+                {
+                    if (!b.Valid() || (a.Valid() && a.Term() < b.Term()))
+                    {
+                        merged.Add(a.Term(), a.Id());
+                        a.Next();
+                    }
+                    else
+                    {
+                        merged.Add(b.Term(), b.Id());
+                        b.Next();
+                    }
+                }
+                std::vector<uint8_t> output;
+                merged.Finish(output);
+                lexicon.swap(output);
+
+                ClearLexicon(level, tx);
+                levels &= ~(1U << level);
+            }
+            SetLexicon(level, lexicon, tx);
+            SetLexiconLevels(levels | (1U << level), tx);
+        }
+
+        // The first key after every key starting with prefix, empty if there
+        // is none.
+        static std::string prefix_end(std::string_ref prefix)
+        {
+            std::string end = prefix.str();
+            while (!end.empty() && static_cast<uint8_t>(end.back()) == 0xFF)
+            {
+                end.pop_back();
+            }
+            if (!end.empty())
+            {
+                end.back()++;
+            }
+            return end;
+        }
+
+        void IndexDictionary::ExpandPrefix(std::string_ref prefix, hcat_transaction* tx, std::vector<uint32_t>& term_ids)
+        {
+            std::lock_guard<std::mutex> flush(flush_lock);
+            size_t start = term_ids.size();
+            bool legacy = false;
+            uint32_t levels = GetLexiconLevels(tx, &legacy);
+            if (legacy)
+            {
+                ScanLegacyTerms(prefix, prefix_end(prefix), tx, [&](std::string_ref term, uint32_t term_id) {
+                    term_ids.push_back(term_id);
+                });
+            }
+            for (uint32_t level = 0; levels != 0; level++, levels >>= 1)
+            {
+                if (levels & 1)
+                {
+                    GetLexicon(level, tx).ExpandPrefix(prefix, term_ids);
+                }
+            }
+            ExpandPending(tx, [&](std::string_ref term) { return term.starts_with(prefix); }, start, term_ids);
+        }
+
+        void IndexDictionary::ExpandRange(std::string_ref from, std::string_ref to, hcat_transaction* tx, std::vector<uint32_t>& term_ids)
+        {
+            std::lock_guard<std::mutex> flush(flush_lock);
+            size_t start = term_ids.size();
+            bool legacy = false;
+            uint32_t levels = GetLexiconLevels(tx, &legacy);
+            if (legacy)
+            {
+                ScanLegacyTerms(from, to, tx, [&](std::string_ref term, uint32_t term_id) {
+                    term_ids.push_back(term_id);
+                });
+            }
+            for (uint32_t level = 0; levels != 0; level++, levels >>= 1)
+            {
+                if (levels & 1)
+                {
+                    GetLexicon(level, tx).ExpandRange(from, to, term_ids);
+                }
+            }
+            ExpandPending(tx, [&](std::string_ref term) { return term >= from && (to.empty() || term < to); }, start, term_ids);
+        }
+
+        void IndexDictionary::ExpandPending(hcat_transaction* tx, std::function<bool(std::string_ref term)> matches, size_t start,
+                                            std::vector<uint32_t>& term_ids)
+        {
+            std::lock_guard<std::mutex> lock(pending_lock);
+            bool flushed = false;
+            for (auto& term : pending_terms)
+            {
+                // tx already reads the level its own flush wrote.
+                if (term.flushed_in != tx && matches(term.term))
+                {
+                    term_ids.push_back(term.id);
+                    flushed = flushed || term.flushed_in != NULL;
+                }
+            }
+
+            // The level of a flush that just committed may be in tx's
+            // snapshot as well.
+            if (flushed)
+            {
+                std::sort(term_ids.begin() + start, term_ids.end());
+                term_ids.erase(std::unique(term_ids.begin() + start, term_ids.end()), term_ids.end());
+            }
+        }
+
+        void IndexDictionary::committed(hcat_transaction* tx)
+        {
+            {
+                std::lock_guard<std::mutex> lock(allocation_lock);
+                for (auto& block : id_blocks)
+                {
+                    if (block.second.reserved_in == tx)
+                    {
+                        block.second.reserved_in = NULL;
+                    }
+                }
+            }
+
+            // Flushed terms are in the committed levels now.
+            std::lock_guard<std::mutex> lock(pending_lock);
+            std::vector<pending_term> kept;
+            for (auto& term : pending_terms)
+            {
+                if (term.flushed_in != tx)
+                {
+                    kept.push_back(term);
+                    if (kept.back().added_in == tx)
+                    {
+                        kept.back().added_in = NULL;
+                    }
+                }
+            }
+            pending_terms.swap(kept);
+        }
+
+        void IndexDictionary::aborted(hcat_transaction* tx)
+        {
+            // $current_term went back, the next reservation hands the ids of
+            // a block reserved in tx out again so what is left of it goes.
+            {
+                std::lock_guard<std::mutex> lock(allocation_lock);
+                for (auto& block : id_blocks)
+                {
+                    if (block.second.reserved_in == tx)
+                    {
+                        block.second.next = block.second.end;
+                        block.second.reserved_in = NULL;
+                    }
+                }
+            }
+
+            // The ids of the terms added in tx may come from such a block.
+            // Terms added earlier and flushed in tx wait for the next flush.
+            std::lock_guard<std::mutex> lock(pending_lock);
+            std::vector<pending_term> kept;
+            unflushed_terms = 0;
+            for (auto& term : pending_terms)
+            {
+                if (term.added_in == tx)
+                {
+                    cache.Remove(term.term);
+                    continue;
+                }
+                kept.push_back(term);
+                if (kept.back().flushed_in == tx)
+                {
+                    kept.back().flushed_in = NULL;
+                }
+                if (kept.back().flushed_in == NULL)
+                {
+                    unflushed_terms++;
+                }
+            }
+            pending_terms.swap(kept);
         }
     }
 }
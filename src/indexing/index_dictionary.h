@@ -1,26 +1,100 @@
 #pragma once
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "../hellcat.h"
 #include "../string_ref.h"
 #include "../storage/store.h"
+#include "term_cache.h"
+#include "front_coded_dictionary.h"
 
 using namespace hellcat::storage;
 
 namespace hellcat {
     namespace indexing {
-        
-        class IndexDictionary
+
+        // Term -> term id map of a keyspace. Follows the transactions that
+        // add terms, a term added in a transaction that aborts is forgotten
+        // along with the ids reserved in it, so those have to end before
+        // the dictionary is destroyed.
+        //
+        // Keyspaces written before the lexicon levels, with a key per term
+        // holding its id, are read as they are until the first Flush folds
+        // their terms into a level.
+        class IndexDictionary : public hcat_transaction_listener
         {
         public:
-            IndexDictionary(std::string_ref keyspace);
+            IndexDictionary(std::string_ref keyspace, uint32_t id_block_size = 1024, size_t flush_batch_size = 4096);
             ~IndexDictionary();
             uint32_t GetCurrentTermCount(hcat_transaction* tx);
             uint32_t AddTerm(std::string_ref name, hcat_transaction* tx);
             uint32_t GetTermId(std::string_ref term, hcat_transaction* tx);
+
+            // Persists the terms added since the last flush. New terms are
+            // only cached until then so call this before committing tx. They
+            // stay pending, for readers of older snapshots, until tx commits.
+            void Flush(hcat_transaction* tx);
+
+            // Appends the ids of every term starting with prefix, so a
+            // foo* query can be answered as an OR over the term ids.
+            void ExpandPrefix(std::string_ref prefix, hcat_transaction* tx, std::vector<uint32_t>& term_ids);
+
+            // Appends the ids of every term in [from, to).
+            void ExpandRange(std::string_ref from, std::string_ref to, hcat_transaction* tx, std::vector<uint32_t>& term_ids);
+
+            void committed(hcat_transaction* tx);
+            void aborted(hcat_transaction* tx);
         private:
+            // Range of term ids reserved by one writer thread.
+            typedef struct
+            {
+                uint32_t next;
+                uint32_t end;
+                // Until it commits, the transaction that reserved the range.
+                hcat_transaction* reserved_in;
+            } term_id_block;
+
+            // A term waiting for Flush.
+            typedef struct
+            {
+                std::string term;
+                uint32_t id;
+                // Until it commits, the transaction that added the term.
+                hcat_transaction* added_in;
+                // Until it commits, the transaction that flushed the term.
+                hcat_transaction* flushed_in;
+            } pending_term;
+
             std::string_ref keyspace;
+            TermCache cache;
+            const uint32_t id_block_size;
+            const size_t flush_batch_size;
+
+            std::mutex allocation_lock;
+            std::unordered_map<std::thread::id, term_id_block> id_blocks;
+
+            std::mutex pending_lock;
+            std::vector<pending_term> pending_terms;
+            size_t unflushed_terms;
+            std::mutex flush_lock;
 
+            uint32_t LookupTermId(std::string_ref term, hcat_transaction* tx);
+            uint32_t AllocateTermId(hcat_transaction* tx);
+            void ReleaseTermId(uint32_t id);
             void SetCurrentTermCount(uint32_t count, hcat_transaction* tx);
-            void SetTermId(std::string_ref term, uint32_t id, hcat_transaction* tx);
+            uint32_t GetLexiconLevels(hcat_transaction* tx, bool* legacy = NULL);
+            void SetLexiconLevels(uint32_t levels, hcat_transaction* tx);
+            FrontCodedDictionary GetLexicon(uint32_t level, hcat_transaction* tx);
+            void SetLexicon(uint32_t level, std::vector<uint8_t>& lexicon, hcat_transaction* tx);
+            void ClearLexicon(uint32_t level, hcat_transaction* tx);
+            static bool GetLegacyTermId(hcat_keypair* pair, uint32_t& term_id);
+            void ScanLegacyTerms(std::string_ref from, std::string_ref to, hcat_transaction* tx,
+                                 std::function<void(std::string_ref term, uint32_t term_id)> visit);
+            void ExpandPending(hcat_transaction* tx, std::function<bool(std::string_ref term)> matches, size_t start,
+                               std::vector<uint32_t>& term_ids);
         };
     }
 }
@@ -1,177 +1,646 @@
 #include <iostream>
-//#include <chrono>
-//#include <thread>
-//#include "../simd_compression/codecfactory.h"
-//#include "../simd_compression/intersection.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <queue>
+#include <chrono>
+#include "../simd_compression/boolarray.h"
+#include "../simd_compression/intersection.h"
+#include "../simd_compression/roaringbitmap.h"
+#include "../simd_compression/union.h"
 #include "index_reader.h"
 
 using namespace std;
-//using namespace chrono;
+using namespace std::chrono;
 
 namespace hellcat {
     namespace indexing {
         
-        const int amount = 250000000;
+        IndexReader::IndexReader(std::string_ref keyspace, IndexDictionary* dictionary, QueryCache* cache) :
+            keyspace(keyspace), dictionary(dictionary), cache(cache), segments(keyspace), ranked_postings(keyspace),
+            positions(keyspace), tombstones(keyspace), sketches(keyspace)
+        {
+        }
+        
+        IndexReader::~IndexReader()
+        {
+        }
+        
+        void IndexReader::GetTermIds(std::string_ref term, hcat_transaction* tx, std::vector<uint32_t>& term_ids)
+        {
+            if (!term.empty() && term[term.length() - 1] == '*')
+            {
+                dictionary->ExpandPrefix(term.substr(0, term.length() - 1), tx, term_ids);
+                return;
+            }
+            
+            uint32_t term_id = dictionary->GetTermId(term, tx);
+            if (term_id != 0)
+            {
+                term_ids.push_back(term_id);
+            }
+        }
+        
+        void IndexReader::GetTermPostings(std::string_ref term, hcat_transaction* tx, std::vector<posting_list>& postings, posting_buffers& buffers)
+        {
+            std::vector<uint32_t> term_ids;
+            GetTermIds(term, tx, term_ids);
+            for (uint32_t term_id : term_ids)
+            {
+                buffers.emplace_back();
+                postings.push_back(segments.GetPostings(term_id, tx, buffers.back()));
+            }
+        }
+        
+        void IndexReader::Union(std::vector<posting_list>& postings, std::vector<uint32_t>& record_ids)
+        {
+            std::vector<const uint32_t*> sets;
+            std::vector<size_t> lengths;
+            size_t total = 0;
+            for (auto& list : postings)
+            {
+                sets.push_back(list.record_ids);
+                lengths.push_back(list.count);
+                total += list.count;
+            }
+            
+            // SIMDmultiunion picks between a bitmap, pairwise SIMD merges
+            // and a heap merge depending on the density and list count.
+            record_ids.resize(total);
+            record_ids.resize(SIMDmultiunion(sets.data(), lengths.data(), sets.size(), record_ids.data()));
+        }
+        
+        void IndexReader::Or(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            std::vector<posting_list> postings;
+            posting_buffers buffers;
+            for (auto& term : terms)
+            {
+                GetTermPostings(term, tx, postings, buffers);
+            }
+            Union(postings, record_ids);
+            tombstones.RemoveDeleted(tx, record_ids);
+        }
+        
+        void IndexReader::And(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            std::vector<std::vector<uint32_t>> term_ids(terms.size());
+            record_ids.clear();
+            for (size_t i = 0; i < terms.size(); i++)
+            {
+                GetTermIds(terms[i], tx, term_ids[i]);
+                if (term_ids[i].empty())
+                {
+                    return;
+                }
+            }
+            if (cache == NULL)
+            {
+                Intersect(term_ids, tx, record_ids);
+            }
+            else
+            {
+                // Deletes don't change the generations, cached results still
+                // hold deleted records and are filtered like fresh ones.
+                std::string key = GetCacheKey(term_ids, tx);
+                if (!cache->Get(key, record_ids))
+                {
+                    steady_clock::time_point start = steady_clock::now();
+                    Intersect(term_ids, tx, record_ids);
+                    cache->Put(key, record_ids, duration_cast<microseconds>(steady_clock::now() - start).count());
+                }
+            }
+            tombstones.RemoveDeleted(tx, record_ids);
+        }
+        
+        void IndexReader::And(const std::vector<std::string_ref>& terms, const BoolArray& filter, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            if (terms.empty())
+            {
+                BoolArray records(filter);
+                record_ids.resize(records.sizeInBits());
+                record_ids.resize(records.toInts(record_ids.data()));
+                tombstones.RemoveDeleted(tx, record_ids);
+                return;
+            }
+            
+            // The term intersection stays cacheable, the filter is applied
+            // on its result with one bit probe per record.
+            And(terms, tx, record_ids);
+            size_t count = 0;
+            for (uint32_t record_id : record_ids)
+            {
+                if (record_id < filter.sizeInBits() && filter.get(record_id))
+                {
+                    record_ids[count++] = record_id;
+                }
+            }
+            record_ids.resize(count);
+        }
+        
+        std::string IndexReader::GetCacheKey(std::vector<std::vector<uint32_t>>& term_ids, hcat_transaction* tx)
+        {
+            // One group of (term id, generation) pairs per query term, in a
+            // canonical order so "a b" and "b a" share an entry. A write to
+            // any of the terms changes the key.
+            std::vector<std::string> groups;
+            for (auto& ids : term_ids)
+            {
+                std::vector<uint32_t> sorted(ids);
+                std::sort(sorted.begin(), sorted.end());
+                std::string group;
+                for (uint32_t term_id : sorted)
+                {
+                    uint64_t generation = segments.GetGeneration(term_id, tx);
+                    group.append(reinterpret_cast<const char*>(&term_id), sizeof(term_id));
+                    group.append(reinterpret_cast<const char*>(&generation), sizeof(generation));
+                }
+                groups.push_back(group);
+            }
+            std::sort(groups.begin(), groups.end());
+            groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+            
+            std::string key;
+            for (auto& group : groups)
+            {
+                uint32_t length = static_cast<uint32_t>(group.size());
+                key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                key.append(group);
+            }
+            return key;
+        }
+        
+        size_t IndexReader::EstimateGroup(const std::vector<uint32_t>& term_ids, hcat_transaction* tx)
+        {
+            // The summed directory counts bound the size of the union, the
+            // merged sketches estimate it. Terms indexed before sketches
+            // existed only have the bound.
+            size_t bound = 0;
+            bool sketched = true;
+            HyperLogLog merged(TermSketches::Precision);
+            HyperLogLog sketch(TermSketches::Precision);
+            for (uint32_t term_id : term_ids)
+            {
+                bound += segments.CountPostings(term_id, tx);
+                if (sketched && sketches.Get(term_id, tx, sketch))
+                {
+                    merged.merge(sketch);
+                }
+                else
+                {
+                    sketched = false;
+                }
+            }
+            if (!sketched)
+            {
+                return bound;
+            }
+            uint64_t estimate = merged.estimate();
+            return estimate < bound ? static_cast<size_t>(estimate) : bound;
+        }
         
-        // We pick a CODEC, could use others, e.g., "varint", "s-fastpfor-1"
-        //IntegerCODEC &codec =  * CODECFactory::getFromName("s4-bp128-m");
-        // using SIMD intersection
-        //intersectionfunction inter;
+        uint64_t IndexReader::EstimateCount(std::string_ref term, hcat_transaction* tx)
+        {
+            std::vector<uint32_t> term_ids;
+            GetTermIds(term, tx, term_ids);
+            return term_ids.empty() ? 0 : EstimateGroup(term_ids, tx);
+        }
         
-        vector<uint32_t> docsets [1024];
-        vector<uint32_t> instersect_with_docsets [1024];
+        void IndexReader::Intersect(std::vector<std::vector<uint32_t>>& term_ids, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            // Lists stay compressed and are only sized, plain terms from
+            // their segment directories, prefix terms from their sketches.
+            typedef struct
+            {
+                const std::vector<uint32_t>* term_ids;
+                size_t count;
+            } and_list;
+            
+            std::vector<and_list> lists(term_ids.size());
+            for (size_t i = 0; i < term_ids.size(); i++)
+            {
+                lists[i].term_ids = &term_ids[i];
+                if (term_ids[i].size() == 1)
+                {
+                    lists[i].count = segments.CountPostings(term_ids[i][0], tx);
+                    continue;
+                }
+                lists[i].count = EstimateGroup(term_ids[i], tx);
+            }
+            if (lists.empty())
+            {
+                return;
+            }
+            
+            // Intersect smallest first so the intermediate result only
+            // shrinks. Only the smallest list is decoded in full, the others
+            // are decoded a block at a time while intersecting against it.
+            std::sort(lists.begin(), lists.end(), [](const and_list& a, const and_list& b) {
+                return a.count < b.count;
+            });
+            std::vector<posting_list> postings;
+            posting_buffers buffers;
+            for (uint32_t term_id : *lists[0].term_ids)
+            {
+                buffers.emplace_back();
+                postings.push_back(segments.GetPostings(term_id, tx, buffers.back()));
+            }
+            if (postings.size() == 1)
+            {
+                record_ids.assign(postings[0].record_ids, postings[0].record_ids + postings[0].count);
+            }
+            else
+            {
+                Union(postings, record_ids);
+            }
+            
+            // A prefix term after the first is intersected term by term and
+            // the matches unioned, it is never expanded in full.
+            std::vector<std::vector<uint32_t>> matches;
+            for (size_t i = 1; i < lists.size() && !record_ids.empty(); i++)
+            {
+                const std::vector<uint32_t>& group = *lists[i].term_ids;
+                if (group.size() == 1)
+                {
+                    segments.IntersectPostings(group[0], tx, record_ids);
+                    continue;
+                }
+                matches.assign(group.size(), record_ids);
+                postings.clear();
+                for (size_t j = 0; j < group.size(); j++)
+                {
+                    segments.IntersectPostings(group[j], tx, matches[j]);
+                    posting_list list = { matches[j].data(), matches[j].size() };
+                    postings.push_back(list);
+                }
+                Union(postings, record_ids);
+            }
+        }
         
-        void IndexReader::Read()
+        void IndexReader::Facets(const std::vector<uint32_t>& record_ids, const std::vector<std::string_ref>& facets, hcat_transaction* tx,
+                                 std::vector<size_t>& counts)
         {
+            counts.assign(facets.size(), 0);
+            std::vector<uint32_t> term_ids;
+            for (size_t i = 0; i < facets.size(); i++)
+            {
+                term_ids.clear();
+                GetTermIds(facets[i], tx, term_ids);
+                if (term_ids.size() == 1)
+                {
+                    counts[i] = segments.CountIntersection(term_ids[0], tx, record_ids);
+                    continue;
+                }
+                if (term_ids.empty())
+                {
+                    continue;
+                }
+                // A prefix facet intersects each of its terms with the
+                // records, segment by segment, and unions the matches so a
+                // record matching several of its terms counts once.
+                std::vector<std::vector<uint32_t>> matches(term_ids.size());
+                std::vector<posting_list> lists;
+                for (size_t j = 0; j < term_ids.size(); j++)
+                {
+                    matches[j] = record_ids;
+                    segments.IntersectPostings(term_ids[j], tx, matches[j]);
+                    posting_list list = { matches[j].data(), matches[j].size() };
+                    lists.push_back(list);
+                }
+                std::vector<uint32_t> facet;
+                Union(lists, facet);
+                counts[i] = facet.size();
+            }
+        }
+        
+        void IndexReader::Facets(const RoaringBitmap& records, const std::vector<std::string_ref>& facets, hcat_transaction* tx,
+                                 std::vector<size_t>& counts)
+        {
+            counts.assign(facets.size(), 0);
+            std::vector<uint32_t> term_ids;
+            std::vector<uint32_t> buffer;
+            for (size_t i = 0; i < facets.size(); i++)
+            {
+                term_ids.clear();
+                GetTermIds(facets[i], tx, term_ids);
+                // The postings of the facet become a bitmap too, the count is
+                // taken container by container without building the
+                // intersection. A prefix facet unions its terms first so a
+                // record matching several of them counts once.
+                RoaringBitmap facet;
+                for (uint32_t term_id : term_ids)
+                {
+                    posting_list postings = segments.GetPostings(term_id, tx, buffer);
+                    facet.inplaceUnion(RoaringBitmap::fromSorted(postings.record_ids, postings.count));
+                }
+                counts[i] = records.intersectionCardinality(facet);
+            }
+        }
+        
+        bool IndexReader::GetPhraseTermIds(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& term_ids)
+        {
+            // Positions are per term, prefixes aren't expanded here.
+            for (auto& term : terms)
+            {
+                uint32_t term_id = dictionary->GetTermId(term, tx);
+                if (term_id == 0)
+                {
+                    return false;
+                }
+                term_ids.push_back(term_id);
+            }
+            return !term_ids.empty();
+        }
+        
+        void IndexReader::Phrase(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            std::vector<uint32_t> term_ids;
+            std::vector<uint32_t> candidates;
+            record_ids.clear();
+            if (!GetPhraseTermIds(terms, tx, term_ids))
+            {
+                return;
+            }
+            
+            // The record id intersection narrows things down first, positions
+            // are only decoded for the records that survive it.
+            std::vector<std::vector<uint32_t>> groups;
+            for (uint32_t term_id : term_ids)
+            {
+                groups.push_back(std::vector<uint32_t>(1, term_id));
+            }
+            Intersect(groups, tx, candidates);
+            tombstones.RemoveDeleted(tx, candidates);
             
+            std::vector<uint32_t> current;
+            std::vector<uint32_t> next;
+            std::vector<uint32_t> matched;
+            for (uint32_t record_id : candidates)
+            {
+                if (!positions.GetPositions(term_ids[0], record_id, tx, current))
+                {
+                    continue;
+                }
+                for (size_t i = 1; i < term_ids.size() && !current.empty(); i++)
+                {
+                    if (!positions.GetPositions(term_ids[i], record_id, tx, next))
+                    {
+                        current.clear();
+                        break;
+                    }
+                    matched.resize(current.size());
+                    matched.resize(OffsetIntersect(current.data(), current.size(), 1, next.data(), next.size(), matched.data()));
+                    current.swap(matched);
+                }
+                if (!current.empty())
+                {
+                    record_ids.push_back(record_id);
+                }
+            }
         }
         
-        /*
-         int main2(int argc, char* argv[]) {
-         std::stringstream output;
-         std::locale comma_locale(std::locale(), new comma_numpunct());
-         output.imbue(comma_locale);
-         
-         int num_threads = 1;
-         if (argc > 1)
-         {
-         num_threads = std::stoi(argv[1]);
-         }
-         
-         inter = IntersectionFactory::getFromName("simd");
-         std::chrono::time_point<std::chrono::high_resolution_clock> start;
-         
-         if (num_threads > 1)
-         {
-         vector<std::thread> threads;
-         
-         // Create docsets.
-         for (int i=0; i<num_threads; i++)
-         {
-         threads.emplace_back(std::thread(create_docset, i));
-         }
-         
-         for(auto& thread : threads)
-         {
-         thread.join();
-         }
-         threads.clear();
-         
-         // Insersect.
-         cout << "Intersecting..." << endl;
-         start = high_resolution_clock::now();
-         
-         for (int i=0; i<num_threads; i++)
-         {
-         threads.emplace_back(std::thread(intersect_docset, i));
-         }
-         for(auto& thread : threads)
-         {
-         thread.join();
-         }
-         }
-         else
-         {
-         create_docset(0);
-         cout <<"Skipping threading" << endl;
-         cout << "Intersecting..." << endl;
-         start = high_resolution_clock::now();
-         intersect_docset(0);
-         }
-         
-         auto end = high_resolution_clock::now();
-         nanoseconds elapsed = duration_cast<nanoseconds>(end - start);
-         print_results(output, amount * num_threads, elapsed);
-         cout << output.str();
-         }
-         
-         void create_docset(int threadid)
-         {
-         docsets[threadid] = create_and_compress_docset(amount);
-         instersect_with_docsets[threadid] = create_docset_to_interect_with(amount);
-         }
-         
-         void intersect_docset(int threadid)
-         {
-         intersect_docs(docsets[threadid], instersect_with_docsets[threadid]);
-         }
-         
-         vector<uint32_t> create_and_compress_docset(size_t amount)
-         {
-         ////////////
-         //
-         // create a container with some integers in it
-         //
-         // We need the integers to be in sorted order.
-         //
-         // (Note: You don't need to use a vector.)
-         //
-         size_t N = amount;
-         vector<uint32_t> mydata(N);
-         for (uint32_t i = 0; i < N; ++i) mydata[i] = 3 * i;
-         ///////////
-         //
-         // You need some "output" container. You are responsible
-         // for allocating enough memory.
-         //
-         vector<uint32_t> compressed_output(N + 1024);
-         // N+1024 should be plenty
-         //
-         //
-         size_t compressedsize = compressed_output.size();
-         codec.encodeArray(mydata.data(), mydata.size(),
-         compressed_output.data(), compressedsize);
-         //
-         // if desired, shrink back the array:
-         compressed_output.resize(compressedsize);
-         compressed_output.shrink_to_fit();
-         // display compression rate:
-         cout << setprecision(3);
-         cout << "You are using " << 32.0 * static_cast<double>(compressed_output.size()) /
-         static_cast<double>(mydata.size()) << " bits per integer. " << endl;
-         
-         return mydata;
-         }
-         
-         vector<uint32_t> decompress_docset(vector<uint32_t>& compressed_docset, size_t amount)
-         {
-         ///
-         // decompressing is also easy:
-         //
-         vector<uint32_t> mydataback(amount);
-         size_t recoveredsize = mydataback.size();
-         //
-         codec.decodeArray(compressed_docset.data(),
-         compressed_docset.size(), mydataback.data(), recoveredsize);
-         mydataback.resize(recoveredsize);
-         
-         //
-         // That's it for compression!
-         //
-         //if (mydataback != mydata) throw runtime_error("bug!");
-         
-         return mydataback;
-         }
-         
-         vector<uint32_t> create_docset_to_interect_with(size_t amount)
-         {
-         //
-         // Next we are going to test out intersection...
-         //
-         vector<uint32_t> mydata2(amount);
-         for (uint32_t i = 0; i < amount; ++i) mydata2[i] = 6 * i;
-         
-         return mydata2;
-         }
-         
-         void intersect_docs(vector<uint32_t>& docset, vector<uint32_t>& instersect_with_docset)
-         {
-         size_t intersize = inter(instersect_with_docset.data(), instersect_with_docset.size(), docset.data(), docset.size(), instersect_with_docset.data());
-         //cout << "Resizing..." << endl;
-         //instersect_with_docset.resize(intersize);
-         //instersect_with_docset.shrink_to_fit();
-         //cout << "Intersection size: " << instersect_with_docset.size() << "  integers. " << endl;
-         }
-         */
+        void IndexReader::Near(const std::vector<std::string_ref>& terms, uint32_t distance, hcat_transaction* tx,
+                               std::vector<uint32_t>& record_ids)
+        {
+            std::vector<uint32_t> term_ids;
+            std::vector<uint32_t> candidates;
+            record_ids.clear();
+            if (!GetPhraseTermIds(terms, tx, term_ids))
+            {
+                return;
+            }
+            std::sort(term_ids.begin(), term_ids.end());
+            term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+            
+            std::vector<std::vector<uint32_t>> groups;
+            for (uint32_t term_id : term_ids)
+            {
+                groups.push_back(std::vector<uint32_t>(1, term_id));
+            }
+            Intersect(groups, tx, candidates);
+            tombstones.RemoveDeleted(tx, candidates);
+            
+            std::vector<std::vector<uint32_t>> term_positions(term_ids.size());
+            std::vector<size_t> cursors(term_ids.size());
+            for (uint32_t record_id : candidates)
+            {
+                bool found = true;
+                for (size_t i = 0; i < term_ids.size() && found; i++)
+                {
+                    found = positions.GetPositions(term_ids[i], record_id, tx, term_positions[i]) && !term_positions[i].empty();
+                    cursors[i] = 0;
+                }
+                
+                // Slide a window over the positions of all terms, always
+                // advancing the term at its left edge.
+                bool matches = false;
+                while (found && !matches)
+                {
+                    size_t lowest = 0;
+                    uint32_t low = UINT32_MAX;
+                    uint32_t high = 0;
+                    for (size_t i = 0; i < term_ids.size(); i++)
+                    {
+                        uint32_t position = term_positions[i][cursors[i]];
+                        if (position < low)
+                        {
+                            low = position;
+                            lowest = i;
+                        }
+                        if (position > high)
+                        {
+                            high = position;
+                        }
+                    }
+                    matches = high - low <= distance;
+                    found = ++cursors[lowest] < term_positions[lowest].size();
+                }
+                if (matches)
+                {
+                    record_ids.push_back(record_id);
+                }
+            }
+        }
+        
+        static const float bm25_k1 = 1.2f;
+        static const float bm25_b = 0.75f;
+        
+        static inline float bm25(float idf, uint32_t frequency, uint32_t length, float average_length)
+        {
+            float norm = bm25_k1 * (1.0f - bm25_b + bm25_b * length / average_length);
+            return idf * frequency * (bm25_k1 + 1.0f) / (frequency + norm);
+        }
+        
+        typedef struct
+        {
+            std::unique_ptr<RankedPostingsCursor> cursor;
+            float idf;
+            float max_score;
+        } ranked_term;
+        
+        void IndexReader::TopK(const std::vector<std::string_ref>& terms, size_t k, hcat_transaction* tx, std::vector<scored_record>& results)
+        {
+            results.clear();
+            collection_statistics statistics = ranked_postings.GetStatistics(tx);
+            if (k == 0 || statistics.document_count == 0)
+            {
+                return;
+            }
+            float document_count = static_cast<float>(statistics.document_count);
+            float average_length = static_cast<float>(statistics.total_length) / document_count;
+            
+            std::vector<uint32_t> term_ids;
+            for (auto& term : terms)
+            {
+                GetTermIds(term, tx, term_ids);
+            }
+            std::vector<ranked_term> lists;
+            for (uint32_t term_id : term_ids)
+            {
+                const uint8_t* value;
+                size_t length;
+                if (!ranked_postings.GetPostings(term_id, tx, value, length))
+                {
+                    continue;
+                }
+                ranked_term list;
+                list.cursor.reset(new RankedPostingsCursor(value, length));
+                if (!list.cursor->Valid())
+                {
+                    continue;
+                }
+                float frequency = static_cast<float>(list.cursor->Count());
+                list.idf = std::log(1.0f + (document_count - frequency + 0.5f) / (frequency + 0.5f));
+                list.max_score = 0;
+                for (uint32_t b = 0; b < list.cursor->BlockCount(); b++)
+                {
+                    ranked_block block = list.cursor->GetBlock(b);
+                    float score = bm25(list.idf, block.max_frequency, block.min_length, average_length);
+                    if (score > list.max_score)
+                    {
+                        list.max_score = score;
+                    }
+                }
+                lists.push_back(std::move(list));
+            }
+            RoaringBitmap deleted;
+            tombstones.GetDeleted(0, UINT32_MAX, tx, deleted);
+            
+            // Block-max WAND (Ding & Suel). Lists are kept sorted by their
+            // current record, the pivot is the first record whose lists
+            // could beat the k-th best score. The block maxima at the pivot
+            // then either confirm it is worth scoring or tell us how far
+            // every list before the pivot can jump without decoding.
+            auto worse = [](const scored_record& a, const scored_record& b) { return a.score > b.score; };
+            std::priority_queue<scored_record, std::vector<scored_record>, decltype(worse)> heap(worse);
+            float threshold = 0;
+            while (true)
+            {
+                std::sort(lists.begin(), lists.end(), [](const ranked_term& a, const ranked_term& b) {
+                    return a.cursor->Record() < b.cursor->Record();
+                });
+                while (!lists.empty() && !lists.back().cursor->Valid())
+                {
+                    lists.pop_back();
+                }
+                
+                size_t pivot = 0;
+                float upper_bound = 0;
+                for (; pivot < lists.size(); pivot++)
+                {
+                    upper_bound += lists[pivot].max_score;
+                    if (upper_bound > threshold)
+                    {
+                        break;
+                    }
+                }
+                if (pivot == lists.size())
+                {
+                    break;
+                }
+                uint32_t pivot_record = lists[pivot].cursor->Record();
+                while (pivot + 1 < lists.size() && lists[pivot + 1].cursor->Record() == pivot_record)
+                {
+                    pivot++;
+                }
+                
+                float block_bound = 0;
+                for (size_t i = 0; i <= pivot; i++)
+                {
+                    RankedPostingsCursor& cursor = *lists[i].cursor;
+                    cursor.ShallowAdvance(pivot_record);
+                    if (cursor.BlockValid())
+                    {
+                        block_bound += bm25(lists[i].idf, cursor.BlockMaxFrequency(), cursor.BlockMinLength(), average_length);
+                    }
+                }
+                
+                if (block_bound > threshold)
+                {
+                    if (lists[0].cursor->Record() == pivot_record)
+                    {
+                        uint32_t length = ranked_postings.GetLength(pivot_record, tx);
+                        float score = 0;
+                        for (size_t i = 0; i <= pivot; i++)
+                        {
+                            score += bm25(lists[i].idf, lists[i].cursor->Frequency(), length, average_length);
+                            lists[i].cursor->Next();
+                        }
+                        if ((heap.size() < k || score > threshold) && !deleted.contains(pivot_record))
+                        {
+                            scored_record record = { pivot_record, score };
+                            heap.push(record);
+                            if (heap.size() > k)
+                            {
+                                heap.pop();
+                            }
+                            if (heap.size() == k)
+                            {
+                                threshold = heap.top().score;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (size_t i = 0; i < pivot; i++)
+                        {
+                            lists[i].cursor->NextGEQ(pivot_record);
+                        }
+                    }
+                    continue;
+                }
+                
+                // Nothing up to the end of the smallest current block (or the
+                // next list's record) can make it, jump past it.
+                uint64_t next = static_cast<uint64_t>(UINT32_MAX) + 1;
+                for (size_t i = 0; i <= pivot; i++)
+                {
+                    RankedPostingsCursor& cursor = *lists[i].cursor;
+                    if (cursor.BlockValid() && static_cast<uint64_t>(cursor.BlockLastRecord()) + 1 < next)
+                    {
+                        next = static_cast<uint64_t>(cursor.BlockLastRecord()) + 1;
+                    }
+                }
+                if (pivot + 1 < lists.size() && lists[pivot + 1].cursor->Record() < next)
+                {
+                    next = lists[pivot + 1].cursor->Record();
+                }
+                if (next > UINT32_MAX)
+                {
+                    break;
+                }
+                for (size_t i = 0; i <= pivot; i++)
+                {
+                    lists[i].cursor->NextGEQ(static_cast<uint32_t>(next));
+                }
+            }
+            
+            results.resize(heap.size());
+            for (size_t i = heap.size(); i > 0; i--)
+            {
+                results[i - 1] = heap.top();
+                heap.pop();
+            }
+        }
     }
 }
@@ -1,19 +1,101 @@
 #pragma once
+#include <deque>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
 #include "../storage/store.h"
+#include "index_dictionary.h"
+#include "positions.h"
+#include "query_cache.h"
+#include "ranked_postings.h"
+#include "segment_store.h"
+#include "term_sketches.h"
+#include "tombstones.h"
 
 using namespace hellcat::storage;
 
+class BoolArray;
+class RoaringBitmap;
+
 namespace hellcat {
     namespace indexing {
         
+        typedef struct
+        {
+            uint32_t record_id;
+            float score;
+        } scored_record;
+        
         class IndexReader
         {
         public:
-            IndexReader();
+            IndexReader(std::string_ref keyspace, IndexDictionary* dictionary, QueryCache* cache = NULL);
             ~IndexReader();
-            void Read();
+            
+            // Record ids matching every term. Goes through the query cache
+            // when the reader has one. Like every query, leaves out deleted
+            // records.
+            void And(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            
+            // Same, restricted to the records set in filter, e.g. the result
+            // of a BitSlicedIndex range. With no terms it is the filter
+            // alone, still without the deleted records.
+            void And(const std::vector<std::string_ref>& terms, const BoolArray& filter, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            
+            // Record ids matching any term. A term ending in * matches every
+            // term starting with what comes before it.
+            void Or(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            
+            // Records where the terms occur next to each other in this order.
+            // Only sees records indexed with positions.
+            void Phrase(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            
+            // Records where all the terms occur, in any order, within a
+            // window of distance + 1 positions.
+            void Near(const std::vector<std::string_ref>& terms, uint32_t distance, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            
+            // counts[i] is how many of the sorted record_ids, typically a
+            // query result, match facets[i]. The postings are never decoded
+            // in full: a term is counted segment by segment against
+            // record_ids, a prefix facet keeps only the matches of its terms.
+            void Facets(const std::vector<uint32_t>& record_ids, const std::vector<std::string_ref>& facets, hcat_transaction* tx,
+                        std::vector<size_t>& counts);
+            
+            // Same for a bitmap result, counted against a bitmap of each
+            // facet's postings.
+            void Facets(const RoaringBitmap& records, const std::vector<std::string_ref>& facets, hcat_transaction* tx,
+                        std::vector<size_t>& counts);
+            
+            // The k records with the best BM25 score for any of the terms,
+            // best first. Only sees ranked postings, the ones written by a
+            // BulkIndexBuilder with frequencies on.
+            void TopK(const std::vector<std::string_ref>& terms, size_t k, hcat_transaction* tx, std::vector<scored_record>& results);
+            
+            // Approximate number of records containing the term, or any term
+            // it matches when it ends in *, from the term sketches. Nothing
+            // is decoded and deletes are not subtracted.
+            uint64_t EstimateCount(std::string_ref term, hcat_transaction* tx);
         private:
-            Store* store;
+            // Decoded posting lists of one query. A deque so the lists don't
+            // move while views into them are held.
+            typedef std::deque<std::vector<uint32_t>> posting_buffers;
+            
+            std::string_ref keyspace;
+            IndexDictionary* dictionary;
+            QueryCache* cache;
+            SegmentStore segments;
+            RankedPostingsStore ranked_postings;
+            PositionsStore positions;
+            TombstoneStore tombstones;
+            TermSketches sketches;
+            
+            void GetTermIds(std::string_ref term, hcat_transaction* tx, std::vector<uint32_t>& term_ids);
+            void GetTermPostings(std::string_ref term, hcat_transaction* tx, std::vector<posting_list>& postings, posting_buffers& buffers);
+            void Union(std::vector<posting_list>& postings, std::vector<uint32_t>& record_ids);
+            size_t EstimateGroup(const std::vector<uint32_t>& term_ids, hcat_transaction* tx);
+            void Intersect(std::vector<std::vector<uint32_t>>& term_ids, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            bool GetPhraseTermIds(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint32_t>& term_ids);
+            std::string GetCacheKey(std::vector<std::vector<uint32_t>>& term_ids, hcat_transaction* tx);
         };
     }
-}
\ No newline at end of file
+}
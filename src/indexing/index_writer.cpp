@@ -1,6 +1,8 @@
 #include "index_writer.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <vector>
 #include "../simd_compression/codecfactory.h"
 #include "../simd_compression/intersection.h"
 #include "../hellcat.h"
@@ -9,14 +11,12 @@
 
 using namespace hellcat::storage;
 
-//const uint32_t segment_size = 128;
-const uint32_t segment_size = 1024;
-
 namespace hellcat {
     namespace indexing {
-        IndexWriter::IndexWriter(std::string_ref keyspace)
+        IndexWriter::IndexWriter(std::string_ref keyspace, IndexDictionary* dictionary, SegmentMerger* merger, uint32_t segment_size) :
+            keyspace(keyspace), dictionary(dictionary), merger(merger), segments(keyspace), positions(keyspace), tombstones(keyspace),
+            sketches(keyspace), segment_size(segment_size)
         {
-            this->keyspace = keyspace;
         }
         
         IndexWriter::~IndexWriter()
@@ -25,64 +25,110 @@ namespace hellcat {
         
         void IndexWriter::SetRecord(std::string_ref term, uint32_t record_id, hcat_transaction* tx)
         {
-            /*
-            auto segment_index = record_id % segment_size;
-            auto segment_id = (record_id / segment_size) + (segment_size > 0);
-            
-            std::ostringstream stream;
-            stream << term.data() << ":" << segment_id;
+            // New record ids go into the term's uncompressed tail, a full
+            // tail is sealed into a compressed segment.
+            uint32_t term_id = dictionary->AddTerm(term, tx);
+            posting_list tail = segments.GetTail(term_id, tx);
+            std::vector<uint32_t> postings(tail.record_ids, tail.record_ids + tail.count);
             
-            hcat_keypair pair;
-            pair.keyspace = this->keyspace;
-            pair.key = stream.str();
-            
-            if (tx->get(&pair) == HCAT_SUCCESS)
+            if (postings.empty() || postings.back() < record_id)
             {
-                //uint32_t count = *reinterpret_cast<uint32_t*>(pair.value);
+                // Record ids mostly arrive in order, this is the common case.
+                postings.push_back(record_id);
             }
             else
             {
-                uint32_t* segment[segment_size];
-                segment[segment_index] =
-                
+                auto position = std::lower_bound(postings.begin(), postings.end(), record_id);
+                if (*position == record_id)
+                {
+                    return;
+                }
+                postings.insert(position, record_id);
+            }
+            sketches.Add(term_id, record_id, tx);
+            
+            if (postings.size() < segment_size)
+            {
+                segments.SetTail(term_id, postings.data(), postings.size(), tx);
+                return;
             }
-            */
             
-            //std::ostringstream key;
-            //key << "$term:" << term.data();
-            std::string key;
-            key.reserve(6 + term.length());
-            key.append("$term:");
-            key.append(term.data());
+            std::vector<segment_info> directory;
+            segments.GetSegments(term_id, tx, directory);
+            directory.push_back(segments.WriteSegment(term_id, postings.data(), postings.size(), tx));
+            segments.SetSegments(term_id, directory, tx);
+            segments.SetTail(term_id, NULL, 0, tx);
             
-            hcat_keypair pair;
-            pair.keyspace = this->keyspace;
-            pair.key = key;
+            if (merger != NULL && directory.size() >= merger->GetMergeFactor())
+            {
+                merger->Schedule(term_id);
+            }
+        }
+        
+        void IndexWriter::SetRecord(std::string_ref term, uint32_t record_id, const std::vector<uint32_t>& positions, hcat_transaction* tx)
+        {
+            SetRecord(term, record_id, tx);
+            this->positions.SetPositions(dictionary->AddTerm(term, tx), record_id, positions.data(), positions.size(), tx);
+        }
+        
+        void IndexWriter::RemoveRecord(std::string_ref term, uint32_t record_id, hcat_transaction* tx)
+        {
+            uint32_t term_id = dictionary->GetTermId(term, tx);
+            if (term_id == 0)
+            {
+                return;
+            }
             
-            if (tx->get(&pair) == HCAT_SUCCESS)
+            std::vector<segment_info> directory;
+            std::vector<uint32_t> postings;
+            segments.GetSegments(term_id, tx, directory);
+            for (size_t i = 0; i < directory.size(); i++)
             {
-                //cout << "LEN: " << pair.value_length << endl;
-                uint32_t* segment = (uint32_t*)pair.value;
-                for (int i=0; i< segment_size; i++)
+                segment_info old_segment = directory[i];
+                if (old_segment.count == 0 || record_id < old_segment.first || record_id > old_segment.last)
+                {
+                    continue;
+                }
+                segments.ReadSegment(term_id, old_segment, tx, postings);
+                auto position = std::lower_bound(postings.begin(), postings.end(), record_id);
+                if (position == postings.end() || *position != record_id)
+                {
+                    continue;
+                }
+                postings.erase(position);
+                
+                // The rewritten segment gets a new id, ids are never reused.
+                directory.erase(directory.begin() + i);
+                if (!postings.empty())
                 {
-                    //cout << i << "\t" << segment[i] << endl;
-                    if (segment[i] == 0)
-                    {
-                        //cout << i << "\t" << key.str() << "\t\tREC: " << record_id << endl;
-                        segment[i] = record_id;
-                        tx->set(&pair);
-                        break;
-                    }
+                    directory.insert(directory.begin() + i, segments.WriteSegment(term_id, postings.data(), postings.size(), tx));
                 }
+                else
+                {
+                    i--;
+                }
+                segments.SetSegments(term_id, directory, tx);
+                segments.DropSegment(term_id, old_segment, tx);
             }
-            else
+            
+            posting_list tail = segments.GetTail(term_id, tx);
+            postings.assign(tail.record_ids, tail.record_ids + tail.count);
+            auto position = std::lower_bound(postings.begin(), postings.end(), record_id);
+            if (position == postings.end() || *position != record_id)
             {
-                uint32_t* segment = new uint32_t[segment_size];
-                segment[0] = record_id;
-                pair.value = segment;
-                pair.value_length = segment_size;
-                tx->set(&pair);
+                return;
             }
+            postings.erase(position);
+
+            // A shorter tail could repeat an earlier generation with other
+            // contents, the new version tells them apart.
+            segments.SetTail(term_id, postings.data(), postings.size(), tx);
+            segments.BumpVersion(term_id, tx);
+        }
+        
+        void IndexWriter::DeleteRecord(uint32_t record_id, hcat_transaction* tx)
+        {
+            tombstones.Delete(record_id, tx);
         }
     }
 }
@@ -3,6 +3,12 @@
 #include "../hellcat.h"
 #include "../string_ref.h"
 #include "../storage/store.h"
+#include "index_dictionary.h"
+#include "positions.h"
+#include "segment_merger.h"
+#include "segment_store.h"
+#include "term_sketches.h"
+#include "tombstones.h"
 
 using namespace hellcat::storage;
 
@@ -12,11 +18,32 @@ namespace hellcat {
         class IndexWriter
         {
         public:
-            IndexWriter(std::string_ref keyspace);
+            IndexWriter(std::string_ref keyspace, IndexDictionary* dictionary, SegmentMerger* merger = NULL, uint32_t segment_size = 1024);
             ~IndexWriter();
             void SetRecord(std::string_ref term, uint32_t record_id, hcat_transaction* tx);
+            
+            // Also stores the sorted token positions of the term in the
+            // record for phrase and proximity queries.
+            void SetRecord(std::string_ref term, uint32_t record_id, const std::vector<uint32_t>& positions, hcat_transaction* tx);
+            
+            // Takes the record out of the term's postings. Segments holding it
+            // are rewritten under a new id, a tail holding it is rewritten in
+            // place and the term's version bumped so a generation of the term
+            // never comes back with other contents.
+            void RemoveRecord(std::string_ref term, uint32_t record_id, hcat_transaction* tx);
+            
+            // Deletes the record from every term at once without touching
+            // the postings, see TombstoneStore.
+            void DeleteRecord(uint32_t record_id, hcat_transaction* tx);
         private:
             std::string_ref keyspace;
+            IndexDictionary* dictionary;
+            SegmentMerger* merger;
+            SegmentStore segments;
+            PositionsStore positions;
+            TombstoneStore tombstones;
+            TermSketches sketches;
+            const uint32_t segment_size;
         };
     }
 }
@@ -0,0 +1,188 @@
+#include <string.h>
+#include <algorithm>
+#include "partitioned_index.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static void get_partitions(std::string_ref keyspace, hcat_transaction* tx, std::vector<uint32_t>& partitions)
+        {
+            partitions.clear();
+            hcat_keypair pair;
+            pair.keyspace = keyspace;
+            pair.key = string_ref("$partitions");
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return;
+            }
+            uint32_t count;
+            memcpy(&count, pair.value, sizeof(count));
+            partitions.resize(count);
+            memcpy(partitions.data(), reinterpret_cast<const uint8_t*>(pair.value) + sizeof(count), count * sizeof(uint32_t));
+        }
+
+        static void add_partition(std::string_ref keyspace, uint32_t partition, hcat_transaction* tx)
+        {
+            std::vector<uint32_t> partitions;
+            get_partitions(keyspace, tx, partitions);
+            auto position = std::lower_bound(partitions.begin(), partitions.end(), partition);
+            if (position != partitions.end() && *position == partition)
+            {
+                return;
+            }
+            partitions.insert(position, partition);
+
+            std::vector<uint32_t> value;
+            value.push_back(static_cast<uint32_t>(partitions.size()));
+            value.insert(value.end(), partitions.begin(), partitions.end());
+            hcat_keypair pair;
+            pair.keyspace = keyspace;
+            pair.key = string_ref("$partitions");
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size() * sizeof(uint32_t));
+            tx->set(&pair);
+        }
+
+        std::string PartitionedIndexWriter::PartitionKeyspace(std::string_ref keyspace, uint32_t partition)
+        {
+            if (partition == 0)
+            {
+                return keyspace.str();
+            }
+            return keyspace.str() + "#" + std::to_string(partition);
+        }
+
+        PartitionedIndexWriter::PartitionedIndexWriter(std::string_ref keyspace, IndexDictionary* dictionary, uint32_t segment_size) :
+            keyspace(keyspace), dictionary(dictionary), segment_size(segment_size), partitions_lock(), keyspaces(), writers()
+        {
+        }
+
+        PartitionedIndexWriter::~PartitionedIndexWriter()
+        {
+        }
+
+        IndexWriter* PartitionedIndexWriter::GetWriter(uint64_t record_id, hcat_transaction* tx)
+        {
+            uint32_t partition = static_cast<uint32_t>(record_id >> 32);
+            if (partition != 0)
+            {
+                // Every transaction that writes to a partition lists it, in
+                // case an earlier one was aborted.
+                add_partition(this->keyspace, partition, tx);
+            }
+
+            std::lock_guard<std::mutex> lock(partitions_lock);
+            std::unique_ptr<IndexWriter>& writer = writers[partition];
+            if (!writer)
+            {
+                std::unique_ptr<std::string>& name = keyspaces[partition];
+                name.reset(new std::string(PartitionKeyspace(this->keyspace, partition)));
+                writer.reset(new IndexWriter(*name, dictionary, NULL, segment_size));
+            }
+            return writer.get();
+        }
+
+        void PartitionedIndexWriter::SetRecord(std::string_ref term, uint64_t record_id, hcat_transaction* tx)
+        {
+            GetWriter(record_id, tx)->SetRecord(term, static_cast<uint32_t>(record_id), tx);
+        }
+
+        void PartitionedIndexWriter::SetRecord(std::string_ref term, uint64_t record_id, const std::vector<uint32_t>& positions,
+                                               hcat_transaction* tx)
+        {
+            GetWriter(record_id, tx)->SetRecord(term, static_cast<uint32_t>(record_id), positions, tx);
+        }
+
+        void PartitionedIndexWriter::RemoveRecord(std::string_ref term, uint64_t record_id, hcat_transaction* tx)
+        {
+            GetWriter(record_id, tx)->RemoveRecord(term, static_cast<uint32_t>(record_id), tx);
+        }
+
+        void PartitionedIndexWriter::DeleteRecord(uint64_t record_id, hcat_transaction* tx)
+        {
+            GetWriter(record_id, tx)->DeleteRecord(static_cast<uint32_t>(record_id), tx);
+        }
+
+        PartitionedIndexReader::PartitionedIndexReader(std::string_ref keyspace, IndexDictionary* dictionary, QueryCache* cache) :
+            keyspace(keyspace), dictionary(dictionary), cache(cache), partitions_lock(), keyspaces(), readers()
+        {
+        }
+
+        PartitionedIndexReader::~PartitionedIndexReader()
+        {
+        }
+
+        void PartitionedIndexReader::GetPartitions(hcat_transaction* tx, std::vector<uint32_t>& partitions)
+        {
+            get_partitions(this->keyspace, tx, partitions);
+            partitions.insert(partitions.begin(), 0);
+        }
+
+        IndexReader* PartitionedIndexReader::GetReader(uint32_t partition)
+        {
+            std::lock_guard<std::mutex> lock(partitions_lock);
+            std::unique_ptr<IndexReader>& reader = readers[partition];
+            if (!reader)
+            {
+                std::unique_ptr<std::string>& name = keyspaces[partition];
+                name.reset(new std::string(PartitionedIndexWriter::PartitionKeyspace(this->keyspace, partition)));
+                reader.reset(new IndexReader(*name, dictionary, partition == 0 ? cache : NULL));
+            }
+            return reader.get();
+        }
+
+        template <class Query>
+        void PartitionedIndexReader::Run(hcat_transaction* tx, std::vector<uint64_t>& record_ids, Query query)
+        {
+            // Partitions are sorted by their high half so appending their
+            // results in turn keeps the ids sorted.
+            record_ids.clear();
+            std::vector<uint32_t> partitions;
+            GetPartitions(tx, partitions);
+            std::vector<uint32_t> low;
+            for (uint32_t partition : partitions)
+            {
+                low.clear();
+                query(GetReader(partition), low);
+                uint64_t high = static_cast<uint64_t>(partition) << 32;
+                for (uint32_t record_id : low)
+                {
+                    record_ids.push_back(high | record_id);
+                }
+            }
+        }
+
+        void PartitionedIndexReader::And(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids)
+        {
+            Run(tx, record_ids, [&](IndexReader* reader, std::vector<uint32_t>& low) { reader->And(terms, tx, low); });
+        }
+
+        void PartitionedIndexReader::Or(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids)
+        {
+            Run(tx, record_ids, [&](IndexReader* reader, std::vector<uint32_t>& low) { reader->Or(terms, tx, low); });
+        }
+
+        void PartitionedIndexReader::Phrase(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids)
+        {
+            Run(tx, record_ids, [&](IndexReader* reader, std::vector<uint32_t>& low) { reader->Phrase(terms, tx, low); });
+        }
+
+        void PartitionedIndexReader::Near(const std::vector<std::string_ref>& terms, uint32_t distance, hcat_transaction* tx,
+                                          std::vector<uint64_t>& record_ids)
+        {
+            Run(tx, record_ids, [&](IndexReader* reader, std::vector<uint32_t>& low) { reader->Near(terms, distance, tx, low); });
+        }
+
+        uint64_t PartitionedIndexReader::EstimateCount(std::string_ref term, hcat_transaction* tx)
+        {
+            std::vector<uint32_t> partitions;
+            GetPartitions(tx, partitions);
+            uint64_t count = 0;
+            for (uint32_t partition : partitions)
+            {
+                count += GetReader(partition)->EstimateCount(term, tx);
+            }
+            return count;
+        }
+    }
+}
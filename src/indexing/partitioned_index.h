@@ -0,0 +1,98 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+#include "index_dictionary.h"
+#include "index_reader.h"
+#include "index_writer.h"
+#include "query_cache.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Record ids past 2^32. The high 32 bits of an id pick a partition
+        // and the low 32 bits are indexed in it by a plain IndexWriter, so
+        // the postings stay 32-bit lists and a dense list costs what it did
+        // with 32-bit ids. Every partition is a keyspace of its own:
+        //
+        //   <keyspace>              partition 0, an index written with
+        //                           32-bit ids reads as this partition
+        //   <keyspace>#<high>       partition high
+        //   <keyspace> $partitions  [count][high...] of the partitions
+        //                           past 0, sorted
+        //
+        // All partitions share the dictionary, so term ids are the same in
+        // every partition. A record lives in exactly one partition, queries
+        // run per partition and the results are concatenated in id order.
+        class PartitionedIndexWriter
+        {
+        public:
+            PartitionedIndexWriter(std::string_ref keyspace, IndexDictionary* dictionary, uint32_t segment_size = 1024);
+            ~PartitionedIndexWriter();
+
+            void SetRecord(std::string_ref term, uint64_t record_id, hcat_transaction* tx);
+            void SetRecord(std::string_ref term, uint64_t record_id, const std::vector<uint32_t>& positions, hcat_transaction* tx);
+            void RemoveRecord(std::string_ref term, uint64_t record_id, hcat_transaction* tx);
+            void DeleteRecord(uint64_t record_id, hcat_transaction* tx);
+
+            // Keyspace of a partition, e.g. to run a SegmentMerger on it.
+            // The writers of the partitions don't schedule merges.
+            static std::string PartitionKeyspace(std::string_ref keyspace, uint32_t partition);
+        private:
+            std::string_ref keyspace;
+            IndexDictionary* dictionary;
+            const uint32_t segment_size;
+            std::mutex partitions_lock;
+            std::map<uint32_t, std::unique_ptr<std::string>> keyspaces;
+            std::map<uint32_t, std::unique_ptr<IndexWriter>> writers;
+
+            PartitionedIndexWriter(const PartitionedIndexWriter&) = delete;
+            PartitionedIndexWriter& operator=(const PartitionedIndexWriter&) = delete;
+
+            IndexWriter* GetWriter(uint64_t record_id, hcat_transaction* tx);
+        };
+
+        class PartitionedIndexReader
+        {
+        public:
+            // The cache only serves partition 0, cache keys are term ids and
+            // don't tell keyspaces apart.
+            PartitionedIndexReader(std::string_ref keyspace, IndexDictionary* dictionary, QueryCache* cache = NULL);
+            ~PartitionedIndexReader();
+
+            // Same as the IndexReader queries, over every partition.
+            void And(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids);
+            void Or(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids);
+            void Phrase(const std::vector<std::string_ref>& terms, hcat_transaction* tx, std::vector<uint64_t>& record_ids);
+            void Near(const std::vector<std::string_ref>& terms, uint32_t distance, hcat_transaction* tx, std::vector<uint64_t>& record_ids);
+            uint64_t EstimateCount(std::string_ref term, hcat_transaction* tx);
+
+            // High halves of the partitions holding records, 0 first.
+            void GetPartitions(hcat_transaction* tx, std::vector<uint32_t>& partitions);
+
+            // Reader of one partition, for the queries that stay 32-bit
+            // (TopK, Facets), its record ids are the low halves.
+            IndexReader* GetReader(uint32_t partition);
+        private:
+            std::string_ref keyspace;
+            IndexDictionary* dictionary;
+            QueryCache* cache;
+            std::mutex partitions_lock;
+            std::map<uint32_t, std::unique_ptr<std::string>> keyspaces;
+            std::map<uint32_t, std::unique_ptr<IndexReader>> readers;
+
+            PartitionedIndexReader(const PartitionedIndexReader&) = delete;
+            PartitionedIndexReader& operator=(const PartitionedIndexReader&) = delete;
+
+            template <class Query>
+            void Run(hcat_transaction* tx, std::vector<uint64_t>& record_ids, Query query);
+        };
+    }
+}
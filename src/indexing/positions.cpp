@@ -0,0 +1,107 @@
+#include <string.h>
+#include <string>
+#include "positions.h"
+#include "../simd_compression/codecfactory.h"
+#include "../simd_compression/intersection.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static const char* positions_codec = "fastpfor";
+
+        static std::string positions_key(uint32_t term_id, uint32_t record_id)
+        {
+            return "$positions:" + std::to_string(term_id) + ":" + std::to_string(record_id);
+        }
+
+        PositionsStore::PositionsStore(std::string_ref keyspace) :
+            keyspace(keyspace)
+        {
+        }
+
+        PositionsStore::~PositionsStore()
+        {
+        }
+
+        void PositionsStore::Encode(const uint32_t* positions, size_t count, std::vector<uint32_t>& value)
+        {
+            // FastPFor delta codes in place, work on a copy.
+            std::vector<uint32_t> input(positions, positions + count);
+            std::vector<uint32_t> compressed(count + 1024);
+            size_t words = compressed.size();
+            static const size_t codec = CODECFactory::getId(positions_codec);
+            CODECFactory::getThreadLocal(codec).encodeArray(input.data(), count, compressed.data(), words);
+
+            value.clear();
+            value.reserve(words + 2);
+            value.push_back(static_cast<uint32_t>(count));
+            value.push_back(static_cast<uint32_t>(words));
+            value.insert(value.end(), compressed.begin(), compressed.begin() + words);
+        }
+
+        void PositionsStore::PutPositions(uint32_t term_id, uint32_t record_id, const std::vector<uint32_t>& value, hcat_transaction* tx)
+        {
+            std::string key = positions_key(term_id, record_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = const_cast<uint32_t*>(value.data());
+            pair.value_length = static_cast<uint32_t>(value.size() * sizeof(uint32_t));
+            tx->set(&pair);
+        }
+
+        void PositionsStore::SetPositions(uint32_t term_id, uint32_t record_id, const uint32_t* positions, size_t count, hcat_transaction* tx)
+        {
+            std::vector<uint32_t> value;
+            Encode(positions, count, value);
+            PutPositions(term_id, record_id, value, tx);
+        }
+
+        bool PositionsStore::GetPositions(uint32_t term_id, uint32_t record_id, hcat_transaction* tx, std::vector<uint32_t>& positions)
+        {
+            std::string key = positions_key(term_id, record_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+
+            positions.clear();
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return false;
+            }
+
+            uint32_t header[2];
+            memcpy(header, pair.value, sizeof(header));
+            std::vector<uint32_t> compressed(header[1]);
+            memcpy(compressed.data(), reinterpret_cast<const uint8_t*>(pair.value) + sizeof(header), header[1] * sizeof(uint32_t));
+
+            positions.resize(header[0] + 1024);
+            size_t count = positions.size();
+            static const size_t codec = CODECFactory::getId(positions_codec);
+            CODECFactory::getThreadLocal(codec).decodeArray(compressed.data(), compressed.size(), positions.data(), count);
+            positions.resize(count);
+            return true;
+        }
+
+        size_t OffsetIntersect(const uint32_t* set1, size_t length1, uint32_t offset, const uint32_t* set2, size_t length2, uint32_t* out)
+        {
+            // Shift set1 four positions at a time, then it is a plain
+            // intersection.
+            std::vector<uint32_t> shifted(length1);
+            const __m128i increment = _mm_set1_epi32(static_cast<int>(offset));
+            size_t i = 0;
+            for (; i + 4 <= length1; i += 4)
+            {
+                __m128i positions = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set1 + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(shifted.data() + i), _mm_add_epi32(positions, increment));
+            }
+            for (; i < length1; i++)
+            {
+                shifted[i] = set1[i] + offset;
+            }
+            return SIMDintersection(shifted.data(), length1, set2, length2, out);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Token positions of a term in one record, stored next to the
+        // postings under
+        //
+        //   $positions:<term>:<record>  [count][words][compressed positions]
+        //
+        // so a phrase query only reads the positions of the records that
+        // survived the record id intersection. Positions are delta coded with
+        // FastPFor, short lists end up entirely in its VariableByte tail.
+        //
+        // FastPFor keeps scratch buffers, every thread codes with its own
+        // instance from CODECFactory.
+        class PositionsStore
+        {
+        public:
+            PositionsStore(std::string_ref keyspace);
+            ~PositionsStore();
+
+            // Doesn't touch the store, positions must be sorted.
+            static void Encode(const uint32_t* positions, size_t count, std::vector<uint32_t>& value);
+            void PutPositions(uint32_t term_id, uint32_t record_id, const std::vector<uint32_t>& value, hcat_transaction* tx);
+            void SetPositions(uint32_t term_id, uint32_t record_id, const uint32_t* positions, size_t count, hcat_transaction* tx);
+
+            // False if no positions were stored for the term in the record.
+            bool GetPositions(uint32_t term_id, uint32_t record_id, hcat_transaction* tx, std::vector<uint32_t>& positions);
+        private:
+            std::string_ref keyspace;
+
+            PositionsStore(const PositionsStore&) = delete;
+            PositionsStore& operator=(const PositionsStore&) = delete;
+        };
+
+        // Writes the positions p of set1 for which p + offset is in set2 as
+        // p + offset, so chaining it over the terms of a phrase leaves the
+        // positions of the last term of every occurrence. out must have room
+        // for length1 integers and must not overlap set1 or set2.
+        size_t OffsetIntersect(const uint32_t* set1, size_t length1, uint32_t offset, const uint32_t* set2, size_t length2, uint32_t* out);
+    }
+}
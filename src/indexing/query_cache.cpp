@@ -0,0 +1,119 @@
+#include <chrono>
+#include "query_cache.h"
+#include "../simd_compression/codecfactory.h"
+
+using namespace std::chrono;
+
+namespace hellcat {
+    namespace indexing {
+
+        QueryCache::QueryCache(size_t capacity_bytes, const char* codec) :
+            capacity_bytes(capacity_bytes), codec(CODECFactory::getId(codec)), lock(), entries(), index(), bytes(0),
+            hits(0), misses(0), evictions(0), saved_microseconds(0)
+        {
+        }
+
+        QueryCache::~QueryCache()
+        {
+        }
+
+        size_t QueryCache::Size(const entry& cached)
+        {
+            return sizeof(entry) + cached.key.size() * 2 + cached.compressed.size() * sizeof(uint32_t);
+        }
+
+        bool QueryCache::Get(const std::string& key, std::vector<uint32_t>& record_ids)
+        {
+            uint32_t count;
+            uint64_t cost;
+            std::vector<uint32_t> compressed;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                auto found = index.find(key);
+                if (found == index.end())
+                {
+                    misses++;
+                    return false;
+                }
+                entries.splice(entries.begin(), entries, found->second);
+                count = found->second->count;
+                cost = found->second->cost_microseconds;
+                compressed = found->second->compressed;
+            }
+
+            // Decode outside the lock, other readers only wait for the copy.
+            steady_clock::time_point start = steady_clock::now();
+            record_ids.resize(count + 1024);
+            size_t decoded = record_ids.size();
+            CODECFactory::getThreadLocal(codec).decodeArray(compressed.data(), compressed.size(), record_ids.data(), decoded);
+            record_ids.resize(decoded);
+            uint64_t elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+
+            hits++;
+            if (cost > elapsed)
+            {
+                saved_microseconds += cost - elapsed;
+            }
+            return true;
+        }
+
+        void QueryCache::Put(const std::string& key, const std::vector<uint32_t>& record_ids, uint64_t cost_microseconds)
+        {
+            entry cached;
+            cached.key = key;
+            cached.count = static_cast<uint32_t>(record_ids.size());
+            cached.cost_microseconds = cost_microseconds;
+
+            // The SIMD codecs want 16 byte aligned input and output, the
+            // vectors give us that.
+            std::vector<uint32_t> input(record_ids);
+            cached.compressed.resize(record_ids.size() + 1024);
+            size_t words = cached.compressed.size();
+            CODECFactory::getThreadLocal(codec).encodeArray(input.data(), input.size(), cached.compressed.data(), words);
+            cached.compressed.resize(words);
+            cached.compressed.shrink_to_fit();
+
+            size_t size = Size(cached);
+            if (size > capacity_bytes)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = index.find(key);
+            if (found != index.end())
+            {
+                bytes -= Size(*found->second);
+                entries.erase(found->second);
+                index.erase(found);
+            }
+            entries.push_front(std::move(cached));
+            index[key] = entries.begin();
+            bytes += size;
+
+            while (bytes > capacity_bytes)
+            {
+                bytes -= Size(entries.back());
+                index.erase(entries.back().key);
+                entries.pop_back();
+                evictions++;
+            }
+        }
+
+        query_cache_stats QueryCache::GetStats()
+        {
+            query_cache_stats stats;
+            stats.hits = hits.load();
+            stats.misses = misses.load();
+            stats.evictions = evictions.load();
+            stats.saved_microseconds = saved_microseconds.load();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stats.entries = entries.size();
+                stats.bytes = bytes;
+            }
+            stats.hit_rate = stats.hits + stats.misses == 0 ? 0.0 : static_cast<double>(stats.hits) / (stats.hits + stats.misses);
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hellcat {
+    namespace indexing {
+
+        typedef struct
+        {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+            // Time the hits didn't spend computing their results again,
+            // minus the time spent decoding the cached ones.
+            uint64_t saved_microseconds;
+            uint64_t entries;
+            uint64_t bytes;
+            double hit_rate;
+        } query_cache_stats;
+
+        // Bounded LRU cache of query results, shared by the IndexReaders of
+        // a keyspace. Results are stored compressed with the segment codec.
+        //
+        // Keys are built by the reader from the query's term ids and the
+        // generation of each term's postings as seen by the query's
+        // transaction, so a write to any of the terms makes the old entry
+        // unreachable and it ages out.
+        class QueryCache
+        {
+        public:
+            QueryCache(size_t capacity_bytes = 64 * 1024 * 1024, const char* codec = "s4-bp128-1");
+            ~QueryCache();
+
+            bool Get(const std::string& key, std::vector<uint32_t>& record_ids);
+
+            // cost_microseconds is what computing the result took, a hit
+            // counts it as saved.
+            void Put(const std::string& key, const std::vector<uint32_t>& record_ids, uint64_t cost_microseconds);
+
+            query_cache_stats GetStats();
+        private:
+            typedef struct
+            {
+                std::string key;
+                uint32_t count;
+                uint64_t cost_microseconds;
+                std::vector<uint32_t> compressed;
+            } entry;
+
+            const size_t capacity_bytes;
+            // Id in CODECFactory, every thread codes with its own instance.
+            const size_t codec;
+
+            std::mutex lock;
+            std::list<entry> entries;
+            std::unordered_map<std::string, std::list<entry>::iterator> index;
+            size_t bytes;
+
+            std::atomic<uint64_t> hits;
+            std::atomic<uint64_t> misses;
+            std::atomic<uint64_t> evictions;
+            std::atomic<uint64_t> saved_microseconds;
+
+            QueryCache(const QueryCache&) = delete;
+            QueryCache& operator=(const QueryCache&) = delete;
+
+            static size_t Size(const entry& cached);
+        };
+    }
+}
@@ -0,0 +1,392 @@
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "ranked_postings.h"
+#include "../simd_compression/simdbinarypacking.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        typedef SIMDIntegratedBlockPacker<RegularDeltaSIMD, true> record_packer;
+
+        static const size_t ranked_header_size = 2 * sizeof(uint32_t);
+
+        static inline uint32_t load_uint32(const uint8_t* in)
+        {
+            uint32_t value;
+            memcpy(&value, in, sizeof(uint32_t));
+            return value;
+        }
+
+        // Packs the postings into blocks, delta coding the first block
+        // against previous. Block offsets count the words of data.
+        static void encode_blocks(const uint32_t* records, const uint32_t* frequencies, const uint32_t* lengths, size_t count,
+                                  uint32_t previous, std::vector<ranked_block>& blocks, std::vector<uint32_t>& data)
+        {
+            const uint32_t block_size = RankedPostings::BlockSize;
+            uint32_t block_count = static_cast<uint32_t>((count + block_size - 1) / block_size);
+            blocks.resize(block_count);
+
+            ALIGN16 uint32_t in[block_size];
+            ALIGN16 uint32_t out[block_size];
+            for (uint32_t b = 0; b < block_count; b++)
+            {
+                size_t start = b * block_size;
+                size_t length = count - start < block_size ? count - start : block_size;
+                ranked_block& block = blocks[b];
+                block.last_record_id = records[start + length - 1];
+                block.offset = static_cast<uint32_t>(data.size());
+                block.count = static_cast<uint16_t>(length);
+                block.max_frequency = 0;
+                block.min_length = UINT32_MAX;
+
+                // Padding repeats the last record id, a delta of zero.
+                for (size_t i = 0; i < block_size; i++)
+                {
+                    in[i] = records[start + (i < length ? i : length - 1)];
+                }
+                __m128i init = _mm_set1_epi32(static_cast<int>(previous));
+                __m128i scan = init;
+                block.record_bits = static_cast<uint8_t>(record_packer::maxbits(in, scan));
+                record_packer::packblockwithoutmask(in, out, block.record_bits, init);
+                data.insert(data.end(), out, out + block.record_bits * block_size / 32);
+
+                uint32_t accumulator = 0;
+                for (size_t i = 0; i < block_size; i++)
+                {
+                    in[i] = i < length ? frequencies[start + i] - 1 : 0;
+                    accumulator |= in[i];
+                }
+                for (size_t i = 0; i < length; i++)
+                {
+                    if (frequencies[start + i] > block.max_frequency)
+                    {
+                        block.max_frequency = frequencies[start + i];
+                    }
+                    if (lengths[start + i] < block.min_length)
+                    {
+                        block.min_length = lengths[start + i];
+                    }
+                }
+                block.frequency_bits = static_cast<uint8_t>(gccbits(accumulator));
+                simdpackwithoutmask(in, reinterpret_cast<__m128i*>(out), block.frequency_bits);
+                data.insert(data.end(), out, out + block.frequency_bits * block_size / 32);
+
+                previous = block.last_record_id;
+            }
+        }
+
+        static void write_postings(uint32_t count, const ranked_block* blocks, uint32_t block_count, const uint8_t* data, size_t data_length,
+                                   std::vector<uint8_t>& value)
+        {
+            uint32_t header[2] = { count, block_count };
+            value.resize(ranked_header_size + block_count * sizeof(ranked_block) + data_length);
+            uint8_t* position = value.data();
+            memcpy(position, header, ranked_header_size);
+            if (block_count == 0)
+            {
+                return;
+            }
+            position += ranked_header_size;
+            memcpy(position, blocks, block_count * sizeof(ranked_block));
+            position += block_count * sizeof(ranked_block);
+            memcpy(position, data, data_length);
+        }
+
+        void RankedPostings::Encode(const uint32_t* records, const uint32_t* frequencies, const uint32_t* lengths, size_t count,
+                                    std::vector<uint8_t>& value)
+        {
+            std::vector<ranked_block> blocks;
+            std::vector<uint32_t> data;
+            encode_blocks(records, frequencies, lengths, count, 0, blocks, data);
+            write_postings(static_cast<uint32_t>(count), blocks.data(), static_cast<uint32_t>(blocks.size()),
+                           reinterpret_cast<const uint8_t*>(data.data()), data.size() * sizeof(uint32_t), value);
+        }
+
+        bool RankedPostings::Append(const uint8_t* existing, size_t existing_length, const uint32_t* records, const uint32_t* frequencies,
+                                    const uint32_t* lengths, size_t count, std::vector<uint8_t>& value)
+        {
+            RankedPostingsCursor cursor(existing, existing_length);
+            uint32_t block_count = cursor.BlockCount();
+            uint32_t previous = block_count == 0 ? 0 : cursor.GetBlock(block_count - 1).last_record_id;
+            if (count > 0 && block_count > 0 && records[0] <= previous)
+            {
+                return false;
+            }
+
+            // The existing blocks and their data are copied as they are, the
+            // new blocks go after them with their offsets moved past the
+            // existing data.
+            std::vector<ranked_block> blocks;
+            std::vector<uint32_t> data;
+            for (uint32_t b = 0; b < block_count; b++)
+            {
+                blocks.push_back(cursor.GetBlock(b));
+            }
+            if (block_count > 0)
+            {
+                const uint8_t* existing_data = existing + ranked_header_size + block_count * sizeof(ranked_block);
+                data.resize((existing + existing_length - existing_data) / sizeof(uint32_t));
+                memcpy(data.data(), existing_data, data.size() * sizeof(uint32_t));
+            }
+            std::vector<ranked_block> appended;
+            encode_blocks(records, frequencies, lengths, count, previous, appended, data);
+            blocks.insert(blocks.end(), appended.begin(), appended.end());
+            write_postings(static_cast<uint32_t>(cursor.Count() + count), blocks.data(), static_cast<uint32_t>(blocks.size()),
+                           reinterpret_cast<const uint8_t*>(data.data()), data.size() * sizeof(uint32_t), value);
+            return true;
+        }
+
+        void RankedPostings::Decode(const uint8_t* value, size_t length, std::vector<uint32_t>& records,
+                                    std::vector<uint32_t>& frequencies, std::vector<uint32_t>& lengths)
+        {
+            records.clear();
+            frequencies.clear();
+            lengths.clear();
+            RankedPostingsCursor cursor(value, length);
+            for (; cursor.Valid(); cursor.Next())
+            {
+                records.push_back(cursor.Record());
+                frequencies.push_back(cursor.Frequency());
+                lengths.push_back(cursor.BlockMinLength());
+            }
+        }
+
+        RankedPostingsCursor::RankedPostingsCursor(const uint8_t* value, size_t length) :
+            blocks(NULL), data(NULL), posting_count(0), block_count(0), block(0), shallow(0), index(0), count(0),
+            frequencies_decoded(false), current(), skip()
+        {
+            if (value == NULL || length < ranked_header_size)
+            {
+                return;
+            }
+            posting_count = load_uint32(value);
+            block_count = load_uint32(value + sizeof(uint32_t));
+            blocks = value + ranked_header_size;
+            data = blocks + block_count * sizeof(ranked_block);
+            if (block_count > 0)
+            {
+                DecodeBlock(0);
+                skip = current;
+            }
+        }
+
+        bool RankedPostingsCursor::Valid() const
+        {
+            return block < block_count;
+        }
+
+        uint32_t RankedPostingsCursor::Count() const
+        {
+            return posting_count;
+        }
+
+        uint32_t RankedPostingsCursor::Record() const
+        {
+            return Valid() ? records[index] : UINT32_MAX;
+        }
+
+        uint32_t RankedPostingsCursor::Frequency()
+        {
+            if (!frequencies_decoded)
+            {
+                size_t words = current.frequency_bits * RankedPostings::BlockSize / 32;
+                memcpy(packed, data + (current.offset + current.record_bits * RankedPostings::BlockSize / 32) * sizeof(uint32_t),
+                       words * sizeof(uint32_t));
+                simdunpack(reinterpret_cast<const __m128i*>(packed), frequencies, current.frequency_bits);
+                frequencies_decoded = true;
+            }
+            return frequencies[index] + 1;
+        }
+
+        void RankedPostingsCursor::Next()
+        {
+            if (++index < count)
+            {
+                return;
+            }
+            if (++block < block_count)
+            {
+                DecodeBlock(block);
+            }
+            if (shallow < block)
+            {
+                shallow = block;
+                skip = current;
+            }
+        }
+
+        void RankedPostingsCursor::NextGEQ(uint32_t target)
+        {
+            if (!Valid() || records[index] >= target)
+            {
+                return;
+            }
+            ShallowAdvance(target);
+            if (shallow != block)
+            {
+                block = shallow;
+                if (block == block_count)
+                {
+                    return;
+                }
+                DecodeBlock(block);
+            }
+            index = static_cast<uint32_t>(std::lower_bound(records + index, records + count, target) - records);
+        }
+
+        void RankedPostingsCursor::ShallowAdvance(uint32_t target)
+        {
+            if (shallow < block)
+            {
+                shallow = block;
+                skip = current;
+            }
+            while (shallow < block_count && skip.last_record_id < target)
+            {
+                if (++shallow < block_count)
+                {
+                    skip = GetBlock(shallow);
+                }
+            }
+        }
+
+        bool RankedPostingsCursor::BlockValid() const
+        {
+            return shallow < block_count;
+        }
+
+        uint32_t RankedPostingsCursor::BlockLastRecord() const
+        {
+            return skip.last_record_id;
+        }
+
+        uint32_t RankedPostingsCursor::BlockMaxFrequency() const
+        {
+            return skip.max_frequency;
+        }
+
+        uint32_t RankedPostingsCursor::BlockMinLength() const
+        {
+            return skip.min_length;
+        }
+
+        uint32_t RankedPostingsCursor::BlockCount() const
+        {
+            return block_count;
+        }
+
+        ranked_block RankedPostingsCursor::GetBlock(uint32_t block) const
+        {
+            ranked_block result;
+            memcpy(&result, blocks + block * sizeof(ranked_block), sizeof(ranked_block));
+            return result;
+        }
+
+        void RankedPostingsCursor::DecodeBlock(uint32_t block)
+        {
+            // The packers want aligned input, the store doesn't give us that.
+            current = GetBlock(block);
+            memcpy(packed, data + current.offset * sizeof(uint32_t), current.record_bits * RankedPostings::BlockSize / 32 * sizeof(uint32_t));
+            __m128i init = _mm_set1_epi32(static_cast<int>(block == 0 ? 0 : GetBlock(block - 1).last_record_id));
+            record_packer::unpackblock(packed, records, current.record_bits, init);
+            count = current.count;
+            index = 0;
+            frequencies_decoded = false;
+        }
+
+        RankedPostingsStore::RankedPostingsStore(std::string_ref keyspace) : keyspace(keyspace)
+        {
+        }
+
+        RankedPostingsStore::~RankedPostingsStore()
+        {
+        }
+
+        bool RankedPostingsStore::GetPostings(uint32_t term_id, hcat_transaction* tx, const uint8_t*& value, size_t& length)
+        {
+            std::string key = "$ranked:" + std::to_string(term_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return false;
+            }
+            value = reinterpret_cast<const uint8_t*>(pair.value);
+            length = pair.value_length;
+            return true;
+        }
+
+        void RankedPostingsStore::SetPostings(uint32_t term_id, const std::vector<uint8_t>& value, hcat_transaction* tx)
+        {
+            std::string key = "$ranked:" + std::to_string(term_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = const_cast<uint8_t*>(value.data());
+            pair.value_length = static_cast<uint32_t>(value.size());
+            tx->set(&pair);
+        }
+
+        uint32_t RankedPostingsStore::GetLength(uint32_t record_id, hcat_transaction* tx)
+        {
+            std::string key = "$length:" + std::to_string(record_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return 0;
+            }
+            return load_uint32(reinterpret_cast<const uint8_t*>(pair.value));
+        }
+
+        void RankedPostingsStore::SetLength(uint32_t record_id, uint32_t length, hcat_transaction* tx)
+        {
+            collection_statistics statistics = GetStatistics(tx);
+            uint32_t previous = GetLength(record_id, tx);
+            if (previous == 0)
+            {
+                statistics.document_count++;
+            }
+            statistics.total_length = statistics.total_length - previous + length;
+            SetStatistics(statistics, tx);
+
+            std::string key = "$length:" + std::to_string(record_id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = &length;
+            pair.value_length = sizeof(uint32_t);
+            tx->set(&pair);
+        }
+
+        collection_statistics RankedPostingsStore::GetStatistics(hcat_transaction* tx)
+        {
+            collection_statistics statistics = { 0, 0 };
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = string_ref("$collection");
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                memcpy(&statistics, pair.value, sizeof(statistics));
+            }
+            return statistics;
+        }
+
+        void RankedPostingsStore::SetStatistics(const collection_statistics& statistics, hcat_transaction* tx)
+        {
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = string_ref("$collection");
+            pair.value = const_cast<collection_statistics*>(&statistics);
+            pair.value_length = sizeof(statistics);
+            tx->set(&pair);
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Skip data of one block of up to 128 postings. max_frequency and
+        // min_length bound the score of any posting in the block so whole
+        // blocks can be skipped without decoding them.
+        typedef struct
+        {
+            uint32_t last_record_id;
+            uint32_t offset;
+            uint8_t record_bits;
+            uint8_t frequency_bits;
+            uint16_t count;
+            uint32_t max_frequency;
+            uint32_t min_length;
+        } ranked_block;
+
+        typedef struct
+        {
+            uint64_t document_count;
+            uint64_t total_length;
+        } collection_statistics;
+
+        // Postings that carry term frequencies, stored under
+        // $ranked:<term> next to the plain segments of the term:
+        //
+        //   [posting count][block count][ranked_block...][blocks]
+        //
+        // Each block packs 128 delta coded record ids with
+        // SIMDIntegratedBlockPacker followed by 128 frequencies - 1 with
+        // plain SIMD bit packing. The last block is padded.
+        class RankedPostings
+        {
+        public:
+            static const uint32_t BlockSize = 128;
+
+            // lengths[i] is the length of the document of records[i], or a
+            // lower bound of it.
+            static void Encode(const uint32_t* records, const uint32_t* frequencies, const uint32_t* lengths, size_t count,
+                               std::vector<uint8_t>& value);
+
+            // Encodes existing followed by the postings, which all have to
+            // come after the last record of existing. The existing blocks are
+            // copied, not decoded. Returns false, writing nothing, otherwise.
+            static bool Append(const uint8_t* existing, size_t existing_length, const uint32_t* records, const uint32_t* frequencies,
+                               const uint32_t* lengths, size_t count, std::vector<uint8_t>& value);
+
+            // The inverse of Encode. Lengths come back as the minimum length
+            // of each posting's block, which is still a valid lower bound.
+            static void Decode(const uint8_t* value, size_t length, std::vector<uint32_t>& records,
+                               std::vector<uint32_t>& frequencies, std::vector<uint32_t>& lengths);
+        };
+
+        // Forward cursor over stored ranked postings. Blocks are decoded one
+        // at a time into buffers that stay in L1, frequencies only when asked
+        // for.
+        class RankedPostingsCursor
+        {
+        public:
+            RankedPostingsCursor(const uint8_t* value, size_t length);
+
+            bool Valid() const;
+            uint32_t Count() const;
+            uint32_t Record() const;
+            uint32_t Frequency();
+            void Next();
+
+            // Moves to the first posting with a record id >= target.
+            void NextGEQ(uint32_t target);
+
+            // Moves the skip pointer to the block that would hold target
+            // without decoding anything. The Block* calls describe it.
+            void ShallowAdvance(uint32_t target);
+            bool BlockValid() const;
+            uint32_t BlockLastRecord() const;
+            uint32_t BlockMaxFrequency() const;
+            uint32_t BlockMinLength() const;
+
+            uint32_t BlockCount() const;
+            ranked_block GetBlock(uint32_t block) const;
+        private:
+            const uint8_t* blocks;
+            const uint8_t* data;
+            uint32_t posting_count;
+            uint32_t block_count;
+            uint32_t block;
+            uint32_t shallow;
+            uint32_t index;
+            uint32_t count;
+            bool frequencies_decoded;
+            ranked_block current;
+            ranked_block skip;
+            alignas(16) uint32_t packed[RankedPostings::BlockSize];
+            alignas(16) uint32_t records[RankedPostings::BlockSize];
+            alignas(16) uint32_t frequencies[RankedPostings::BlockSize];
+
+            void DecodeBlock(uint32_t block);
+        };
+
+        // Term frequency postings, document lengths ($length:<record>) and
+        // collection statistics ($collection) of a keyspace.
+        class RankedPostingsStore
+        {
+        public:
+            RankedPostingsStore(std::string_ref keyspace);
+            ~RankedPostingsStore();
+
+            // Points into the store, false if the term has no ranked postings.
+            bool GetPostings(uint32_t term_id, hcat_transaction* tx, const uint8_t*& value, size_t& length);
+            void SetPostings(uint32_t term_id, const std::vector<uint8_t>& value, hcat_transaction* tx);
+
+            // 0 if the length of the record isn't known.
+            uint32_t GetLength(uint32_t record_id, hcat_transaction* tx);
+
+            // Also keeps the collection statistics up to date.
+            void SetLength(uint32_t record_id, uint32_t length, hcat_transaction* tx);
+
+            collection_statistics GetStatistics(hcat_transaction* tx);
+        private:
+            std::string_ref keyspace;
+
+            void SetStatistics(const collection_statistics& statistics, hcat_transaction* tx);
+        };
+    }
+}
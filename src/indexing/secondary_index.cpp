@@ -0,0 +1,324 @@
+#include <string.h>
+#include <algorithm>
+#include "secondary_index.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        // Just enough JSON to pull a top level field out of an object, the
+        // value is trusted to be well formed and anything else is skipped.
+        static void skip_space(const char*& p, const char* end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            {
+                p++;
+            }
+        }
+
+        static bool parse_string(const char*& p, const char* end, std::string& text)
+        {
+            text.clear();
+            if (p == end || *p != '"')
+            {
+                return false;
+            }
+            for (p++; p < end; p++)
+            {
+                if (*p == '"')
+                {
+                    p++;
+                    return true;
+                }
+                if (*p != '\\' || p + 1 == end)
+                {
+                    text.push_back(*p);
+                    continue;
+                }
+                switch (*++p)
+                {
+                    case 'n': text.push_back('\n'); break;
+                    case 't': text.push_back('\t'); break;
+                    case 'r': text.push_back('\r'); break;
+                    case 'b': text.push_back('\b'); break;
+                    case 'f': text.push_back('\f'); break;
+                    // \uXXXX stays escaped, it still makes a stable term.
+                    case 'u': text.append("\\u"); break;
+                    default: text.push_back(*p); break;
+                }
+            }
+            return false;
+        }
+
+        static bool skip_value(const char*& p, const char* end)
+        {
+            std::string ignored;
+            skip_space(p, end);
+            if (p == end)
+            {
+                return false;
+            }
+            if (*p == '"')
+            {
+                return parse_string(p, end, ignored);
+            }
+            if (*p == '{' || *p == '[')
+            {
+                // Nested containers only need their brackets balanced.
+                int depth = 0;
+                while (p < end)
+                {
+                    if (*p == '"')
+                    {
+                        if (!parse_string(p, end, ignored))
+                        {
+                            return false;
+                        }
+                        continue;
+                    }
+                    if (*p == '{' || *p == '[')
+                    {
+                        depth++;
+                    }
+                    else if ((*p == '}' || *p == ']') && --depth == 0)
+                    {
+                        p++;
+                        return true;
+                    }
+                    p++;
+                }
+                return false;
+            }
+            while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+            {
+                p++;
+            }
+            return true;
+        }
+
+        static void scalar_term(const char*& p, const char* end, std::vector<std::string>& terms)
+        {
+            skip_space(p, end);
+            const char* start = p;
+            if (p < end && *p == '"')
+            {
+                std::string text;
+                if (parse_string(p, end, text))
+                {
+                    terms.push_back(text);
+                }
+                return;
+            }
+            if (p < end && (*p == '{' || *p == '[' || *p == 'n'))
+            {
+                // Objects, nested arrays and null aren't indexed.
+                skip_value(p, end);
+                return;
+            }
+            skip_value(p, end);
+            if (p > start)
+            {
+                terms.push_back(std::string(start, p - start));
+            }
+        }
+
+        static void json_field_terms(const std::string& field, const char* p, const char* end, std::vector<std::string>& terms)
+        {
+            std::string key;
+            skip_space(p, end);
+            if (p == end || *p != '{')
+            {
+                return;
+            }
+            p++;
+            while (p < end)
+            {
+                skip_space(p, end);
+                if (!parse_string(p, end, key))
+                {
+                    return;
+                }
+                skip_space(p, end);
+                if (p == end || *p != ':')
+                {
+                    return;
+                }
+                p++;
+                skip_space(p, end);
+                if (key != field)
+                {
+                    if (!skip_value(p, end))
+                    {
+                        return;
+                    }
+                }
+                else if (p < end && *p == '[')
+                {
+                    for (p++; p < end; )
+                    {
+                        skip_space(p, end);
+                        if (p < end && *p == ']')
+                        {
+                            break;
+                        }
+                        scalar_term(p, end, terms);
+                        skip_space(p, end);
+                        if (p == end || *p != ',')
+                        {
+                            break;
+                        }
+                        p++;
+                    }
+                    return;
+                }
+                else
+                {
+                    scalar_term(p, end, terms);
+                    return;
+                }
+                skip_space(p, end);
+                if (p == end || *p != ',')
+                {
+                    return;
+                }
+                p++;
+            }
+        }
+
+        static void split(const std::string& text, char delimiter, std::vector<std::string>& parts)
+        {
+            size_t start = 0;
+            for (size_t i = 0; i <= text.size(); i++)
+            {
+                if (i == text.size() || text[i] == delimiter)
+                {
+                    parts.push_back(text.substr(start, i - start));
+                    start = i + 1;
+                }
+            }
+        }
+
+        void SecondaryIndex::Extract(const index_definition& definition, const char* value, size_t length, std::vector<std::string>& terms)
+        {
+            std::vector<std::string> fields;
+            if (definition.source == INDEX_JSON_FIELD)
+            {
+                json_field_terms(definition.field, value, value + length, fields);
+            }
+            else
+            {
+                std::vector<std::string> columns;
+                split(std::string(value, length), definition.delimiter, columns);
+                if (definition.column < columns.size())
+                {
+                    fields.push_back(columns[definition.column]);
+                }
+            }
+
+            terms.clear();
+            for (auto& field : fields)
+            {
+                if (definition.tag_delimiter == 0)
+                {
+                    terms.push_back(field);
+                }
+                else
+                {
+                    split(field, definition.tag_delimiter, terms);
+                }
+            }
+            terms.erase(std::remove(terms.begin(), terms.end(), std::string()), terms.end());
+            std::sort(terms.begin(), terms.end());
+            terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+        }
+
+        SecondaryIndex::SecondaryIndex(std::string_ref keyspace, const index_definition& definition, SegmentMerger* merger) :
+            definition(definition), index_keyspace(keyspace.str() + "." + definition.name), keys_keyspace(index_keyspace + ".keys"),
+            terms(index_keyspace), keys(keys_keyspace), writer(index_keyspace, &terms, merger), reader(index_keyspace, &terms)
+        {
+        }
+
+        void SecondaryIndex::Flush(hcat_transaction* tx)
+        {
+            terms.Flush(tx);
+            keys.Flush(tx);
+        }
+
+        void SecondaryIndex::committing(hcat_transaction* tx)
+        {
+            Flush(tx);
+        }
+
+        uint32_t SecondaryIndex::GetRecordId(std::string_ref key, hcat_transaction* tx)
+        {
+            uint32_t record_id = keys.GetTermId(key, tx);
+            if (record_id != 0)
+            {
+                return record_id;
+            }
+
+            record_id = keys.AddTerm(key, tx);
+            std::string reverse_key = "$key:" + std::to_string(record_id);
+            std::string stored = key.str();
+            hcat_keypair pair;
+            pair.keyspace = this->keys_keyspace;
+            pair.key = reverse_key;
+            pair.value = const_cast<char*>(stored.c_str());
+            pair.value_length = static_cast<uint32_t>(stored.size());
+            tx->set(&pair);
+            return record_id;
+        }
+
+        void SecondaryIndex::update(hcat_keypair* pair, const void* previous_value, uint32_t previous_length, hcat_transaction* tx)
+        {
+            std::vector<std::string> previous_terms;
+            std::vector<std::string> current_terms;
+            if (previous_value != NULL)
+            {
+                Extract(definition, reinterpret_cast<const char*>(previous_value), previous_length, previous_terms);
+            }
+            Extract(definition, reinterpret_cast<const char*>(pair->value), pair->value_length, current_terms);
+            if (previous_terms == current_terms)
+            {
+                return;
+            }
+
+            tx->add_listener(this);
+            uint32_t record_id = GetRecordId(pair->key, tx);
+            std::vector<std::string> changed;
+            std::set_difference(previous_terms.begin(), previous_terms.end(), current_terms.begin(), current_terms.end(),
+                                std::back_inserter(changed));
+            for (auto& term : changed)
+            {
+                writer.RemoveRecord(term, record_id, tx);
+            }
+            changed.clear();
+            std::set_difference(current_terms.begin(), current_terms.end(), previous_terms.begin(), previous_terms.end(),
+                                std::back_inserter(changed));
+            for (auto& term : changed)
+            {
+                writer.SetRecord(term, record_id, tx);
+            }
+        }
+
+        void SecondaryIndex::Find(std::string_ref value, hcat_transaction* tx, std::vector<std::string>& record_keys)
+        {
+            std::vector<uint32_t> record_ids;
+            std::vector<std::string_ref> query(1, value);
+            reader.Or(query, tx, record_ids);
+
+            record_keys.clear();
+            for (uint32_t record_id : record_ids)
+            {
+                std::string reverse_key = "$key:" + std::to_string(record_id);
+                hcat_keypair pair;
+                pair.keyspace = this->keys_keyspace;
+                pair.key = reverse_key;
+                if (tx->get(&pair) == HCAT_SUCCESS)
+                {
+                    // The store hands back one byte more than was set.
+                    record_keys.push_back(std::string(reinterpret_cast<const char*>(pair.value), pair.value_length - 1));
+                }
+            }
+        }
+    }
+}
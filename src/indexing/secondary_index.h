@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+#include "index_dictionary.h"
+#include "index_reader.h"
+#include "index_writer.h"
+#include "segment_merger.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        typedef enum
+        {
+            // The value is a JSON object, index one of its top level fields.
+            // A string, number or boolean is one term, an array is a tag list
+            // with one term per element.
+            INDEX_JSON_FIELD,
+            // The value is a delimited record, index one of its columns.
+            INDEX_DELIMITED_FIELD
+        } index_source;
+
+        typedef struct
+        {
+            std::string name;
+            index_source source;
+            // INDEX_JSON_FIELD
+            std::string field;
+            // INDEX_DELIMITED_FIELD
+            char delimiter;
+            uint32_t column;
+            // Splits the extracted value into tags, 0 to index it whole.
+            char tag_delimiter;
+        } index_definition;
+
+        // Inverted index over a field of the values of a keyspace, kept up to
+        // date by the store: register it with Store::add_index and every set
+        // in the keyspace indexes the new value and takes the terms of the
+        // value it replaced out of the index, in the same transaction.
+        //
+        // Lives in two keyspaces of its own, <keyspace>.<name> for the terms
+        // and postings and <keyspace>.<name>.keys which numbers the record
+        // keys and maps the numbers back ($key:<id>). Given a SegmentMerger
+        // over <keyspace>.<name>, which the caller starts and stops, sealed
+        // segments are scheduled on it for merging.
+        //
+        // New terms and keys are persisted by the dictionaries in batches,
+        // the batch in progress is flushed when a transaction that updated
+        // the index commits. Those transactions have to end before the
+        // index is destroyed.
+        class SecondaryIndex : public ValueIndex, public hcat_transaction_listener
+        {
+        public:
+            SecondaryIndex(std::string_ref keyspace, const index_definition& definition, SegmentMerger* merger = NULL);
+
+            void update(hcat_keypair* pair, const void* previous_value, uint32_t previous_length, hcat_transaction* tx);
+
+            // Persists the batch of new terms and keys in progress, done when
+            // tx commits.
+            void Flush(hcat_transaction* tx);
+            void committing(hcat_transaction* tx);
+
+            // Keys of the records whose field holds value (or the tag). A
+            // value ending in * matches every term starting with the rest.
+            void Find(std::string_ref value, hcat_transaction* tx, std::vector<std::string>& record_keys);
+
+            // The terms the definition extracts from a value, sorted and
+            // without duplicates.
+            static void Extract(const index_definition& definition, const char* value, size_t length, std::vector<std::string>& terms);
+        private:
+            const index_definition definition;
+            const std::string index_keyspace;
+            const std::string keys_keyspace;
+            IndexDictionary terms;
+            IndexDictionary keys;
+            IndexWriter writer;
+            IndexReader reader;
+
+            SecondaryIndex(const SecondaryIndex&) = delete;
+            SecondaryIndex& operator=(const SecondaryIndex&) = delete;
+
+            uint32_t GetRecordId(std::string_ref key, hcat_transaction* tx);
+        };
+    }
+}
@@ -0,0 +1,279 @@
+#include <vector>
+#include "segment_merger.h"
+#include "../simd_compression/union.h"
+
+using namespace std::chrono;
+
+namespace hellcat {
+    namespace indexing {
+
+        SegmentMerger::SegmentMerger(Store* store, std::string_ref keyspace, uint32_t merge_factor,
+                                     uint64_t bytes_per_second, uint32_t max_cpu_percent) :
+            store(store), segments(keyspace), tombstones(keyspace), merge_factor(merge_factor < 2 ? 2 : merge_factor),
+            bytes_per_second(bytes_per_second), max_cpu_percent(max_cpu_percent == 0 ? 1 : (max_cpu_percent > 100 ? 100 : max_cpu_percent)),
+            pending_lock(), pending_changed(), pending_terms(), stopping(false), worker(),
+            merges(0), segments_merged(0), postings_merged(0), postings_purged(0), bytes_read(0), bytes_written(0), throttled_microseconds(0)
+        {
+        }
+
+        SegmentMerger::~SegmentMerger()
+        {
+            Stop();
+        }
+
+        void SegmentMerger::Start()
+        {
+            std::lock_guard<std::mutex> lock(pending_lock);
+            if (!worker.joinable())
+            {
+                stopping = false;
+                worker = std::thread(&SegmentMerger::Run, this);
+            }
+        }
+
+        void SegmentMerger::Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(pending_lock);
+                stopping = true;
+            }
+            pending_changed.notify_all();
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+
+        void SegmentMerger::Schedule(uint32_t term_id)
+        {
+            {
+                std::lock_guard<std::mutex> lock(pending_lock);
+                pending_terms.insert(term_id);
+            }
+            pending_changed.notify_one();
+        }
+
+        uint32_t SegmentMerger::GetMergeFactor() const
+        {
+            return merge_factor;
+        }
+
+        segment_merge_stats SegmentMerger::GetStats()
+        {
+            segment_merge_stats stats;
+            stats.merges = merges.load();
+            stats.segments_merged = segments_merged.load();
+            stats.postings_merged = postings_merged.load();
+            stats.postings_purged = postings_purged.load();
+            stats.bytes_read = bytes_read.load();
+            stats.bytes_written = bytes_written.load();
+            stats.throttled_microseconds = throttled_microseconds.load();
+
+            std::lock_guard<std::mutex> lock(pending_lock);
+            stats.pending_terms = pending_terms.size();
+            return stats;
+        }
+
+        uint32_t SegmentMerger::Tier(uint32_t count) const
+        {
+            uint32_t tier = 0;
+            while (count >= merge_factor)
+            {
+                count /= merge_factor;
+                tier++;
+            }
+            return tier;
+        }
+
+        bool SegmentMerger::Merge(uint32_t term_id, hcat_transaction* tx)
+        {
+            segment_merge merge;
+            return PrepareMerge(term_id, tx, merge) && ApplyMerge(term_id, merge, tx);
+        }
+
+        bool SegmentMerger::PrepareMerge(uint32_t term_id, hcat_transaction* tx, segment_merge& merge)
+        {
+            std::vector<segment_info> directory;
+            segments.GetSegments(term_id, tx, directory);
+            if (directory.size() < merge_factor)
+            {
+                return false;
+            }
+
+            // Smallest full tier first, small segments are the cheapest to
+            // merge and the most common.
+            std::vector<uint32_t> tier_sizes;
+            for (auto& segment : directory)
+            {
+                uint32_t tier = Tier(segment.count);
+                if (tier >= tier_sizes.size())
+                {
+                    tier_sizes.resize(tier + 1, 0);
+                }
+                tier_sizes[tier]++;
+            }
+            uint32_t tier = 0;
+            while (tier < tier_sizes.size() && tier_sizes[tier] < merge_factor)
+            {
+                tier++;
+            }
+            if (tier == tier_sizes.size())
+            {
+                return false;
+            }
+
+            merge.victims.clear();
+            for (auto& segment : directory)
+            {
+                if (merge.victims.size() < merge_factor && Tier(segment.count) == tier)
+                {
+                    merge.victims.push_back(segment);
+                }
+            }
+
+            std::vector<std::vector<uint32_t>> decoded(merge.victims.size());
+            std::vector<const uint32_t*> sets;
+            std::vector<size_t> lengths;
+            size_t total = 0;
+            merge.read = 0;
+            for (size_t i = 0; i < merge.victims.size(); i++)
+            {
+                segments.ReadSegment(term_id, merge.victims[i], tx, decoded[i]);
+                sets.push_back(decoded[i].data());
+                lengths.push_back(decoded[i].size());
+                total += decoded[i].size();
+                merge.read += merge.victims[i].words * sizeof(uint32_t);
+            }
+            std::vector<uint32_t> record_ids(total);
+            record_ids.resize(SIMDmultiunion(sets.data(), lengths.data(), sets.size(), record_ids.data()));
+            merge.unioned = record_ids.size();
+            tombstones.RemoveDeleted(tx, record_ids);
+
+            // Encoded even when every record was deleted so segment ids, and
+            // the generation of the term, keep growing.
+            merge.merged = segments.EncodeSegment(record_ids.data(), record_ids.size(), merge.value);
+            return true;
+        }
+
+        bool SegmentMerger::ApplyMerge(uint32_t term_id, segment_merge& merge, hcat_transaction* tx)
+        {
+            // Another merge or a RemoveRecord may have replaced victims since
+            // they were read. Segment ids are never reused so a victim still
+            // listed under its id is the segment that was read.
+            std::vector<segment_info> directory;
+            segments.GetSegments(term_id, tx, directory);
+            std::vector<segment_info> survivors;
+            size_t found = 0;
+            for (auto& segment : directory)
+            {
+                bool victim = false;
+                for (auto& candidate : merge.victims)
+                {
+                    victim = victim || candidate.id == segment.id;
+                }
+                if (victim)
+                {
+                    found++;
+                }
+                else
+                {
+                    survivors.push_back(segment);
+                }
+            }
+            if (found != merge.victims.size())
+            {
+                return false;
+            }
+
+            // One directory write swaps the merged segment in.
+            segments.PutSegment(term_id, merge.merged, merge.value, tx);
+            for (auto& victim : merge.victims)
+            {
+                segments.DropSegment(term_id, victim, tx);
+            }
+            survivors.push_back(merge.merged);
+            segments.SetSegments(term_id, survivors, tx);
+
+            merges++;
+            segments_merged += merge.victims.size();
+            postings_merged += merge.merged.count;
+            postings_purged += merge.unioned - merge.merged.count;
+            bytes_read += merge.read;
+            bytes_written += merge.merged.words * sizeof(uint32_t);
+            return true;
+        }
+
+        void SegmentMerger::Run()
+        {
+            while (true)
+            {
+                uint32_t term_id;
+                {
+                    std::unique_lock<std::mutex> lock(pending_lock);
+                    pending_changed.wait(lock, [this] { return stopping || !pending_terms.empty(); });
+                    if (stopping)
+                    {
+                        return;
+                    }
+                    term_id = *pending_terms.begin();
+                    pending_terms.erase(pending_terms.begin());
+                }
+
+                steady_clock::time_point start = steady_clock::now();
+                uint64_t io_before = bytes_read.load() + bytes_written.load();
+
+                segment_merge merge;
+                hcat_transaction* tx;
+                if (store->begin_transaction(&tx, 1) != HCAT_SUCCESS)
+                {
+                    continue;
+                }
+                bool prepared = PrepareMerge(term_id, tx, merge);
+                tx->abort();
+                delete tx;
+                if (!prepared || store->begin_transaction(&tx, 0) != HCAT_SUCCESS)
+                {
+                    continue;
+                }
+                bool merged = ApplyMerge(term_id, merge, tx);
+                if (merged)
+                {
+                    tx->commit();
+                }
+                else
+                {
+                    tx->abort();
+                }
+                delete tx;
+
+                if (merged)
+                {
+                    // The merged segment may have filled the next tier.
+                    Schedule(term_id);
+                    Throttle(bytes_read.load() + bytes_written.load() - io_before, steady_clock::now() - start);
+                }
+            }
+        }
+
+        void SegmentMerger::Throttle(uint64_t bytes, steady_clock::duration elapsed)
+        {
+            // Sleep long enough that the merge used at most max_cpu_percent
+            // of a core and bytes_per_second of I/O over the whole period.
+            steady_clock::duration cpu_pause = elapsed * (100 - max_cpu_percent) / max_cpu_percent;
+            steady_clock::duration io_pause = steady_clock::duration::zero();
+            if (bytes_per_second > 0)
+            {
+                io_pause = duration_cast<steady_clock::duration>(microseconds(bytes * 1000000 / bytes_per_second)) - elapsed;
+            }
+            steady_clock::duration pause = cpu_pause > io_pause ? cpu_pause : io_pause;
+            if (pause <= steady_clock::duration::zero())
+            {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(pending_lock);
+            pending_changed.wait_for(lock, pause, [this] { return stopping; });
+            throttled_microseconds += duration_cast<microseconds>(pause).count();
+        }
+    }
+}
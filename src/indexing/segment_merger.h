@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+#include "segment_store.h"
+#include "tombstones.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        typedef struct
+        {
+            uint64_t merges;
+            uint64_t segments_merged;
+            uint64_t postings_merged;
+            uint64_t postings_purged;
+            uint64_t bytes_read;
+            uint64_t bytes_written;
+            uint64_t throttled_microseconds;
+            uint64_t pending_terms;
+        } segment_merge_stats;
+
+        // A merge encoded from a snapshot, waiting to be swapped in.
+        typedef struct
+        {
+            std::vector<segment_info> victims;
+            segment_info merged;
+            std::vector<uint32_t> value;
+            size_t unioned;
+            uint64_t read;
+        } segment_merge;
+
+        // Tiered merging of the sealed segments of a term. A segment of n
+        // postings sits in tier log_merge_factor(n), once a tier holds
+        // merge_factor segments they are merged into one segment of the
+        // next tier, so a term has O(merge_factor * log n) segments.
+        //
+        // The background thread decodes, unions and encodes in a read
+        // transaction and only takes a write transaction to swap the
+        // directory, so writers don't wait on the codec. Readers keep
+        // seeing the old segments in their snapshot until the swap commits.
+        // It sleeps between merges to stay under the configured I/O rate
+        // and share of a core. Records deleted before the merge started are
+        // left out of the merged segment.
+        class SegmentMerger
+        {
+        public:
+            SegmentMerger(Store* store, std::string_ref keyspace, uint32_t merge_factor = 8,
+                          uint64_t bytes_per_second = 16 * 1024 * 1024, uint32_t max_cpu_percent = 25);
+            ~SegmentMerger();
+
+            void Start();
+            void Stop();
+
+            // Queues a term whose segments may need merging.
+            void Schedule(uint32_t term_id);
+
+            // Merges one tier of the term's segments in tx, a write
+            // transaction. Returns false if no tier is full.
+            bool Merge(uint32_t term_id, hcat_transaction* tx);
+
+            uint32_t GetMergeFactor() const;
+            segment_merge_stats GetStats();
+        private:
+            Store* store;
+            SegmentStore segments;
+            TombstoneStore tombstones;
+            const uint32_t merge_factor;
+            const uint64_t bytes_per_second;
+            const uint32_t max_cpu_percent;
+
+            std::mutex pending_lock;
+            std::condition_variable pending_changed;
+            std::set<uint32_t> pending_terms;
+            bool stopping;
+            std::thread worker;
+
+            std::atomic<uint64_t> merges;
+            std::atomic<uint64_t> segments_merged;
+            std::atomic<uint64_t> postings_merged;
+            std::atomic<uint64_t> postings_purged;
+            std::atomic<uint64_t> bytes_read;
+            std::atomic<uint64_t> bytes_written;
+            std::atomic<uint64_t> throttled_microseconds;
+
+            SegmentMerger(const SegmentMerger&) = delete;
+            SegmentMerger& operator=(const SegmentMerger&) = delete;
+
+            uint32_t Tier(uint32_t count) const;
+
+            // Picks the victims and encodes their union, only reads tx.
+            bool PrepareMerge(uint32_t term_id, hcat_transaction* tx, segment_merge& merge);
+
+            // Swaps the merged segment in for the victims. Returns false,
+            // writing nothing, if a victim left the directory meanwhile.
+            bool ApplyMerge(uint32_t term_id, segment_merge& merge, hcat_transaction* tx);
+            void Run();
+            void Throttle(uint64_t bytes, std::chrono::steady_clock::duration elapsed);
+        };
+    }
+}
@@ -0,0 +1,498 @@
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "segment_store.h"
+#include "../simd_compression/codecfactory.h"
+#include "../simd_compression/fusedintersection.h"
+#include "../simd_compression/intersection.h"
+#include "../simd_compression/union.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static std::string postings_key(const char* prefix, uint32_t term_id)
+        {
+            return prefix + std::to_string(term_id);
+        }
+
+        // Points past the header of a stored segment. Segments written
+        // before schemes existed have a two word header and are scheme 0,
+        // they are too short to hold a third header word.
+        static const uint32_t* read_header(const void* value, uint32_t length, uint32_t& count, uint32_t& words, uint32_t& scheme)
+        {
+            uint32_t header[3] = { 0, 0, 0 };
+            memcpy(header, value, 2 * sizeof(uint32_t));
+            count = header[0];
+            words = header[1];
+            size_t header_words = 2;
+            if (length >= (static_cast<size_t>(words) + 3) * sizeof(uint32_t))
+            {
+                memcpy(&header[2], reinterpret_cast<const uint32_t*>(value) + 2, sizeof(uint32_t));
+                header_words = 3;
+            }
+            scheme = header[2];
+            return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(value) + header_words * sizeof(uint32_t));
+        }
+
+        static std::string segment_key(uint32_t term_id, uint32_t segment_id)
+        {
+            return "$segment:" + std::to_string(term_id) + ":" + std::to_string(segment_id);
+        }
+
+        SegmentStore::SegmentStore(std::string_ref keyspace, const char* codec)
+        {
+            this->keyspace = keyspace;
+            this->adaptive = strcmp(codec, "adaptive") == 0;
+            this->codec = CODECFactory::getId(adaptive ? "s4-bp128-1" : codec);
+            this->fused = adaptive || strcmp(codec, "s4-bp128-1") == 0;
+        }
+
+        static AdaptiveCODEC& adaptive_codec()
+        {
+            static const size_t id = CODECFactory::getId("adaptive");
+            return static_cast<AdaptiveCODEC&>(CODECFactory::getThreadLocal(id));
+        }
+
+        IntegerCODEC& SegmentStore::GetCodec(uint32_t scheme)
+        {
+            if (scheme == 0)
+            {
+                return CODECFactory::getThreadLocal(codec);
+            }
+            return adaptive_codec().scheme(scheme - 1);
+        }
+
+        bool SegmentStore::IsFused(uint32_t scheme)
+        {
+            return scheme == 0 ? fused : scheme - 1 == AdaptiveCODEC::BP128;
+        }
+
+        SegmentStore::~SegmentStore()
+        {
+        }
+
+        posting_list SegmentStore::GetTail(uint32_t term_id, hcat_transaction* tx)
+        {
+            std::string key = postings_key("$postings:", term_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+
+            posting_list tail = { NULL, 0 };
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                const uint32_t* stored = reinterpret_cast<const uint32_t*>(pair.value);
+                tail.count = stored[0];
+                tail.record_ids = stored + 1;
+            }
+            return tail;
+        }
+
+        void SegmentStore::SetTail(uint32_t term_id, const uint32_t* record_ids, size_t count, hcat_transaction* tx)
+        {
+            std::string key = postings_key("$postings:", term_id);
+            std::vector<uint32_t> value;
+            value.reserve(count + 1);
+            value.push_back(static_cast<uint32_t>(count));
+            value.insert(value.end(), record_ids, record_ids + count);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size() * sizeof(uint32_t));
+            tx->set(&pair);
+        }
+
+        void SegmentStore::GetSegments(uint32_t term_id, hcat_transaction* tx, std::vector<segment_info>& segments)
+        {
+            std::string key = postings_key("$segments:", term_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+
+            segments.clear();
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                const uint8_t* stored = reinterpret_cast<const uint8_t*>(pair.value);
+                uint32_t count;
+                memcpy(&count, stored, sizeof(uint32_t));
+                segments.resize(count);
+                memcpy(segments.data(), stored + sizeof(uint32_t), count * sizeof(segment_info));
+            }
+        }
+
+        void SegmentStore::SetSegments(uint32_t term_id, const std::vector<segment_info>& segments, hcat_transaction* tx)
+        {
+            std::string key = postings_key("$segments:", term_id);
+            std::vector<uint8_t> value(sizeof(uint32_t) + segments.size() * sizeof(segment_info));
+            uint32_t count = static_cast<uint32_t>(segments.size());
+            memcpy(value.data(), &count, sizeof(uint32_t));
+            memcpy(value.data() + sizeof(uint32_t), segments.data(), segments.size() * sizeof(segment_info));
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size());
+            tx->set(&pair);
+            BumpVersion(term_id, tx);
+        }
+
+        segment_info SegmentStore::WriteSegment(uint32_t term_id, const uint32_t* record_ids, size_t count, hcat_transaction* tx)
+        {
+            std::vector<uint32_t> value;
+            segment_info segment = EncodeSegment(record_ids, count, value);
+            PutSegment(term_id, segment, value, tx);
+            return segment;
+        }
+
+        segment_info SegmentStore::EncodeSegment(const uint32_t* record_ids, size_t count, std::vector<uint32_t>& value)
+        {
+            segment_info segment = { 0, static_cast<uint32_t>(count), 0, 0, 0 };
+            if (count > 0)
+            {
+                segment.first = record_ids[0];
+                segment.last = record_ids[count - 1];
+            }
+
+            // The SIMD codecs want 16 byte aligned input and output, the
+            // vectors give us that where the store doesn't.
+            std::vector<uint32_t> input(record_ids, record_ids + count);
+            std::vector<uint32_t> compressed(2 * count + 1024);
+            size_t words = compressed.size();
+            uint32_t scheme = 0;
+            if (adaptive)
+            {
+                scheme = adaptive_codec().choose(input.data(), count) + 1;
+            }
+            GetCodec(scheme).encodeArray(input.data(), count, compressed.data(), words);
+            segment.words = static_cast<uint32_t>(words);
+
+            value.clear();
+            value.reserve(words + 3);
+            value.push_back(segment.count);
+            value.push_back(segment.words);
+            value.push_back(scheme);
+            value.insert(value.end(), compressed.begin(), compressed.begin() + words);
+            return segment;
+        }
+
+        void SegmentStore::PutSegment(uint32_t term_id, segment_info& segment, const std::vector<uint32_t>& value, hcat_transaction* tx)
+        {
+            // Ids are never reused, not even those of segments that left the
+            // directory, so a segment id names the same postings forever.
+            // Terms from before $last_segment start after their highest id.
+            std::string last_key = postings_key("$last_segment:", term_id);
+            hcat_keypair last;
+            last.keyspace = this->keyspace;
+            last.key = last_key;
+            uint32_t last_id = 0;
+            if (tx->get(&last) == HCAT_SUCCESS)
+            {
+                memcpy(&last_id, last.value, sizeof(uint32_t));
+            }
+            std::vector<segment_info> segments;
+            GetSegments(term_id, tx, segments);
+            for (auto& existing : segments)
+            {
+                last_id = std::max(last_id, existing.id);
+            }
+            segment.id = last_id + 1;
+            last.value = &segment.id;
+            last.value_length = sizeof(uint32_t);
+            tx->set(&last);
+
+            std::string key = segment_key(term_id, segment.id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = const_cast<uint32_t*>(value.data());
+            pair.value_length = static_cast<uint32_t>(value.size() * sizeof(uint32_t));
+            tx->set(&pair);
+        }
+
+        void SegmentStore::ReadSegment(uint32_t term_id, const segment_info& segment, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            std::string key = segment_key(term_id, segment.id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+
+            record_ids.clear();
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return;
+            }
+
+            uint32_t count;
+            uint32_t words;
+            uint32_t scheme;
+            const uint32_t* compressed = read_header(pair.value, pair.value_length, count, words, scheme);
+            Decode(compressed, words, scheme, count, record_ids);
+        }
+
+        void SegmentStore::Decode(const uint32_t* compressed, uint32_t words, uint32_t scheme, uint32_t count, std::vector<uint32_t>& record_ids)
+        {
+            // A dropped segment has no words.
+            if (words == 0)
+            {
+                record_ids.clear();
+                return;
+            }
+
+            // Copied out for alignment, see EncodeSegment.
+            std::vector<uint32_t> aligned(words);
+            memcpy(aligned.data(), compressed, words * sizeof(uint32_t));
+            record_ids.resize(count + 1024);
+            size_t decoded = record_ids.size();
+            GetCodec(scheme).decodeArray(aligned.data(), aligned.size(), record_ids.data(), decoded);
+            record_ids.resize(decoded);
+        }
+
+        void SegmentStore::DropSegment(uint32_t term_id, const segment_info& segment, hcat_transaction* tx)
+        {
+            // The store has no delete, shrink the segment to nothing instead.
+            std::string key = segment_key(term_id, segment.id);
+            uint32_t header[2] = { 0, 0 };
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = header;
+            pair.value_length = sizeof(header);
+            tx->set(&pair);
+        }
+
+        posting_list SegmentStore::GetPostings(uint32_t term_id, hcat_transaction* tx, std::vector<uint32_t>& buffer)
+        {
+            std::vector<segment_info> segments;
+            GetSegments(term_id, tx, segments);
+            posting_list tail = GetTail(term_id, tx);
+            if (segments.empty())
+            {
+                return tail;
+            }
+
+            std::vector<std::vector<uint32_t>> decoded(segments.size());
+            std::vector<const uint32_t*> sets;
+            std::vector<size_t> lengths;
+            size_t total = tail.count;
+            for (size_t i = 0; i < segments.size(); i++)
+            {
+                ReadSegment(term_id, segments[i], tx, decoded[i]);
+                sets.push_back(decoded[i].data());
+                lengths.push_back(decoded[i].size());
+                total += decoded[i].size();
+            }
+            sets.push_back(tail.record_ids);
+            lengths.push_back(tail.count);
+
+            buffer.resize(total);
+            buffer.resize(SIMDmultiunion(sets.data(), lengths.data(), sets.size(), buffer.data()));
+            posting_list postings = { buffer.data(), buffer.size() };
+            return postings;
+        }
+
+        size_t SegmentStore::CountPostings(uint32_t term_id, hcat_transaction* tx)
+        {
+            std::vector<segment_info> segments;
+            GetSegments(term_id, tx, segments);
+            size_t count = GetTail(term_id, tx).count;
+            for (auto& segment : segments)
+            {
+                count += segment.count;
+            }
+            return count;
+        }
+
+        uint32_t SegmentStore::GetVersion(uint32_t term_id, hcat_transaction* tx)
+        {
+            std::string key = postings_key("$version:", term_id);
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            uint32_t version = 0;
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                memcpy(&version, pair.value, sizeof(uint32_t));
+            }
+            return version;
+        }
+
+        void SegmentStore::BumpVersion(uint32_t term_id, hcat_transaction* tx)
+        {
+            std::string key = postings_key("$version:", term_id);
+            uint32_t version = GetVersion(term_id, tx) + 1;
+
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = &version;
+            pair.value_length = sizeof(uint32_t);
+            tx->set(&pair);
+        }
+
+        uint64_t SegmentStore::GetGeneration(uint32_t term_id, hcat_transaction* tx)
+        {
+            return static_cast<uint64_t>(GetVersion(term_id, tx)) << 32 | GetTail(term_id, tx).count;
+        }
+
+        void SegmentStore::IntersectPostings(uint32_t term_id, hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            if (record_ids.empty())
+            {
+                return;
+            }
+            std::vector<segment_info> segments;
+            GetSegments(term_id, tx, segments);
+            posting_list tail = GetTail(term_id, tx);
+
+            // Every segment and the tail yield their own matches, segments
+            // can overlap so the matches are unioned afterwards.
+            std::vector<std::vector<uint32_t>> matches(1);
+            matches[0].resize(record_ids.size());
+            matches[0].resize(SIMDintersection(record_ids.data(), record_ids.size(), tail.record_ids, tail.count, matches[0].data()));
+
+            std::vector<uint32_t> decoded;
+            for (auto& segment : segments)
+            {
+                if (segment.count == 0 || segment.last < record_ids.front() || segment.first > record_ids.back())
+                {
+                    continue;
+                }
+                const uint32_t* begin = record_ids.data();
+                const uint32_t* end = begin + record_ids.size();
+                const uint32_t* first = std::lower_bound(begin, end, segment.first);
+                const uint32_t* last = std::upper_bound(first, end, segment.last);
+                if (first == last)
+                {
+                    continue;
+                }
+
+                matches.emplace_back(last - first);
+                std::vector<uint32_t>& output = matches.back();
+                const uint32_t* compressed;
+                uint32_t words;
+                uint32_t scheme;
+                if (!GetCompressed(term_id, segment, tx, compressed, words, scheme))
+                {
+                    output.clear();
+                    continue;
+                }
+                if (!IsFused(scheme))
+                {
+                    Decode(compressed, words, scheme, segment.count, decoded);
+                    output.resize(SIMDintersection(first, last - first, decoded.data(), decoded.size(), output.data()));
+                    continue;
+                }
+                output.resize(fusedintersection(compressed, words, first, last - first, output.data()));
+            }
+
+            if (matches.size() == 1)
+            {
+                record_ids.swap(matches[0]);
+                return;
+            }
+            std::vector<const uint32_t*> sets;
+            std::vector<size_t> lengths;
+            size_t total = 0;
+            for (auto& match : matches)
+            {
+                sets.push_back(match.data());
+                lengths.push_back(match.size());
+                total += match.size();
+            }
+            record_ids.resize(total);
+            record_ids.resize(SIMDmultiunion(sets.data(), lengths.data(), sets.size(), record_ids.data()));
+        }
+
+        bool SegmentStore::GetCompressed(uint32_t term_id, const segment_info& segment, hcat_transaction* tx, const uint32_t*& compressed,
+                                         uint32_t& words, uint32_t& scheme)
+        {
+            std::string key = segment_key(term_id, segment.id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return false;
+            }
+            uint32_t count;
+            compressed = read_header(pair.value, pair.value_length, count, words, scheme);
+            return true;
+        }
+
+        size_t SegmentStore::CountIntersection(uint32_t term_id, hcat_transaction* tx, const std::vector<uint32_t>& record_ids)
+        {
+            if (record_ids.empty())
+            {
+                return 0;
+            }
+            std::vector<segment_info> segments;
+            GetSegments(term_id, tx, segments);
+            posting_list tail = GetTail(term_id, tx);
+
+            // Counts of disjoint segments add up. Overlapping ones, from
+            // record ids that arrived out of order, could count a record
+            // twice and go through IntersectPostings instead.
+            std::vector<std::pair<uint32_t, uint32_t>> ranges;
+            for (auto& segment : segments)
+            {
+                if (segment.count > 0)
+                {
+                    ranges.push_back(std::make_pair(segment.first, segment.last));
+                }
+            }
+            if (tail.count > 0)
+            {
+                ranges.push_back(std::make_pair(tail.record_ids[0], tail.record_ids[tail.count - 1]));
+            }
+            std::sort(ranges.begin(), ranges.end());
+            for (size_t i = 1; i < ranges.size(); i++)
+            {
+                if (ranges[i].first <= ranges[i - 1].second)
+                {
+                    std::vector<uint32_t> matches(record_ids);
+                    IntersectPostings(term_id, tx, matches);
+                    return matches.size();
+                }
+            }
+
+            size_t count = SIMDintersectionCardinality(record_ids.data(), record_ids.size(), tail.record_ids, tail.count);
+            std::vector<uint32_t> decoded;
+            for (auto& segment : segments)
+            {
+                const uint32_t* begin = record_ids.data();
+                const uint32_t* end = begin + record_ids.size();
+                const uint32_t* first = std::lower_bound(begin, end, segment.first);
+                const uint32_t* last = std::upper_bound(first, end, segment.last);
+                if (segment.count == 0 || first == last)
+                {
+                    continue;
+                }
+                const uint32_t* compressed;
+                uint32_t words;
+                uint32_t scheme;
+                if (!GetCompressed(term_id, segment, tx, compressed, words, scheme))
+                {
+                    continue;
+                }
+                if (!IsFused(scheme))
+                {
+                    Decode(compressed, words, scheme, segment.count, decoded);
+                    count += SIMDintersectionCardinality(first, last - first, decoded.data(), decoded.size());
+                }
+                else
+                {
+                    count += fusedintersectioncardinality(compressed, words, first, last - first);
+                }
+            }
+            return count;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+class IntegerCODEC;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Borrowed view of a sorted posting list, either pointing into the
+        // store (valid until the next write in that transaction) or into a
+        // buffer owned by the caller.
+        typedef struct
+        {
+            const uint32_t* record_ids;
+            size_t count;
+        } posting_list;
+
+        typedef struct
+        {
+            uint32_t id;
+            uint32_t count;
+            uint32_t first;
+            uint32_t last;
+            uint32_t words;
+        } segment_info;
+
+        // Storage layout of the postings of one term:
+        //
+        //   $postings:<term>      open tail, [count][record ids...] uncompressed
+        //   $segments:<term>      [segment count][segment_info...]
+        //   $segment:<term>:<id>  [count][words][scheme][compressed record ids...]
+        //   $version:<term>       [version], bumped on every directory write and
+        //                         whenever the tail shrinks
+        //   $last_segment:<term>  [id], the last segment id handed out
+        //
+        // Record ids are appended to the tail, a full tail is sealed into an
+        // immutable compressed segment. Segments can overlap when record ids
+        // arrive out of order so readers union them.
+        //
+        // With the "adaptive" codec every segment is compressed with the
+        // codec AdaptiveCODEC picks for it and scheme is its number plus
+        // one. Scheme 0 is the codec the store was created with, which is
+        // s4-bp128-1 for "adaptive", so segments written before schemes
+        // existed, with a [count][words] header, still read.
+        class SegmentStore
+        {
+        public:
+            SegmentStore(std::string_ref keyspace, const char* codec = "adaptive");
+            ~SegmentStore();
+
+            posting_list GetTail(uint32_t term_id, hcat_transaction* tx);
+            void SetTail(uint32_t term_id, const uint32_t* record_ids, size_t count, hcat_transaction* tx);
+
+            void GetSegments(uint32_t term_id, hcat_transaction* tx, std::vector<segment_info>& segments);
+            void SetSegments(uint32_t term_id, const std::vector<segment_info>& segments, hcat_transaction* tx);
+
+            // Compresses record_ids into a new segment and returns its
+            // directory entry. The caller has to add it to the directory
+            // before writing another segment of the same term.
+            segment_info WriteSegment(uint32_t term_id, const uint32_t* record_ids, size_t count, hcat_transaction* tx);
+
+            // The two halves of WriteSegment. EncodeSegment doesn't touch the
+            // store so it can run on any thread, PutSegment assigns the id.
+            segment_info EncodeSegment(const uint32_t* record_ids, size_t count, std::vector<uint32_t>& value);
+            void PutSegment(uint32_t term_id, segment_info& segment, const std::vector<uint32_t>& value, hcat_transaction* tx);
+            void ReadSegment(uint32_t term_id, const segment_info& segment, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+            void DropSegment(uint32_t term_id, const segment_info& segment, hcat_transaction* tx);
+
+            // The whole posting list of a term. Points straight at the tail
+            // when the term has no segments, otherwise decodes into buffer.
+            posting_list GetPostings(uint32_t term_id, hcat_transaction* tx, std::vector<uint32_t>& buffer);
+
+            // Upper bound of the posting count of a term without reading any
+            // segment, overlapping segments count twice.
+            size_t CountPostings(uint32_t term_id, hcat_transaction* tx);
+
+            // Changes whenever the postings of the term change. Between two
+            // bumps of the version only appends to the tail happen, so the
+            // version and the tail count together never repeat.
+            uint64_t GetGeneration(uint32_t term_id, hcat_transaction* tx);
+
+            // For changes the directory doesn't see, a record taken out of
+            // the tail. SetSegments bumps it itself.
+            void BumpVersion(uint32_t term_id, hcat_transaction* tx);
+
+            // Keeps only the record ids that are in the postings of the term.
+            // Segments in s4-bp128-1 are decoded one block at a time while
+            // intersecting instead of being decoded in full first.
+            void IntersectPostings(uint32_t term_id, hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+
+            // How many of the sorted record_ids are in the postings of the
+            // term. Only counts, the matches are never written out.
+            size_t CountIntersection(uint32_t term_id, hcat_transaction* tx, const std::vector<uint32_t>& record_ids);
+        private:
+            std::string_ref keyspace;
+            // Id in CODECFactory, every thread codes with its own instance.
+            size_t codec;
+            bool adaptive;
+            bool fused;
+
+            // Points at the compressed record ids of a stored segment.
+            bool GetCompressed(uint32_t term_id, const segment_info& segment, hcat_transaction* tx, const uint32_t*& compressed,
+                               uint32_t& words, uint32_t& scheme);
+            void Decode(const uint32_t* compressed, uint32_t words, uint32_t scheme, uint32_t count, std::vector<uint32_t>& record_ids);
+            IntegerCODEC& GetCodec(uint32_t scheme);
+            bool IsFused(uint32_t scheme);
+            uint32_t GetVersion(uint32_t term_id, hcat_transaction* tx);
+        };
+    }
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include "term_cache.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        TermCache::TermCache(size_t capacity) : table(NULL), count(0), write_lock(), retired_tables()
+        {
+            // Round up to a power of two so probing can mask instead of mod.
+            size_t size = 16;
+            while (size < capacity * 2)
+            {
+                size <<= 1;
+            }
+            table.store(CreateTable(size), std::memory_order_release);
+        }
+
+        TermCache::~TermCache()
+        {
+            Table* current = table.load(std::memory_order_acquire);
+            for (size_t i = 0; i <= current->mask; i++)
+            {
+                Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+                if (entry != NULL)
+                {
+                    delete[] entry->term;
+                    delete entry;
+                }
+            }
+            delete[] current->slots;
+            delete current;
+
+            // Retired tables only hold pointers to entries that were moved
+            // into the current table.
+            for (auto retired : retired_tables)
+            {
+                delete[] retired->slots;
+                delete retired;
+            }
+        }
+
+        uint64_t TermCache::Hash(std::string_ref term)
+        {
+            // FNV-1a, good enough for short terms and cheap to compute.
+            uint64_t hash = 14695981039346656037ULL;
+            for (size_t i = 0; i < term.length(); i++)
+            {
+                hash ^= static_cast<uint8_t>(term[i]);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        TermCache::Table* TermCache::CreateTable(size_t capacity)
+        {
+            Table* created = new Table();
+            created->mask = capacity - 1;
+            created->slots = new std::atomic<Entry*>[capacity];
+            for (size_t i = 0; i < capacity; i++)
+            {
+                created->slots[i].store(NULL, std::memory_order_relaxed);
+            }
+            return created;
+        }
+
+        uint32_t TermCache::Get(std::string_ref term) const
+        {
+            Entry* entry = Find(table.load(std::memory_order_acquire), Hash(term), term);
+            return entry != NULL ? entry->id.load(std::memory_order_acquire) : 0;
+        }
+
+        TermCache::Entry* TermCache::Find(Table* current, uint64_t hash, std::string_ref term)
+        {
+            size_t slot = hash & current->mask;
+            while (true)
+            {
+                Entry* entry = current->slots[slot].load(std::memory_order_acquire);
+                if (entry == NULL)
+                {
+                    return NULL;
+                }
+                if (entry->hash == hash && entry->length == term.length() &&
+                    memcmp(entry->term, term.data(), term.length()) == 0)
+                {
+                    return entry;
+                }
+                slot = (slot + 1) & current->mask;
+            }
+        }
+
+        void TermCache::Insert(Table* table, Entry* entry)
+        {
+            size_t slot = entry->hash & table->mask;
+            while (table->slots[slot].load(std::memory_order_relaxed) != NULL)
+            {
+                slot = (slot + 1) & table->mask;
+            }
+            table->slots[slot].store(entry, std::memory_order_release);
+        }
+
+        void TermCache::Grow()
+        {
+            Table* current = table.load(std::memory_order_relaxed);
+            Table* grown = CreateTable((current->mask + 1) * 2);
+            for (size_t i = 0; i <= current->mask; i++)
+            {
+                Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+                if (entry != NULL)
+                {
+                    Insert(grown, entry);
+                }
+            }
+            table.store(grown, std::memory_order_release);
+
+            // Readers may still be probing the old table so it stays alive
+            // until the cache is destroyed.
+            retired_tables.push_back(current);
+        }
+
+        uint32_t TermCache::Put(std::string_ref term, uint32_t id)
+        {
+            std::lock_guard<std::mutex> lock(write_lock);
+
+            const uint64_t hash = Hash(term);
+            Entry* existing = Find(table.load(std::memory_order_relaxed), hash, term);
+            if (existing != NULL)
+            {
+                // A removed term gets its entry back.
+                uint32_t existing_id = existing->id.load(std::memory_order_relaxed);
+                if (existing_id == 0)
+                {
+                    existing->id.store(id, std::memory_order_release);
+                    return id;
+                }
+                return existing_id;
+            }
+
+            // Keep the load factor under 1/2 so misses stay short.
+            Table* current = table.load(std::memory_order_relaxed);
+            if ((count.load(std::memory_order_relaxed) + 1) * 2 > current->mask + 1)
+            {
+                Grow();
+            }
+
+            Entry* entry = new Entry();
+            entry->hash = hash;
+            entry->id.store(id, std::memory_order_relaxed);
+            entry->length = static_cast<uint32_t>(term.length());
+            entry->term = new char[term.length() + 1];
+            memcpy(entry->term, term.data(), term.length());
+            entry->term[term.length()] = '\0';
+
+            Insert(table.load(std::memory_order_relaxed), entry);
+            count.fetch_add(1, std::memory_order_release);
+            return id;
+        }
+
+        void TermCache::Remove(std::string_ref term)
+        {
+            std::lock_guard<std::mutex> lock(write_lock);
+            Entry* entry = Find(table.load(std::memory_order_relaxed), Hash(term), term);
+            if (entry != NULL)
+            {
+                entry->id.store(0, std::memory_order_release);
+            }
+        }
+
+        size_t TermCache::Size() const
+        {
+            return count.load(std::memory_order_acquire);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "../string_ref.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        // Concurrent term -> term id hash map that sits in front of the
+        // persisted IndexDictionary. Lookups are lock-free open addressing
+        // probes. Inserts are rare (new terms only) and serialize on a mutex.
+        // Entries are never removed, Remove only clears their id, so a reader
+        // probing a table that is being replaced by a resize still sees
+        // valid entries. Replaced tables are kept until the cache is
+        // destroyed, every resize doubles so together they are never bigger
+        // than the current one.
+        class TermCache
+        {
+        public:
+            TermCache(size_t capacity = 65536);
+            ~TermCache();
+
+            // Returns the cached id of the term or 0 if the term isn't cached.
+            uint32_t Get(std::string_ref term) const;
+
+            // Caches the term if it isn't already. Returns the id that ended
+            // up in the cache, which is the existing id if another thread won.
+            uint32_t Put(std::string_ref term, uint32_t id);
+
+            // Forgets the id of the term, Get returns 0 until it is put again.
+            void Remove(std::string_ref term);
+
+            size_t Size() const;
+        private:
+            struct Entry
+            {
+                uint64_t hash;
+                std::atomic<uint32_t> id;
+                uint32_t length;
+                char* term;
+            };
+
+            struct Table
+            {
+                size_t mask;
+                std::atomic<Entry*>* slots;
+            };
+
+            std::atomic<Table*> table;
+            std::atomic<size_t> count;
+            std::mutex write_lock;
+            std::vector<Table*> retired_tables;
+
+            TermCache(const TermCache&) = delete;
+            TermCache& operator=(const TermCache&) = delete;
+
+            static uint64_t Hash(std::string_ref term);
+            static Table* CreateTable(size_t capacity);
+            static Entry* Find(Table* table, uint64_t hash, std::string_ref term);
+            static void Insert(Table* table, Entry* entry);
+            void Grow();
+        };
+    }
+}
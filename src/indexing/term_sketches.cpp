@@ -0,0 +1,85 @@
+#include <string>
+#include "term_sketches.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static std::string sketch_key(uint32_t term_id)
+        {
+            return "$hll:" + std::to_string(term_id);
+        }
+
+        TermSketches::TermSketches(std::string_ref keyspace) : keyspace(keyspace)
+        {
+        }
+
+        TermSketches::~TermSketches()
+        {
+        }
+
+        uint64_t TermSketches::Hash(uint32_t record_id)
+        {
+            return HyperLogLog::hash(&record_id, sizeof(record_id));
+        }
+
+        bool TermSketches::Get(uint32_t term_id, hcat_transaction* tx, HyperLogLog& sketch)
+        {
+            std::string key = sketch_key(term_id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            sketch = HyperLogLog(Precision);
+            return tx->get(&pair) == HCAT_SUCCESS && sketch.read(pair.value, pair.value_length);
+        }
+
+        void TermSketches::Put(uint32_t term_id, const HyperLogLog& sketch, hcat_transaction* tx)
+        {
+            std::vector<uint8_t> value(sketch.serialized_size());
+            sketch.write(value.data());
+
+            std::string key = sketch_key(term_id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size());
+            tx->set(&pair);
+        }
+
+        void TermSketches::Add(uint32_t term_id, uint32_t record_id, hcat_transaction* tx)
+        {
+            // Only written back when a register grows, which gets rare as
+            // the term gets common.
+            uint64_t hash = Hash(record_id);
+            std::string key = sketch_key(term_id);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            HyperLogLog sketch(Precision);
+            if (tx->get(&pair) == HCAT_SUCCESS)
+            {
+                if (HyperLogLog::covers(pair.value, pair.value_length, hash))
+                {
+                    return;
+                }
+                sketch.read(pair.value, pair.value_length);
+            }
+            sketch.add(hash);
+            Put(term_id, sketch, tx);
+        }
+
+        void TermSketches::Merge(uint32_t term_id, const HyperLogLog& sketch, hcat_transaction* tx)
+        {
+            HyperLogLog merged(Precision);
+            Get(term_id, tx, merged);
+            merged.merge(sketch);
+            Put(term_id, merged, tx);
+        }
+
+        uint64_t TermSketches::Estimate(uint32_t term_id, hcat_transaction* tx)
+        {
+            HyperLogLog sketch(Precision);
+            return Get(term_id, tx, sketch) ? sketch.estimate() : 0;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/hyperloglog.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+namespace hellcat {
+    namespace indexing {
+
+        // A HyperLogLog of the record ids of every term, under $hll:<term>
+        // next to its postings, so "about how many records match" never
+        // reads a posting list. Rare terms stay in the small sparse form.
+        // Removed and deleted records are still counted.
+        class TermSketches
+        {
+        public:
+            static const uint8_t Precision = 12;
+
+            TermSketches(std::string_ref keyspace);
+            ~TermSketches();
+
+            void Add(uint32_t term_id, uint32_t record_id, hcat_transaction* tx);
+            void Merge(uint32_t term_id, const HyperLogLog& sketch, hcat_transaction* tx);
+
+            // False and an empty sketch if the term has none.
+            bool Get(uint32_t term_id, hcat_transaction* tx, HyperLogLog& sketch);
+            uint64_t Estimate(uint32_t term_id, hcat_transaction* tx);
+
+            static uint64_t Hash(uint32_t record_id);
+        private:
+            std::string_ref keyspace;
+
+            void Put(uint32_t term_id, const HyperLogLog& sketch, hcat_transaction* tx);
+        };
+    }
+}
@@ -0,0 +1,83 @@
+#include "thread_pool.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        ThreadPool::ThreadPool(size_t thread_count) :
+            workers(), tasks(), lock(), task_added(), task_done(), running(0), stopping(false)
+        {
+            if (thread_count == 0)
+            {
+                thread_count = std::thread::hardware_concurrency();
+            }
+            if (thread_count == 0)
+            {
+                thread_count = 1;
+            }
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                workers.emplace_back(&ThreadPool::Run, this);
+            }
+        }
+
+        ThreadPool::~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            task_added.notify_all();
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        void ThreadPool::Submit(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                tasks.push_back(std::move(task));
+            }
+            task_added.notify_one();
+        }
+
+        void ThreadPool::Wait()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            task_done.wait(guard, [this] { return tasks.empty() && running == 0; });
+        }
+
+        size_t ThreadPool::Size() const
+        {
+            return workers.size();
+        }
+
+        void ThreadPool::Run()
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    task_added.wait(guard, [this] { return stopping || !tasks.empty(); });
+                    if (tasks.empty())
+                    {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                    running++;
+                }
+
+                task();
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    running--;
+                }
+                task_done.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hellcat {
+    namespace indexing {
+
+        // Fixed set of worker threads draining a FIFO of tasks.
+        class ThreadPool
+        {
+        public:
+            // 0 threads means one per hardware thread.
+            ThreadPool(size_t thread_count = 0);
+            ~ThreadPool();
+
+            void Submit(std::function<void()> task);
+
+            // Blocks until every submitted task has finished.
+            void Wait();
+
+            size_t Size() const;
+        private:
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> tasks;
+            std::mutex lock;
+            std::condition_variable task_added;
+            std::condition_variable task_done;
+            size_t running;
+            bool stopping;
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            void Run();
+        };
+    }
+}
@@ -0,0 +1,31 @@
+#include "tokenizer.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        void Tokenize(std::string_ref text, std::vector<std::string>& terms)
+        {
+            std::string term;
+            for (char c : text)
+            {
+                if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+                {
+                    term.push_back(c);
+                }
+                else if (c >= 'A' && c <= 'Z')
+                {
+                    term.push_back(c - 'A' + 'a');
+                }
+                else if (!term.empty())
+                {
+                    terms.push_back(term);
+                    term.clear();
+                }
+            }
+            if (!term.empty())
+            {
+                terms.push_back(term);
+            }
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../string_ref.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        // Splits text into lower cased runs of ASCII letters and digits.
+        // Every other byte separates terms.
+        void Tokenize(std::string_ref text, std::vector<std::string>& terms);
+    }
+}
@@ -0,0 +1,129 @@
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "tombstones.h"
+#include "../simd_compression/roaringbitmap.h"
+
+namespace hellcat {
+    namespace indexing {
+
+        static std::string chunk_key(uint32_t chunk)
+        {
+            return "$deleted:" + std::to_string(chunk);
+        }
+
+        TombstoneStore::TombstoneStore(std::string_ref keyspace) : keyspace(keyspace)
+        {
+        }
+
+        TombstoneStore::~TombstoneStore()
+        {
+        }
+
+        void TombstoneStore::GetChunks(hcat_transaction* tx, std::vector<uint32_t>& chunks)
+        {
+            chunks.clear();
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = string_ref("$deleted");
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return;
+            }
+            uint32_t count;
+            memcpy(&count, pair.value, sizeof(count));
+            chunks.resize(count);
+            memcpy(chunks.data(), reinterpret_cast<const uint8_t*>(pair.value) + sizeof(count), count * sizeof(uint32_t));
+        }
+
+        bool TombstoneStore::GetChunk(uint32_t chunk, hcat_transaction* tx, RoaringBitmap& deleted)
+        {
+            std::string key = chunk_key(chunk);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            if (tx->get(&pair) != HCAT_SUCCESS)
+            {
+                return false;
+            }
+            // The store doesn't align values, read copies the containers out.
+            deleted = RoaringBitmap::read(reinterpret_cast<const char*>(pair.value));
+            return true;
+        }
+
+        void TombstoneStore::Delete(uint32_t record_id, hcat_transaction* tx)
+        {
+            uint32_t chunk = record_id >> 16;
+            RoaringBitmap deleted;
+            bool existing = GetChunk(chunk, tx, deleted);
+            if (deleted.contains(record_id))
+            {
+                return;
+            }
+            deleted.add(record_id);
+            deleted.runOptimize();
+
+            std::vector<char> value(deleted.serializedSizeInBytes());
+            deleted.write(value.data());
+            std::string key = chunk_key(chunk);
+            hcat_keypair pair;
+            pair.keyspace = this->keyspace;
+            pair.key = key;
+            pair.value = value.data();
+            pair.value_length = static_cast<uint32_t>(value.size());
+            tx->set(&pair);
+            if (existing)
+            {
+                return;
+            }
+
+            std::vector<uint32_t> chunks;
+            GetChunks(tx, chunks);
+            chunks.insert(std::lower_bound(chunks.begin(), chunks.end(), chunk), chunk);
+            std::vector<uint32_t> directory;
+            directory.push_back(static_cast<uint32_t>(chunks.size()));
+            directory.insert(directory.end(), chunks.begin(), chunks.end());
+            pair.key = string_ref("$deleted");
+            pair.value = directory.data();
+            pair.value_length = static_cast<uint32_t>(directory.size() * sizeof(uint32_t));
+            tx->set(&pair);
+        }
+
+        bool TombstoneStore::IsDeleted(uint32_t record_id, hcat_transaction* tx)
+        {
+            RoaringBitmap deleted;
+            return GetChunk(record_id >> 16, tx, deleted) && deleted.contains(record_id);
+        }
+
+        bool TombstoneStore::GetDeleted(uint32_t first, uint32_t last, hcat_transaction* tx, RoaringBitmap& deleted)
+        {
+            std::vector<uint32_t> chunks;
+            GetChunks(tx, chunks);
+            RoaringBitmap chunk;
+            RoaringBitmap().swap(deleted);
+            for (auto i = std::lower_bound(chunks.begin(), chunks.end(), first >> 16); i != chunks.end() && *i <= last >> 16; ++i)
+            {
+                if (GetChunk(*i, tx, chunk))
+                {
+                    deleted.inplaceUnion(chunk);
+                }
+            }
+            return deleted.cardinality() > 0;
+        }
+
+        void TombstoneStore::RemoveDeleted(hcat_transaction* tx, std::vector<uint32_t>& record_ids)
+        {
+            RoaringBitmap deleted;
+            if (record_ids.empty() || !GetDeleted(record_ids.front(), record_ids.back(), tx, deleted))
+            {
+                return;
+            }
+
+            // One pass of container ANDNOTs instead of a probe per record.
+            RoaringBitmap records = RoaringBitmap::fromSorted(record_ids.data(), record_ids.size());
+            RoaringBitmap live;
+            records.andNot(deleted, live);
+            record_ids.resize(live.toInts(record_ids.data()));
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include "../hellcat.h"
+#include "../string_ref.h"
+#include "../storage/store.h"
+
+using namespace hellcat::storage;
+
+class RoaringBitmap;
+
+namespace hellcat {
+    namespace indexing {
+
+        // Deleted record ids of an index. Deleting leaves the postings in
+        // place, readers subtract the deleted records from their results and
+        // the segment merger drops them from the segments it rewrites.
+        //
+        //   $deleted          [chunk count][chunk...]
+        //   $deleted:<chunk>  serialized RoaringBitmap
+        //
+        // A chunk covers 65536 record ids, the same as a RoaringBitmap
+        // container, so a delete rewrites at most one container. Record ids
+        // aren't reused, an updated document is deleted and indexed again
+        // under a new id.
+        class TombstoneStore
+        {
+        public:
+            TombstoneStore(std::string_ref keyspace);
+            ~TombstoneStore();
+
+            void Delete(uint32_t record_id, hcat_transaction* tx);
+            bool IsDeleted(uint32_t record_id, hcat_transaction* tx);
+
+            // Deleted records between first and last, false if there are
+            // none.
+            bool GetDeleted(uint32_t first, uint32_t last, hcat_transaction* tx, RoaringBitmap& deleted);
+
+            // Removes the deleted records from sorted record_ids.
+            void RemoveDeleted(hcat_transaction* tx, std::vector<uint32_t>& record_ids);
+        private:
+            std::string_ref keyspace;
+
+            void GetChunks(hcat_transaction* tx, std::vector<uint32_t>& chunks);
+            bool GetChunk(uint32_t chunk, hcat_transaction* tx, RoaringBitmap& deleted);
+        };
+    }
+}
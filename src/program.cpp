@@ -1,6 +1,10 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <mutex>
 //#include <chrono>
 //#include <thread>
 #include <haywire.h>
@@ -9,21 +13,65 @@
 #include "storage/store.h"
 #include "storage/lmdb_store.h"
 #include "indexing/index_dictionary.h"
+#include "indexing/index_reader.h"
 #include "indexing/index_writer.h"
+#include "simd_compression/cpuinfo.h"
+#include "simd_compression/intersection.h"
 #include "haywire.h"
 #include "hellcat.h"
 
 using namespace std;
 //using namespace chrono;
 using namespace hellcat::storage;
+using namespace hellcat::indexing;
 
 void create_http_endpoint();
 void get_root(http_request* request, hw_http_response* response, void* user_data);
+void get_cardinality(http_request* request, hw_http_response* response, void* user_data);
 void response_complete(void* user_data);
 
 static unique_ptr<Store> store;
 
+// The dictionary and reader of a keyspace live as long as the process, so
+// its term cache stays warm across requests.
+struct keyspace_index
+{
+    keyspace_index(const string& name) : name(name), dictionary(this->name), reader(this->name, &dictionary) {}
+    const string name;
+    IndexDictionary dictionary;
+    IndexReader reader;
+};
+static mutex indexes_lock;
+static map<string, unique_ptr<keyspace_index>> indexes;
+
+// NULL for a keyspace that isn't in the store, clients can't make the map
+// grow with names of their own.
+static IndexReader* get_reader(string_ref keyspace)
+{
+    lock_guard<mutex> lock(indexes_lock);
+    auto found = indexes.find(keyspace.str());
+    if (found != indexes.end())
+    {
+        return &found->second->reader;
+    }
+    uint64_t estimate;
+    if (store->cardinality(keyspace, &estimate) == HCAT_KEYSPACENOTFOUND)
+    {
+        return NULL;
+    }
+    keyspace_index* index = new keyspace_index(keyspace.str());
+    indexes[index->name] = unique_ptr<keyspace_index>(index);
+    return &index->reader;
+}
+
 int main(int argc, char* argv[]) {
+    if (!cpusupportsbaseline())
+    {
+        cerr << "hellcat needs SSE4.2 and POPCNT, " << describecpu() << endl;
+        return 1;
+    }
+    cout << describecpu() << ", intersection: " << IntersectionFactory::selected() << endl;
+    
     store = unique_ptr<Store>(new LMDBStore());
     int rc = store->open("/tmp/hellcat_data", true);
     
@@ -35,12 +83,14 @@ int main(int argc, char* argv[]) {
 void create_http_endpoint()
 {
     char route[] = "/";
+    char cardinality_route[] = "/cardinality";
     configuration config;
     config.http_listen_address = "0.0.0.0";
     config.http_listen_port = 8000;
     
     hw_init_with_config(&config);
     hw_http_add_route(route, get_root, NULL);
+    hw_http_add_route(cardinality_route, get_cardinality, NULL);
     hw_http_open(16);
 }
 
@@ -149,3 +199,75 @@ void get_root(http_request* request, hw_http_response* response, void* user_data
     
     hw_http_response_send(response, NULL, response_complete);
 }
+
+// Approximate number of distinct keys in a keyspace or, with a term header,
+// of records containing the term. A term ending in * covers every term
+// starting with what comes before it.
+void get_cardinality(http_request* request, hw_http_response* response, void* user_data)
+{
+    // Per thread so it is still around while the response is written.
+    static thread_local char estimate_text[24];
+    hw_string status_code;
+    hw_string body;
+    
+    string_ref keyspace = string_ref(hw_get_header(request, "keyspace"));
+    string_ref term = string_ref(hw_get_header(request, "term"));
+    uint64_t estimate = 0;
+    int rc = HCAT_KEYSPACENOTFOUND;
+    
+    if (keyspace.data() != NULL && term.data() == NULL)
+    {
+        rc = store->cardinality(keyspace, &estimate);
+    }
+    else if (keyspace.data() != NULL)
+    {
+        IndexReader* reader = get_reader(keyspace);
+        hcat_transaction* tx;
+        rc = reader != NULL ? store->begin_transaction(&tx, 1) : HCAT_KEYSPACENOTFOUND;
+        if (rc == HCAT_SUCCESS)
+        {
+            estimate = reader->EstimateCount(term, tx);
+            tx->commit();
+            delete tx;
+        }
+    }
+    
+    if (rc == HCAT_SUCCESS)
+    {
+        SETSTRING(status_code, HTTP_STATUS_200);
+        body.value = estimate_text;
+        body.length = snprintf(estimate_text, sizeof(estimate_text), "%llu", static_cast<unsigned long long>(estimate));
+    }
+    else
+    {
+        SETSTRING(status_code, HTTP_STATUS_404);
+        SETSTRING(body, "FAIL");
+    }
+    
+    hw_string content_type_name;
+    hw_string content_type_value;
+    hw_string keep_alive_name;
+    hw_string keep_alive_value;
+    
+    SETSTRING(content_type_name, "Content-Type");
+    
+    SETSTRING(content_type_value, "text/plain");
+    hw_set_response_header(response, &content_type_name, &content_type_value);
+    
+    hw_set_response_status_code(response, &status_code);
+    hw_set_body(response, &body);
+    
+    if (request->keep_alive)
+    {
+        SETSTRING(keep_alive_name, "Connection");
+        
+        SETSTRING(keep_alive_value, "Keep-Alive");
+        hw_set_response_header(response, &keep_alive_name, &keep_alive_value);
+    }
+    else
+    {
+        hw_set_http_version(response, 1, 0);
+    }
+    
+    hw_http_response_send(response, NULL, response_complete);
+}
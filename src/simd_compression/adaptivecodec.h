@@ -0,0 +1,181 @@
+
+
+#ifndef ADAPTIVECODEC_H_
+#define ADAPTIVECODEC_H_
+
+#include "common.h"
+#include "codecs.h"
+#include "compositecodec.h"
+#include "eliasfano.h"
+#include "simdbinarypacking.h"
+#include "simdfastpfor.h"
+#include "streamvbyte.h"
+#include "variablebyte.h"
+#include "util.h"
+
+/**
+ * Picks one of a shortlist of codecs for sorted integers, list by list.
+ * The shortlist is numbered, the number is what gets stored next to the
+ * compressed list so that it decodes with the codec it was written with:
+ *
+ *   0  s4-bp128-1     fastest to decode, and intersected without decoding
+ *                     by fusedintersection
+ *   1  s4-fastpfor-1  smaller when a few gaps are much larger than the rest
+ *   2  streamvbyte-1  short lists, where s4-bp128-1 is all VariableByte
+ *   3  pef128         clustered lists, and skips without decoding
+ *
+ * Never renumber them, only append. choose encodes the list, or a sample
+ * of it, with every codec and keeps the one with the lowest cost: the bits
+ * per integer plus a penalty, in bits per integer, for how much slower it
+ * decodes than s4-bp128-1. So a slower codec has to save that much space
+ * to be picked.
+ *
+ * As an IntegerCODEC the stream is one word holding the number in its low
+ * byte followed by the stream of the chosen codec. No pointer needs to be
+ * aligned.
+ */
+class AdaptiveCODEC: public IntegerCODEC {
+public:
+    enum {
+        BP128 = 0,
+        FastPFor = 1,
+        StreamVByte1 = 2,
+        PEF128 = 3,
+        SchemeCount = 4
+    };
+
+    /**
+     * Lists up to SampleSize integers are encoded whole, longer ones
+     * through SampleCount evenly spread runs of SampleSize / SampleCount.
+     */
+    static const size_t SampleSize = 4096;
+    static const size_t SampleCount = 4;
+
+    AdaptiveCODEC() : bp128(), fastpfor(), streamvbyte(), pef(), scratch(), trial() {
+    }
+
+    IntegerCODEC &scheme(uint32_t id) {
+        switch (id) {
+        case BP128:
+            return bp128;
+        case FastPFor:
+            return fastpfor;
+        case StreamVByte1:
+            return streamvbyte;
+        case PEF128:
+            return pef;
+        default:
+            throw invalid_argument("unknown adaptive scheme " + to_string(id));
+        }
+    }
+
+    static string schemeName(uint32_t id) {
+        static const char *const names[SchemeCount] = { "s4-bp128-1", "s4-fastpfor-1", "streamvbyte-1", "pef128" };
+        return id < SchemeCount ? names[id] : "UNKNOWN";
+    }
+
+    /**
+     * Number of the codec with the lowest cost for the sorted integers.
+     */
+    uint32_t choose(const uint32_t *in, const size_t length) {
+        if (length == 0)
+            return BP128;
+        const size_t runs = length <= SampleSize ? 1 : SampleCount;
+        const size_t runlength = runs == 1 ? length : SampleSize / SampleCount;
+        uint32_t best = BP128;
+        double bestcost = 0;
+        for (uint32_t id = 0; id < SchemeCount; ++id) {
+            size_t words = 0;
+            for (size_t r = 0; r < runs; ++r) {
+                const size_t start = runs == 1 ? 0 : (length - runlength) / (runs - 1) * r;
+                words += encodedWords(scheme(id), in + start, runlength);
+            }
+            const double cost = 32.0 * words / (runs * runlength) + penalty(id, runlength);
+            if (id == BP128 or cost < bestcost) {
+                best = id;
+                bestcost = cost;
+            }
+        }
+        return best;
+    }
+
+    void encodeArray(uint32_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        const uint32_t id = choose(in, length);
+        if (scratch.size() < nvalue + 4)
+            scratch.resize(nvalue + 4);
+        uint32_t *const start = align(scratch.data());
+        size_t words = scratch.data() + scratch.size() - start;
+        scheme(id).encodeArray(in, length, start, words);
+        if (words + 1 > nvalue)
+            throw NotEnoughStorage(words + 1);
+        memcpy(out, &id, sizeof(id));
+        memcpy(out + 1, start, words * sizeof(uint32_t));
+        nvalue = words + 1;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t length,
+                                uint32_t *out, size_t &nvalue) {
+        if (length == 0) {
+            nvalue = 0;
+            return in;
+        }
+        uint32_t id;
+        memcpy(&id, in, sizeof(id));
+        if (scratch.size() < length + 4)
+            scratch.resize(length + 4);
+        uint32_t *const start = align(scratch.data());
+        memcpy(start, in + 1, (length - 1) * sizeof(uint32_t));
+        const uint32_t *end = scheme(id & 0xFF).decodeArray(start, length - 1, out, nvalue);
+        return in + 1 + (end - start);
+    }
+
+    string name() const {
+        return "Adaptive";
+    }
+
+private:
+    CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true>>, VariableByte<true>> bp128;
+    CompositeCodec<SIMDFastPFor<RegularDeltaSIMD>, VariableByte<true>> fastpfor;
+    StreamVByte<RegularDeltaSIMD> streamvbyte;
+    EliasFano pef;
+    vector<uint32_t> scratch;
+    vector<uint32_t> trial;
+
+    static uint32_t *align(uint32_t *p) {
+        return reinterpret_cast<uint32_t *>((reinterpret_cast<uintptr_t>(p) + 15) & ~static_cast<uintptr_t>(15));
+    }
+
+    /**
+     * Decoding cost over s4-bp128-1, in bits per integer. The integers
+     * past the last full block of 128 go through VariableByte in both
+     * composite codecs.
+     */
+    static double penalty(uint32_t id, size_t length) {
+        const double leftover = static_cast<double>(length % 128) / length;
+        switch (id) {
+        case BP128:
+            return 2.0 * leftover;
+        case FastPFor:
+            return 1.0 + 2.0 * leftover;
+        case StreamVByte1:
+            return 1.0;
+        default:
+            return 1.5;
+        }
+    }
+
+    /**
+     * The codecs may change their input, every trial gets a copy.
+     */
+    size_t encodedWords(IntegerCODEC &codec, const uint32_t *in, size_t length) {
+        trial.assign(in, in + length);
+        if (scratch.size() < 2 * length + 1024)
+            scratch.resize(2 * length + 1024);
+        size_t words = scratch.size();
+        codec.encodeArray(trial.data(), length, scratch.data(), words);
+        return words;
+    }
+};
+
+#endif /* ADAPTIVECODEC_H_ */
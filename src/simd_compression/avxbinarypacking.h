@@ -0,0 +1,187 @@
+
+
+#ifndef AVXBINARYPACKING_H_
+#define AVXBINARYPACKING_H_
+
+#include "codecs.h"
+#include "avxbitpacking.h"
+#include "util.h"
+
+/**
+ * Block packers for AVXBinaryPacking, the 256-bit counterparts of
+ * SIMDBlockPacker and SIMDIntegratedBlockPacker. The offset carried from
+ * block to block is a plain integer, the last one of the previous block.
+ */
+struct AVXBlockPacker {
+    static void unpackblock(const uint32_t *in, uint32_t *out, const uint32_t bit, uint32_t &) {
+        avxunpack(in, out, bit);
+    }
+
+    static uint32_t maxbits(const uint32_t *in, uint32_t &) {
+        return avxmaxbits(in);
+    }
+
+    static void packblockwithoutmask(uint32_t *in, uint32_t *out, const uint32_t bit, uint32_t &) {
+        avxpackwithoutmask(in, out, bit);
+    }
+
+    static string name() {
+        return string("AVXBlockPacker");
+    }
+};
+
+struct AVXIntegratedBlockPacker {
+    static void unpackblock(const uint32_t *in, uint32_t *out, const uint32_t bit, uint32_t &initoffset) {
+        initoffset = avxiunpack(initoffset, in, out, bit);
+    }
+
+    static uint32_t maxbits(const uint32_t *in, uint32_t &initoffset) {
+        const uint32_t bit = avximaxbits(initoffset, in);
+        initoffset = in[AVXBlockSize - 1];
+        return bit;
+    }
+
+    static void packblockwithoutmask(uint32_t *in, uint32_t *out, const uint32_t bit, uint32_t &initoffset) {
+        avxipackwithoutmask(initoffset, in, out, bit);
+        initoffset = in[AVXBlockSize - 1];
+    }
+
+    static string name() {
+        return string("AVXIntegratedBlockPacker+Delta1");
+    }
+};
+
+/**
+ * Same layout as SIMDBinaryPacking with miniblocks of 256 integers: the
+ * length, then groups of 16 miniblocks each led by their 16 bit widths in 4
+ * words. There is no padding, the 256-bit packers don't need aligned
+ * pointers, so neither does this.
+ *
+ * Requires AVX2, see avxbitpacking.h.
+ */
+template <class BlockPacker>
+class AVXBinaryPacking: public IntegerCODEC {
+public:
+    static const uint32_t MiniBlockSize = AVXBlockSize;
+    static const uint32_t HowManyMiniBlocks = 16;
+    static const uint32_t BlockSize = MiniBlockSize;
+
+    void encodeArray(uint32_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        checkifdivisibleby(length, BlockSize);
+        const uint32_t *const initout(out);
+        *out++ = static_cast<uint32_t>(length);
+        uint32_t Bs[HowManyMiniBlocks];
+        uint32_t init = 0;
+        const uint32_t *const final = in + length;
+        while (in < final) {
+            const size_t howmany = std::min<size_t>((final - in) / MiniBlockSize, HowManyMiniBlocks);
+            uint32_t tmpinit = init;
+            memset(&Bs[0], 0, HowManyMiniBlocks * sizeof(uint32_t));
+            for (uint32_t i = 0; i < howmany; ++i) {
+                Bs[i] = BlockPacker::maxbits(in + i * MiniBlockSize, tmpinit);
+            }
+            for (uint32_t i = 0; i < 4; ++i) {
+                *out++ = (Bs[0 + 4 * i] << 24) | (Bs[1 + 4 * i] << 16) | (Bs[2 + 4 * i] << 8)
+                         | Bs[3 + 4 * i];
+            }
+            for (uint32_t i = 0; i < howmany; ++i) {
+                BlockPacker::packblockwithoutmask(in + i * MiniBlockSize, out, Bs[i], init);
+                out += MiniBlockSize / 32 * Bs[i];
+            }
+            in += howmany * MiniBlockSize;
+        }
+        nvalue = out - initout;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t /*length*/,
+                                uint32_t *out, size_t &nvalue) {
+        const uint32_t actuallength = *in++;
+        const uint32_t *const initout(out);
+        const uint32_t *const final = out + actuallength;
+        uint32_t Bs[HowManyMiniBlocks];
+        uint32_t init = 0;
+        while (out < final) {
+            const size_t howmany = std::min<size_t>((final - out) / MiniBlockSize, HowManyMiniBlocks);
+            for (uint32_t i = 0; i < 4 ; ++i, ++in) {
+                Bs[0 + 4 * i] = static_cast<uint8_t>(in[0] >> 24);
+                Bs[1 + 4 * i] = static_cast<uint8_t>(in[0] >> 16);
+                Bs[2 + 4 * i] = static_cast<uint8_t>(in[0] >> 8);
+                Bs[3 + 4 * i] = static_cast<uint8_t>(in[0]);
+            }
+            for (uint32_t i = 0; i < howmany; ++i) {
+                BlockPacker::unpackblock(in, out + i * MiniBlockSize, Bs[i], init);
+                in += MiniBlockSize / 32 * Bs[i];
+            }
+            out += howmany * MiniBlockSize;
+        }
+        nvalue = out - initout;
+        return in;
+    }
+
+    /**
+     * Decodes one 256-integer miniblock at a time, straight from the
+     * stream.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        Cursor(const uint32_t *in, const size_t length) :
+            in(in), remaining(0), miniblock(HowManyMiniBlocks), init(0) {
+            if (length > 0)
+                remaining = load();
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            if (remaining == 0)
+                return 0;
+            if (miniblock == HowManyMiniBlocks) {
+                for (uint32_t i = 0; i < 4; ++i) {
+                    const uint32_t word = load();
+                    Bs[0 + 4 * i] = static_cast<uint8_t>(word >> 24);
+                    Bs[1 + 4 * i] = static_cast<uint8_t>(word >> 16);
+                    Bs[2 + 4 * i] = static_cast<uint8_t>(word >> 8);
+                    Bs[3 + 4 * i] = static_cast<uint8_t>(word);
+                }
+                miniblock = 0;
+            }
+            const uint32_t bit = Bs[miniblock++];
+            BlockPacker::unpackblock(in, buffer, bit, init);
+            in += MiniBlockSize / 32 * bit;
+            remaining -= MiniBlockSize;
+            span = buffer;
+            return MiniBlockSize;
+        }
+
+        const uint32_t *end() const {
+            return in;
+        }
+
+    private:
+        const uint32_t *in;
+        uint32_t remaining;
+        uint32_t miniblock;
+        uint32_t init;
+        uint32_t Bs[HowManyMiniBlocks];
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+
+        uint32_t load() {
+            uint32_t word;
+            memcpy(&word, in++, sizeof(word));
+            return word;
+        }
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
+    string name() const {
+        ostringstream convert;
+        convert << "AVXBinaryPacking" << "With" << BlockPacker::name() << MiniBlockSize;
+        return convert.str();
+    }
+
+};
+
+#endif /* AVXBINARYPACKING_H_ */
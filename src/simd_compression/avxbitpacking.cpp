@@ -0,0 +1,281 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include "avxbitpacking.h"
+
+/**
+ * Lane shuffles for the 8-lane delta coding, the 256-bit versions of
+ * NoDelta and RegularDeltaSIMD from deltatemplates.h.
+ */
+struct NoDeltaAVX {
+    __attribute__((always_inline))
+    static inline __m256i Delta(__m256i curr, __m256i) {
+        return curr;
+    }
+
+    __attribute__((always_inline))
+    static inline __m256i PrefixSum(__m256i curr, __m256i) {
+        return curr;
+    }
+};
+
+struct RegularDeltaAVX {
+    __attribute__((always_inline))
+    static inline __m256i Delta(__m256i curr, __m256i prev) {
+        // [prev7, curr0, ..., curr6], alignr only shifts within 128-bit
+        // halves so the half it shifts in comes from a permute
+        const __m256i straddle = _mm256_permute2x128_si256(prev, curr, 0x21);
+        return _mm256_sub_epi32(curr, _mm256_alignr_epi8(curr, straddle, 12));
+    }
+
+    __attribute__((always_inline))
+    static inline __m256i PrefixSum(__m256i curr, __m256i prev) {
+        // prefix sums of each half, then the low half's total is carried
+        // into the high half and prev7 into both
+        __m256i sum = _mm256_add_epi32(curr, _mm256_slli_si256(curr, 4));
+        sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+        const __m256i lowtotal = _mm256_permute2x128_si256(_mm256_shuffle_epi32(sum, 0xff), sum, 0x08);
+        sum = _mm256_add_epi32(sum, lowtotal);
+        return _mm256_add_epi32(sum, _mm256_permutevar8x32_epi32(prev, _mm256_set1_epi32(7)));
+    }
+};
+
+/**
+ * Packs the 32 vectors of a block one after the other, bit bits each. With
+ * bit a template parameter the loop unrolls into straight line shifts and
+ * ors like the generated 128-bit packers.
+ */
+template <class DeltaHelper, uint32_t bit>
+static void avxpack(__m256i prev, const uint32_t *_in, uint32_t *_out) {
+    const __m256i *in = reinterpret_cast<const __m256i *>(_in);
+    __m256i *out = reinterpret_cast<__m256i *>(_out);
+    __m256i word = _mm256_setzero_si256();
+    uint32_t shift = 0;
+    for (uint32_t k = 0; k < 32; ++k) {
+        const __m256i curr = _mm256_loadu_si256(in + k);
+        const __m256i value = DeltaHelper::Delta(curr, prev);
+        prev = curr;
+        word = _mm256_or_si256(word, _mm256_slli_epi32(value, shift));
+        shift += bit;
+        if (shift >= 32) {
+            _mm256_storeu_si256(out++, word);
+            shift -= 32;
+            word = shift > 0 ? _mm256_srli_epi32(value, bit - shift) : _mm256_setzero_si256();
+        }
+    }
+}
+
+template <class DeltaHelper, uint32_t bit>
+static __m256i avxunpack(__m256i prev, const uint32_t *_in, uint32_t *_out) {
+    const __m256i *in = reinterpret_cast<const __m256i *>(_in);
+    __m256i *out = reinterpret_cast<__m256i *>(_out);
+    const __m256i mask = _mm256_set1_epi32(bit == 32 ? 0xFFFFFFFFU : (1U << bit) - 1);
+    __m256i word = bit > 0 ? _mm256_loadu_si256(in++) : _mm256_setzero_si256();
+    uint32_t shift = 0;
+    for (uint32_t k = 0; k < 32; ++k) {
+        __m256i value = _mm256_srli_epi32(word, shift);
+        shift += bit;
+        if (shift >= 32) {
+            shift -= 32;
+            if (k < 31 or shift > 0) {
+                word = _mm256_loadu_si256(in++);
+                if (shift > 0)
+                    value = _mm256_or_si256(value, _mm256_slli_epi32(word, bit - shift));
+            }
+        }
+        if (bit < 32)
+            value = _mm256_and_si256(value, mask);
+        prev = DeltaHelper::PrefixSum(value, prev);
+        _mm256_storeu_si256(out++, prev);
+    }
+    return prev;
+}
+
+template <class DeltaHelper>
+static uint32_t avxmaxbits(__m256i prev, const uint32_t *_in) {
+    const __m256i *in = reinterpret_cast<const __m256i *>(_in);
+    __m256i accumulator = _mm256_setzero_si256();
+    for (uint32_t k = 0; k < 32; ++k) {
+        const __m256i curr = _mm256_loadu_si256(in + k);
+        accumulator = _mm256_or_si256(accumulator, DeltaHelper::Delta(curr, prev));
+        prev = curr;
+    }
+    const __m128i half = _mm_or_si128(_mm256_castsi256_si128(accumulator), _mm256_extracti128_si256(accumulator, 1));
+    const uint32_t all = static_cast<uint32_t>(_mm_cvtsi128_si32(half) | _mm_extract_epi32(half, 1)
+                         | _mm_extract_epi32(half, 2) | _mm_extract_epi32(half, 3));
+    return all == 0 ? 0 : 32 - __builtin_clz(all);
+}
+
+typedef void (*avxpacker)(__m256i, const uint32_t *, uint32_t *);
+typedef __m256i (*avxunpacker)(__m256i, const uint32_t *, uint32_t *);
+
+static const avxpacker avxpackers[33] = {
+    &avxpack<NoDeltaAVX, 0>,
+    &avxpack<NoDeltaAVX, 1>,
+    &avxpack<NoDeltaAVX, 2>,
+    &avxpack<NoDeltaAVX, 3>,
+    &avxpack<NoDeltaAVX, 4>,
+    &avxpack<NoDeltaAVX, 5>,
+    &avxpack<NoDeltaAVX, 6>,
+    &avxpack<NoDeltaAVX, 7>,
+    &avxpack<NoDeltaAVX, 8>,
+    &avxpack<NoDeltaAVX, 9>,
+    &avxpack<NoDeltaAVX, 10>,
+    &avxpack<NoDeltaAVX, 11>,
+    &avxpack<NoDeltaAVX, 12>,
+    &avxpack<NoDeltaAVX, 13>,
+    &avxpack<NoDeltaAVX, 14>,
+    &avxpack<NoDeltaAVX, 15>,
+    &avxpack<NoDeltaAVX, 16>,
+    &avxpack<NoDeltaAVX, 17>,
+    &avxpack<NoDeltaAVX, 18>,
+    &avxpack<NoDeltaAVX, 19>,
+    &avxpack<NoDeltaAVX, 20>,
+    &avxpack<NoDeltaAVX, 21>,
+    &avxpack<NoDeltaAVX, 22>,
+    &avxpack<NoDeltaAVX, 23>,
+    &avxpack<NoDeltaAVX, 24>,
+    &avxpack<NoDeltaAVX, 25>,
+    &avxpack<NoDeltaAVX, 26>,
+    &avxpack<NoDeltaAVX, 27>,
+    &avxpack<NoDeltaAVX, 28>,
+    &avxpack<NoDeltaAVX, 29>,
+    &avxpack<NoDeltaAVX, 30>,
+    &avxpack<NoDeltaAVX, 31>,
+    &avxpack<NoDeltaAVX, 32>,
+};
+
+static const avxunpacker avxunpackers[33] = {
+    &avxunpack<NoDeltaAVX, 0>,
+    &avxunpack<NoDeltaAVX, 1>,
+    &avxunpack<NoDeltaAVX, 2>,
+    &avxunpack<NoDeltaAVX, 3>,
+    &avxunpack<NoDeltaAVX, 4>,
+    &avxunpack<NoDeltaAVX, 5>,
+    &avxunpack<NoDeltaAVX, 6>,
+    &avxunpack<NoDeltaAVX, 7>,
+    &avxunpack<NoDeltaAVX, 8>,
+    &avxunpack<NoDeltaAVX, 9>,
+    &avxunpack<NoDeltaAVX, 10>,
+    &avxunpack<NoDeltaAVX, 11>,
+    &avxunpack<NoDeltaAVX, 12>,
+    &avxunpack<NoDeltaAVX, 13>,
+    &avxunpack<NoDeltaAVX, 14>,
+    &avxunpack<NoDeltaAVX, 15>,
+    &avxunpack<NoDeltaAVX, 16>,
+    &avxunpack<NoDeltaAVX, 17>,
+    &avxunpack<NoDeltaAVX, 18>,
+    &avxunpack<NoDeltaAVX, 19>,
+    &avxunpack<NoDeltaAVX, 20>,
+    &avxunpack<NoDeltaAVX, 21>,
+    &avxunpack<NoDeltaAVX, 22>,
+    &avxunpack<NoDeltaAVX, 23>,
+    &avxunpack<NoDeltaAVX, 24>,
+    &avxunpack<NoDeltaAVX, 25>,
+    &avxunpack<NoDeltaAVX, 26>,
+    &avxunpack<NoDeltaAVX, 27>,
+    &avxunpack<NoDeltaAVX, 28>,
+    &avxunpack<NoDeltaAVX, 29>,
+    &avxunpack<NoDeltaAVX, 30>,
+    &avxunpack<NoDeltaAVX, 31>,
+    &avxunpack<NoDeltaAVX, 32>,
+};
+
+static const avxpacker avxipackers[33] = {
+    &avxpack<RegularDeltaAVX, 0>,
+    &avxpack<RegularDeltaAVX, 1>,
+    &avxpack<RegularDeltaAVX, 2>,
+    &avxpack<RegularDeltaAVX, 3>,
+    &avxpack<RegularDeltaAVX, 4>,
+    &avxpack<RegularDeltaAVX, 5>,
+    &avxpack<RegularDeltaAVX, 6>,
+    &avxpack<RegularDeltaAVX, 7>,
+    &avxpack<RegularDeltaAVX, 8>,
+    &avxpack<RegularDeltaAVX, 9>,
+    &avxpack<RegularDeltaAVX, 10>,
+    &avxpack<RegularDeltaAVX, 11>,
+    &avxpack<RegularDeltaAVX, 12>,
+    &avxpack<RegularDeltaAVX, 13>,
+    &avxpack<RegularDeltaAVX, 14>,
+    &avxpack<RegularDeltaAVX, 15>,
+    &avxpack<RegularDeltaAVX, 16>,
+    &avxpack<RegularDeltaAVX, 17>,
+    &avxpack<RegularDeltaAVX, 18>,
+    &avxpack<RegularDeltaAVX, 19>,
+    &avxpack<RegularDeltaAVX, 20>,
+    &avxpack<RegularDeltaAVX, 21>,
+    &avxpack<RegularDeltaAVX, 22>,
+    &avxpack<RegularDeltaAVX, 23>,
+    &avxpack<RegularDeltaAVX, 24>,
+    &avxpack<RegularDeltaAVX, 25>,
+    &avxpack<RegularDeltaAVX, 26>,
+    &avxpack<RegularDeltaAVX, 27>,
+    &avxpack<RegularDeltaAVX, 28>,
+    &avxpack<RegularDeltaAVX, 29>,
+    &avxpack<RegularDeltaAVX, 30>,
+    &avxpack<RegularDeltaAVX, 31>,
+    &avxpack<RegularDeltaAVX, 32>,
+};
+
+static const avxunpacker avxiunpackers[33] = {
+    &avxunpack<RegularDeltaAVX, 0>,
+    &avxunpack<RegularDeltaAVX, 1>,
+    &avxunpack<RegularDeltaAVX, 2>,
+    &avxunpack<RegularDeltaAVX, 3>,
+    &avxunpack<RegularDeltaAVX, 4>,
+    &avxunpack<RegularDeltaAVX, 5>,
+    &avxunpack<RegularDeltaAVX, 6>,
+    &avxunpack<RegularDeltaAVX, 7>,
+    &avxunpack<RegularDeltaAVX, 8>,
+    &avxunpack<RegularDeltaAVX, 9>,
+    &avxunpack<RegularDeltaAVX, 10>,
+    &avxunpack<RegularDeltaAVX, 11>,
+    &avxunpack<RegularDeltaAVX, 12>,
+    &avxunpack<RegularDeltaAVX, 13>,
+    &avxunpack<RegularDeltaAVX, 14>,
+    &avxunpack<RegularDeltaAVX, 15>,
+    &avxunpack<RegularDeltaAVX, 16>,
+    &avxunpack<RegularDeltaAVX, 17>,
+    &avxunpack<RegularDeltaAVX, 18>,
+    &avxunpack<RegularDeltaAVX, 19>,
+    &avxunpack<RegularDeltaAVX, 20>,
+    &avxunpack<RegularDeltaAVX, 21>,
+    &avxunpack<RegularDeltaAVX, 22>,
+    &avxunpack<RegularDeltaAVX, 23>,
+    &avxunpack<RegularDeltaAVX, 24>,
+    &avxunpack<RegularDeltaAVX, 25>,
+    &avxunpack<RegularDeltaAVX, 26>,
+    &avxunpack<RegularDeltaAVX, 27>,
+    &avxunpack<RegularDeltaAVX, 28>,
+    &avxunpack<RegularDeltaAVX, 29>,
+    &avxunpack<RegularDeltaAVX, 30>,
+    &avxunpack<RegularDeltaAVX, 31>,
+    &avxunpack<RegularDeltaAVX, 32>,
+};
+
+void avxpackwithoutmask(const uint32_t *in, uint32_t *out, const uint32_t bit) {
+    avxpackers[bit](_mm256_setzero_si256(), in, out);
+}
+
+void avxunpack(const uint32_t *in, uint32_t *out, const uint32_t bit) {
+    avxunpackers[bit](_mm256_setzero_si256(), in, out);
+}
+
+uint32_t avxmaxbits(const uint32_t *in) {
+    return avxmaxbits<NoDeltaAVX>(_mm256_setzero_si256(), in);
+}
+
+void avxipackwithoutmask(uint32_t initoffset, const uint32_t *in, uint32_t *out, const uint32_t bit) {
+    avxipackers[bit](_mm256_set1_epi32(static_cast<int>(initoffset)), in, out);
+}
+
+uint32_t avxiunpack(uint32_t initoffset, const uint32_t *in, uint32_t *out, const uint32_t bit) {
+    avxiunpackers[bit](_mm256_set1_epi32(static_cast<int>(initoffset)), in, out);
+    return out[AVXBlockSize - 1];
+}
+
+uint32_t avximaxbits(uint32_t initoffset, const uint32_t *in) {
+    return avxmaxbits<RegularDeltaAVX>(_mm256_set1_epi32(static_cast<int>(initoffset)), in);
+}
@@ -0,0 +1,42 @@
+
+
+#ifndef AVXBITPACKING_H_
+#define AVXBITPACKING_H_
+
+#include "common.h"
+
+/**
+ * 256-bit (AVX2) counterparts of simdpackwithoutmask/simdunpack and of the
+ * integrated SIMDipackwithoutmask/SIMDiunpack with RegularDeltaSIMD.
+ *
+ * A block holds 256 integers in 8 lanes of 32 integers each: in[i] goes to
+ * lane i % 8, exactly like the 128-bit packers with twice the lanes. A block
+ * packed with bit bits takes 8 * bit words. Neither input nor output needs
+ * to be aligned.
+ *
+ * The definitions live in avxbitpacking.cpp, the only file compiled with
+ * -mavx2, so that nothing here requires AVX2 from the callers. Do not call
+ * them on a processor without AVX2.
+ */
+
+const uint32_t AVXBlockSize = 256;
+
+void avxpackwithoutmask(const uint32_t *in, uint32_t *out, const uint32_t bit);
+void avxunpack(const uint32_t *in, uint32_t *out, const uint32_t bit);
+
+/**
+ * Bits needed for the largest of the 256 integers.
+ */
+uint32_t avxmaxbits(const uint32_t *in);
+
+/**
+ * Integrated differential coding: what gets packed is in[i] - in[i - 1],
+ * in[-1] being initoffset (the last integer of the previous block, 0 for
+ * the first). avxiunpack returns the last integer it wrote, the initoffset
+ * of the next block.
+ */
+void avxipackwithoutmask(uint32_t initoffset, const uint32_t *in, uint32_t *out, const uint32_t bit);
+uint32_t avxiunpack(uint32_t initoffset, const uint32_t *in, uint32_t *out, const uint32_t bit);
+uint32_t avximaxbits(uint32_t initoffset, const uint32_t *in);
+
+#endif /* AVXBITPACKING_H_ */
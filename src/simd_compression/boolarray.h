@@ -62,6 +62,37 @@ public:
     }
 
 
+    void SIMDinplaceUnion(const BoolArray &other) {
+        assert(other.buffer.size() == buffer.size());
+        __m128i *bin = reinterpret_cast<__m128i *>(buffer.data());
+        const  __m128i *bo = reinterpret_cast<const  __m128i *>(other.buffer.data());
+        for (size_t i = 0; i < buffer.size() / 2; ++i) {
+            __m128i p1 = _mm_load_si128(bin + i);
+            __m128i p2 = _mm_load_si128(bo + i);
+            __m128i orp1p2 = _mm_or_si128(p1, p2);
+            _mm_storeu_si128(bin + i, orp1p2);
+        }
+        for (size_t i = buffer.size() / 2 * 2; i < buffer.size(); ++i)
+            buffer[i] |= other.buffer[i];
+    }
+
+    /**
+     * Clears every bit that is set in other.
+     */
+    void SIMDinplaceAndNot(const BoolArray &other) {
+        assert(other.buffer.size() == buffer.size());
+        __m128i *bin = reinterpret_cast<__m128i *>(buffer.data());
+        const  __m128i *bo = reinterpret_cast<const  __m128i *>(other.buffer.data());
+        for (size_t i = 0; i < buffer.size() / 2; ++i) {
+            __m128i p1 = _mm_load_si128(bin + i);
+            __m128i p2 = _mm_load_si128(bo + i);
+            __m128i andnotp2p1 = _mm_andnot_si128(p2, p1);
+            _mm_storeu_si128(bin + i, andnotp2p1);
+        }
+        for (size_t i = buffer.size() / 2 * 2; i < buffer.size(); ++i)
+            buffer[i] &= ~other.buffer[i];
+    }
+
     void intersect(const BoolArray &other, BoolArray &output) {
         assert(other.buffer.size() == buffer.size());
         output.buffer.resize(buffer.size());
@@ -153,7 +184,7 @@ public:
      */
     __attribute__((always_inline))
     inline void unset(const size_t pos) {
-        buffer[pos / 64] |= ~(static_cast<uint64_t>(1) << (pos
+        buffer[pos / 64] &= ~(static_cast<uint64_t>(1) << (pos
                               % 64));
     }
 
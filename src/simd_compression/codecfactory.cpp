@@ -0,0 +1,19 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ * (c) Daniel Lemire, http://lemire.me/en/
+ */
+
+#include "codecfactory.h"
+
+map<string, codecconstructor> CODECFactory::sconstructors =
+    initializeconstructors();
+
+map<string, shared_ptr<IntegerCODEC>> CODECFactory::scodecmap =
+                                       initializefactory();
+
+shared_ptr<IntegerCODEC> CODECFactory::defaultptr = shared_ptr<IntegerCODEC>(nullptr);
+
+map<string, codec64constructor> CODEC64Factory::sconstructors =
+    initializeconstructors64();
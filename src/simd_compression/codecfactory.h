@@ -16,81 +16,103 @@
 #include "simdbitpackinghelpers.h"
 #include "delta.h"
 #include "util.h"
-#include "synthetic.h"
 #include "binarypacking.h"
 #include "simdbinarypacking.h"
+#include "simdindexedbinarypacking.h"
+#include "eliasfano.h"
+#include "avxbinarypacking.h"
+#include "cpuinfo.h"
 #include "fastpfor.h"
 #include "simdfastpfor.h"
 #include "variablebyte.h"
+#include "streamvbyte.h"
+#include "codecs64.h"
+#include "adaptivecodec.h"
 
 using namespace std;
 
 typedef VariableByte<true>  leftovercodec;
 
-static std::map<string, shared_ptr<IntegerCODEC>> initializefactory() {
-    std::map <string, shared_ptr<IntegerCODEC>> schemes;
+typedef IntegerCODEC *(*codecconstructor)();
+
+template <class Codec>
+IntegerCODEC *constructcodec() {
+    return new Codec();
+}
+
+inline std::map<string, codecconstructor> initializeconstructors() {
+    std::map <string, codecconstructor> schemes;
+
+    schemes["fastpfor"] = constructcodec<CompositeCodec<FastPFor<true>, leftovercodec>>;
+
+
+    schemes["copy"] = constructcodec<JustCopy>;
+
+    schemes["varint"] = constructcodec<VariableByte<true>>;
+    schemes["streamvbyte"] = constructcodec<StreamVByte<NoDelta>>;
+    schemes["streamvbyte-1"] = constructcodec<StreamVByte<RegularDeltaSIMD>>;
+    schemes["s4-fastpfor-4"] = constructcodec<CompositeCodec<SIMDFastPFor<CoarseDelta4SIMD>, leftovercodec>>;
+
+    schemes["s4-fastpfor-m"] = constructcodec<CompositeCodec<SIMDFastPFor<Max4DeltaSIMD>, VariableByte<true>>>;
+    schemes["s4-fastpfor-1"] = constructcodec<CompositeCodec<SIMDFastPFor<RegularDeltaSIMD>, leftovercodec>>;
+    schemes["s4-fastpfor-2"] = constructcodec<CompositeCodec<SIMDFastPFor<CoarseDelta2SIMD>, leftovercodec>>;
+
+    schemes["bp32"] = constructcodec<CompositeCodec<BinaryPacking<BasicBlockPacker>, VariableByte<true>>>;
+    schemes["ibp32"] = constructcodec<CompositeCodec<BinaryPacking<IntegratedBlockPacker>, leftovercodec>>;
+
+    schemes["s4-bp128+d1"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDBlockPacker<RegularDeltaSIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128+d2"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDBlockPacker<CoarseDelta2SIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128+d4"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDBlockPacker<CoarseDelta4SIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128+dm"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDBlockPacker<Max4DeltaSIMD, true>>, leftovercodec>>;
+
+    schemes["s4-bp128-1"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128-2"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<CoarseDelta2SIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128-4"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<CoarseDelta4SIMD, true>>, leftovercodec>>;
+    schemes["s4-bp128-m"] = constructcodec<CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<Max4DeltaSIMD, true>>, leftovercodec>>;
+
+    // same blocks as s4-bp128-1 with a header each, implements
+    // RandomAccessCODEC
+    schemes["s4-bp128-1-ra"] = constructcodec<SIMDIndexedBinaryPacking<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true>>>;
+
+    // partitioned Elias-Fano, implements RandomAccessCODEC, for long
+    // sorted lists that are mostly skipped through
+    schemes["pef128"] = constructcodec<EliasFano>;
+
+    // one of s4-bp128-1, s4-fastpfor-1, streamvbyte-1 and pef128 per list,
+    // see AdaptiveCODEC
+    schemes["adaptive"] = constructcodec<AdaptiveCODEC>;
 
-    schemes["fastpfor"] = shared_ptr<IntegerCODEC> (
-                              new CompositeCodec<FastPFor<true> ,
-                              leftovercodec> ());
-
-
-    schemes["copy"] = shared_ptr<IntegerCODEC> (new JustCopy());
-
-    schemes["varint"] = shared_ptr<IntegerCODEC> (new VariableByte<true> ());
-    schemes["s4-fastpfor-4"] = shared_ptr<IntegerCODEC> (
-                                   new CompositeCodec<SIMDFastPFor<CoarseDelta4SIMD> , leftovercodec> ());
-
-    schemes["s4-fastpfor-m"]
-        = shared_ptr<IntegerCODEC> (
-              new CompositeCodec<SIMDFastPFor<Max4DeltaSIMD> ,
-              VariableByte<true>> ());
-    schemes["s4-fastpfor-1"] = shared_ptr<IntegerCODEC> (
-                                   new CompositeCodec<SIMDFastPFor<RegularDeltaSIMD> , leftovercodec> ());
-    schemes["s4-fastpfor-2"] = shared_ptr<IntegerCODEC> (
-                                   new CompositeCodec<SIMDFastPFor<CoarseDelta2SIMD> , leftovercodec> ());
-
-    schemes["bp32"] = shared_ptr<IntegerCODEC> (
-                          new CompositeCodec<BinaryPacking<BasicBlockPacker> , VariableByte<
-                          true>> ());
-    schemes["ibp32"] = shared_ptr<IntegerCODEC> (
-                           new CompositeCodec<BinaryPacking<IntegratedBlockPacker> ,
-                           leftovercodec> ());
-
-    schemes["s4-bp128+d1"] = shared_ptr<IntegerCODEC> (
-                                 new CompositeCodec <SIMDBinaryPacking<SIMDBlockPacker<
-                                 RegularDeltaSIMD, true>> , leftovercodec> ());
-    schemes["s4-bp128+d2"] = shared_ptr<IntegerCODEC> (
-                                 new CompositeCodec <SIMDBinaryPacking<SIMDBlockPacker<
-                                 CoarseDelta2SIMD, true>>, leftovercodec> ());
-    schemes["s4-bp128+d4"] = shared_ptr<IntegerCODEC> (
-                                 new CompositeCodec <SIMDBinaryPacking<SIMDBlockPacker<
-                                 CoarseDelta4SIMD, true>>, leftovercodec> ());
-    schemes["s4-bp128+dm"] = shared_ptr<IntegerCODEC> (
-                                 new CompositeCodec <SIMDBinaryPacking<SIMDBlockPacker<
-                                 Max4DeltaSIMD, true>>, leftovercodec> ());
-
-    schemes["s4-bp128-1"] = shared_ptr<IntegerCODEC> (
-                                new CompositeCodec <SIMDBinaryPacking<SIMDIntegratedBlockPacker<
-                                RegularDeltaSIMD, true>>, leftovercodec> ());
-    schemes["s4-bp128-2"] = shared_ptr<IntegerCODEC> (
-                                new CompositeCodec <SIMDBinaryPacking<SIMDIntegratedBlockPacker<
-                                CoarseDelta2SIMD, true>>, leftovercodec> ());
-    schemes["s4-bp128-4"] = shared_ptr<IntegerCODEC> (
-                                new CompositeCodec <SIMDBinaryPacking<SIMDIntegratedBlockPacker<
-                                CoarseDelta4SIMD, true>>, leftovercodec> ());
-    schemes["s4-bp128-m"] = shared_ptr<IntegerCODEC> (
-                                new CompositeCodec <SIMDBinaryPacking<SIMDIntegratedBlockPacker<
-                                Max4DeltaSIMD, true>>, leftovercodec> ());
+    // 8 lanes of 32 integers, only offered where the processor has AVX2.
+    // Unlike the intersections this follows the processor and not
+    // HELLCAT_SIMD, a stream can only be decoded by the codec it was
+    // written with.
+    if (getcpufeatures().avx2) {
+        schemes["s8-bp256"] = constructcodec<CompositeCodec<AVXBinaryPacking<AVXBlockPacker>, leftovercodec>>;
+        schemes["s8-bp256-1"] = constructcodec<CompositeCodec<AVXBinaryPacking<AVXIntegratedBlockPacker>, leftovercodec>>;
+    }
+
+    return schemes;
+}
 
+inline std::map<string, shared_ptr<IntegerCODEC>> initializefactory() {
+    std::map <string, shared_ptr<IntegerCODEC>> schemes;
+    const std::map<string, codecconstructor> constructors = initializeconstructors();
+    for (auto i = constructors.begin(); i != constructors.end(); ++i)
+        schemes[i->first] = shared_ptr<IntegerCODEC> (i->second());
     return schemes;
 }
 
 
 
+/**
+ * The codecs of scodecmap are shared by every thread, which is only safe
+ * for the codecs without state. FastPFor and SIMDFastPFor keep scratch
+ * buffers, use getThreadLocal when several threads encode or decode.
+ */
 class CODECFactory {
 public:
     static map<string, shared_ptr<IntegerCODEC>> scodecmap;
+    static map<string, codecconstructor> sconstructors;
     static shared_ptr<IntegerCODEC> defaultptr;
 
     // hacked for convenience
@@ -151,10 +173,92 @@ public:
         return scodecmap[name];
     }
 
+    /**
+     * Id of a codec for getThreadLocal, throws if there is no such codec.
+     * Look it up once, ids are positions in sconstructors.
+     */
+    static size_t getId(const string &name) {
+        auto i = sconstructors.find(name);
+        if (i == sconstructors.end())
+            throw invalid_argument("name " + name + " does not refer to a CODEC.");
+        return std::distance(sconstructors.begin(), i);
+    }
+
+    /**
+     * The calling thread's own instance of the codec, created on first
+     * use and kept until the thread exits, so its scratch buffers are
+     * allocated once per thread and never shared.
+     */
+    static IntegerCODEC &getThreadLocal(size_t id) {
+        static thread_local vector<unique_ptr<IntegerCODEC>> instances;
+        if (instances.size() < sconstructors.size())
+            instances.resize(sconstructors.size());
+        unique_ptr<IntegerCODEC> &instance = instances[id];
+        if (!instance) {
+            auto i = sconstructors.begin();
+            std::advance(i, id);
+            instance.reset(i->second());
+        }
+        return *instance;
+    }
+
+    static IntegerCODEC &getThreadLocal(const string &name) {
+        return getThreadLocal(getId(name));
+    }
+
 };
 
-map<string, shared_ptr<IntegerCODEC>> CODECFactory::scodecmap =
-                                       initializefactory();
+typedef IntegerCODEC64 *(*codec64constructor)();
+
+template <class Codec>
+IntegerCODEC64 *constructcodec64() {
+    return new Codec();
+}
+
+inline std::map<string, codec64constructor> initializeconstructors64() {
+    std::map <string, codec64constructor> schemes;
+
+    // high halves grouped, low halves through the 32-bit codec of the same
+    // name
+    schemes["highlow-s4-bp128-1"] = constructcodec64<HighLowCODEC64<CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true>>, leftovercodec>>>;
+    schemes["highlow-s4-fastpfor-1"] = constructcodec64<HighLowCODEC64<CompositeCodec<SIMDFastPFor<RegularDeltaSIMD>, leftovercodec>>>;
+    schemes["highlow-streamvbyte-1"] = constructcodec64<HighLowCODEC64<StreamVByte<RegularDeltaSIMD>>>;
+
+    schemes["for64"] = constructcodec64<FrameOfReference64<false>>;
+    schemes["for64-1"] = constructcodec64<FrameOfReference64<true>>;
+
+    return schemes;
+}
+
+/**
+ * The 64-bit codecs of codecs64.h. They all keep scratch buffers, so there
+ * are no shared instances, every caller makes its own.
+ */
+class CODEC64Factory {
+public:
+    static map<string, codec64constructor> sconstructors;
+
+    static vector<string> allNames() {
+        vector <string> ans;
+        for (auto i = sconstructors.begin(); i != sconstructors.end(); ++i) {
+            ans.push_back(i->first);
+        }
+        return ans;
+    }
+
+    static bool valid(string name) {
+        return (sconstructors.find(name) != sconstructors.end()) ;
+    }
+
+    /**
+     * A new instance of the codec, throws if there is no such codec.
+     */
+    static unique_ptr<IntegerCODEC64> newFromName(const string &name) {
+        auto i = sconstructors.find(name);
+        if (i == sconstructors.end())
+            throw invalid_argument("name " + name + " does not refer to a 64-bit CODEC.");
+        return unique_ptr<IntegerCODEC64>(i->second());
+    }
+};
 
-shared_ptr<IntegerCODEC> CODECFactory::defaultptr = shared_ptr<IntegerCODEC>(nullptr);
 #endif /* CODECFACTORY_H_ */
@@ -24,6 +24,42 @@ public:
     }
 };
 
+/**
+ * Walks a stream written by an IntegerCODEC one block at a time, so that a
+ * list can be consumed without decoding it in full. Get one from
+ * IntegerCODEC::newCursor, see also PostingCursor for integer by integer
+ * access.
+ */
+class IntegerCursor {
+public:
+    /**
+     * Decodes the next block, points span at it and returns its size, 0
+     * once the stream is exhausted. span stays valid until the next call
+     * and has no particular alignment.
+     */
+    virtual size_t nextBlock(const uint32_t *&span) = 0;
+
+    /**
+     * Same as nextBlock on a sorted stream, but blocks whose integers are
+     * known to be all below target may be passed over without decoding
+     * them. The block returned can still be entirely below target.
+     */
+    virtual size_t skipTo(uint32_t target, const uint32_t *&span) {
+        size_t length;
+        while ((length = nextBlock(span)) > 0 and span[length - 1] < target) {
+        }
+        return length;
+    }
+
+    /**
+     * Once the stream is exhausted, the first word past it.
+     */
+    virtual const uint32_t *end() const = 0;
+
+    virtual ~IntegerCursor() {
+    }
+};
+
 class IntegerCODEC {
 public:
 
@@ -102,9 +138,95 @@ public:
         return data;
     }
 
+    /**
+     * A cursor over the length words at in, holding expected integers (as
+     * for uncompress, only a hint to some codecs). The default decodes the
+     * whole stream up front into a buffer of expected integers, the block
+     * codecs override it to decode one block at a time in constant memory.
+     * Alignment requirements are those of decodeArray.
+     */
+    virtual unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+            const size_t expected);
+
     virtual string name() const = 0;
 };
 
+/**
+ * The cursor of the codecs that can only decode a stream in one go: all of
+ * it is decoded when the cursor is created, then handed out in blocks.
+ */
+class BufferedCursor: public IntegerCursor {
+public:
+    static const uint32_t BlockSize = 128;
+
+    BufferedCursor(IntegerCODEC &codec, const uint32_t *in, const size_t length,
+                   const size_t expected) :
+        data(expected + 1024), position(0), stop(in) {
+        size_t nvalue = data.size();
+        if (length > 0)
+            stop = codec.decodeArray(in, length, data.data(), nvalue);
+        else
+            nvalue = 0;
+        data.resize(nvalue);
+    }
+
+    size_t nextBlock(const uint32_t *&span) {
+        const size_t length = std::min<size_t>(data.size() - position, BlockSize);
+        span = data.data() + position;
+        position += length;
+        return length;
+    }
+
+    const uint32_t *end() const {
+        return stop;
+    }
+
+private:
+    vector<uint32_t> data;
+    size_t position;
+    const uint32_t *stop;
+};
+
+inline unique_ptr<IntegerCursor> IntegerCODEC::newCursor(const uint32_t *in, const size_t length,
+        const size_t expected) {
+    return unique_ptr<IntegerCursor>(new BufferedCursor(*this, in, length, expected));
+}
+
+/**
+ * Optional interface of the codecs that can reach into a stream written by
+ * their encodeArray without decoding it up to the target, found with a
+ * dynamic_cast from IntegerCODEC. The stream needs no particular alignment.
+ */
+class RandomAccessCODEC {
+public:
+    /**
+     * The integer at index, which must be less than the length encoded.
+     */
+    virtual uint32_t select(const uint32_t *in, size_t index) = 0;
+
+    /**
+     * Index of the first integer >= key in a sorted stream, the encoded
+     * length if there is none. *presult gets the integer found.
+     */
+    virtual size_t lowerBound(const uint32_t *in, uint32_t key, uint32_t *presult) = 0;
+
+    /**
+     * Same as lowerBound but starting at index from, the index returned by
+     * the previous call when skipping through a stream with increasing keys.
+     * Gallops forward from there so the cost depends on the distance
+     * skipped, not on the length.
+     */
+    virtual size_t findAndAdvance(const uint32_t *in, uint32_t key, size_t from, uint32_t *presult) = 0;
+
+    /**
+     * Number of integers encoded.
+     */
+    virtual size_t encodedLength(const uint32_t *in) = 0;
+
+    virtual ~RandomAccessCODEC() {
+    }
+};
+
 /******************
  * This just copies the data, no compression.
  */
@@ -127,6 +249,38 @@ public:
         nvalue = length;
         return in + length;
     }
+    /**
+     * Hands out the stream itself, 128 integers at a time.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        static const uint32_t BlockSize = 128;
+
+        Cursor(const uint32_t *in, const size_t length) :
+            in(in), final(in + length) {
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            const size_t length = std::min<size_t>(final - in, BlockSize);
+            span = in;
+            in += length;
+            return length;
+        }
+
+        const uint32_t *end() const {
+            return final;
+        }
+
+    private:
+        const uint32_t *in;
+        const uint32_t *final;
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
     string name() const {
         return "JustCopy";
     }
@@ -0,0 +1,311 @@
+
+
+#ifndef CODECS64_H_
+#define CODECS64_H_
+
+#include "common.h"
+#include "codecs.h"
+#include "simdbitpackinghelpers.h"
+#include "util.h"
+
+/**
+ * Same contract as IntegerCODEC for 64-bit integers. The compressed
+ * stream is still made of 32-bit words, lengths are in words.
+ */
+class IntegerCODEC64 {
+public:
+    /**
+     * You specify input and input length, as well as
+     * output and output length. nvalue gets modified to
+     * reflect how much was used. If the new value of
+     * nvalue is more than the original value, we can
+     * consider this a buffer overrun.
+     */
+    virtual void encodeArray(const uint64_t *in, const size_t length,
+                             uint32_t *out, size_t &nvalue) = 0;
+
+    /**
+     * Usage is similar to encodeArray except that it returns a pointer
+     * incremented from in. nvalue is the capacity of out on the way in,
+     * NotEnoughStorage is thrown when it is too small.
+     */
+    virtual const uint32_t *decodeArray(const uint32_t *in,
+                                        const size_t length, uint64_t *out, size_t &nvalue) = 0;
+
+    virtual ~IntegerCODEC64() {
+    }
+
+    virtual string name() const = 0;
+};
+
+/**
+ * Sorted 64-bit integers split in their high and low 32 bits. Runs of
+ * integers sharing their high half form a group, the low halves of a
+ * group are sorted 32-bit integers compressed by LowCodec, the usual
+ * 32-bit SIMD codecs. Layout:
+ *
+ *   length
+ *   number of groups
+ *   per group: high half, number of integers, size of the low halves in
+ *   words, the low halves
+ *
+ * A list under 2^32, or any dense list, is one group and costs 5 words
+ * more than with LowCodec alone. Ids scattered over many high halves
+ * pay the group header and LowCodec's own overhead for every few ids,
+ * FrameOfReference64 suits them better. No pointer needs to be aligned.
+ */
+template <class LowCodec>
+class HighLowCODEC64: public IntegerCODEC64 {
+public:
+    HighLowCODEC64() : codec(), lows(), aligned() {
+    }
+
+    void encodeArray(const uint64_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        uint32_t *const initout = out;
+        store(out++, static_cast<uint32_t>(length));
+        uint32_t *groups = out++;
+        uint32_t groupcount = 0;
+        for (size_t i = 0; i < length;) {
+            const uint32_t high = static_cast<uint32_t>(in[i] >> 32);
+            size_t j = i;
+            lows.clear();
+            for (; j < length and static_cast<uint32_t>(in[j] >> 32) == high; ++j)
+                lows.push_back(static_cast<uint32_t>(in[j]));
+            // the codecs pack from 16-byte aligned memory
+            lows.resize(lows.size() + 4);
+            store(out, high);
+            store(out + 1, static_cast<uint32_t>(j - i));
+            size_t words = nvalue - (out + 3 - initout);
+            encode(lows.data(), j - i, out + 3, words);
+            store(out + 2, static_cast<uint32_t>(words));
+            out += 3 + words;
+            ++groupcount;
+            i = j;
+        }
+        store(groups, groupcount);
+        nvalue = out - initout;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t length,
+                                uint64_t *out, size_t &nvalue) {
+        if (length == 0) {
+            nvalue = 0;
+            return in;
+        }
+        const uint32_t count = load(in);
+        if (count > nvalue)
+            throw NotEnoughStorage(count);
+        const uint32_t groupcount = load(in + 1);
+        in += 2;
+        for (uint32_t g = 0; g < groupcount; ++g) {
+            const uint32_t high = load(in);
+            const uint32_t groupsize = load(in + 1);
+            const uint32_t words = load(in + 2);
+            in += 3;
+            // the codecs may write past the end of a block
+            if (lows.size() < groupsize + 1024)
+                lows.resize(groupsize + 1024);
+            size_t decoded = lows.size();
+            decode(in, words, lows.data(), decoded);
+            widen(lows.data(), decoded, high, out);
+            out += decoded;
+            in += words;
+        }
+        nvalue = count;
+        return in;
+    }
+
+    string name() const {
+        return "HighLow64+" + codec.name();
+    }
+
+private:
+    LowCodec codec;
+    vector<uint32_t> lows;
+    vector<uint32_t> aligned;
+
+    static uint32_t load(const uint32_t *in) {
+        uint32_t word;
+        memcpy(&word, in, sizeof(word));
+        return word;
+    }
+
+    static void store(uint32_t *out, uint32_t word) {
+        memcpy(out, &word, sizeof(word));
+    }
+
+    static uint32_t *align(uint32_t *p) {
+        return reinterpret_cast<uint32_t *>((reinterpret_cast<uintptr_t>(p) + 15) & ~static_cast<uintptr_t>(15));
+    }
+
+    /**
+     * The packers want their words 16-byte aligned, which a slice of the
+     * caller's buffer isn't, so the words go through an aligned copy.
+     */
+    void encode(uint32_t *in, size_t length, uint32_t *out, size_t &nvalue) {
+        if (aligned.size() < nvalue + 4)
+            aligned.resize(nvalue + 4);
+        uint32_t *const start = align(aligned.data());
+        size_t words = aligned.data() + aligned.size() - start;
+        codec.encodeArray(in, length, start, words);
+        if (words > nvalue)
+            throw NotEnoughStorage(words);
+        memcpy(out, start, words * sizeof(uint32_t));
+        nvalue = words;
+    }
+
+    void decode(const uint32_t *in, size_t length, uint32_t *out, size_t &nvalue) {
+        if (aligned.size() < length + 4)
+            aligned.resize(length + 4);
+        uint32_t *const start = align(aligned.data());
+        memcpy(start, in, length * sizeof(uint32_t));
+        codec.decodeArray(start, length, out, nvalue);
+    }
+
+    static void widen(const uint32_t *lows, size_t length, uint32_t high, uint64_t *out) {
+        const __m128i highs = _mm_set1_epi64x(static_cast<int64_t>(static_cast<uint64_t>(high) << 32));
+        size_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lows + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                             _mm_or_si128(_mm_cvtepu32_epi64(low), highs));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 2),
+                             _mm_or_si128(_mm_cvtepu32_epi64(_mm_srli_si128(low, 8)), highs));
+        }
+        for (; i < length; ++i)
+            out[i] = static_cast<uint64_t>(high) << 32 | lows[i];
+    }
+};
+
+/**
+ * Frame of reference over blocks of 128 64-bit integers. With Delta, the
+ * differences between successive integers are coded instead of the
+ * integers themselves, for sorted input. Every block keeps its smallest
+ * value as reference and bit packs the value minus the reference, in up
+ * to 64 bits: the low 32 bits and, past 32 bits, the high bits are each
+ * packed with the 32-bit SIMD packers. Layout:
+ *
+ *   length
+ *   per block: reference (low then high word), bit width, the packed
+ *   low bits (4 words per bit up to 32), the packed high bits (4 words
+ *   per bit over 32)
+ *
+ * The last block is padded with zeros. Arithmetic is modulo 2^64 so any
+ * input round trips, unsorted input with Delta just packs poorly. No
+ * pointer needs to be aligned.
+ */
+template <bool Delta>
+class FrameOfReference64: public IntegerCODEC64 {
+public:
+    static const uint32_t BlockSize = 128;
+
+    void encodeArray(const uint64_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        uint32_t *const initout = out;
+        store(out++, static_cast<uint32_t>(length));
+        ALIGN16 uint32_t lows[BlockSize];
+        ALIGN16 uint32_t highs[BlockSize];
+        ALIGN16 uint32_t packed[BlockSize];
+        uint64_t values[BlockSize];
+        uint64_t prev = 0;
+        for (size_t i = 0; i < length; i += BlockSize) {
+            const size_t count = std::min<size_t>(length - i, BlockSize);
+            uint64_t reference = ~static_cast<uint64_t>(0);
+            for (size_t j = 0; j < count; ++j) {
+                values[j] = Delta ? in[i + j] - prev : in[i + j];
+                prev = in[i + j];
+                if (values[j] < reference)
+                    reference = values[j];
+            }
+            uint64_t accumulator = 0;
+            for (size_t j = 0; j < BlockSize; ++j) {
+                values[j] = j < count ? values[j] - reference : 0;
+                accumulator |= values[j];
+                lows[j] = static_cast<uint32_t>(values[j]);
+                highs[j] = static_cast<uint32_t>(values[j] >> 32);
+            }
+            const uint32_t bit = bits64(accumulator);
+            store(out, static_cast<uint32_t>(reference));
+            store(out + 1, static_cast<uint32_t>(reference >> 32));
+            store(out + 2, bit);
+            out += 3;
+            out = pack(lows, std::min<uint32_t>(bit, 32), packed, out);
+            if (bit > 32)
+                out = pack(highs, bit - 32, packed, out);
+        }
+        nvalue = out - initout;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t length,
+                                uint64_t *out, size_t &nvalue) {
+        if (length == 0) {
+            nvalue = 0;
+            return in;
+        }
+        const uint32_t count = load(in++);
+        if (count > nvalue)
+            throw NotEnoughStorage(count);
+        ALIGN16 uint32_t lows[BlockSize];
+        ALIGN16 uint32_t highs[BlockSize];
+        ALIGN16 uint32_t packed[BlockSize];
+        uint64_t prev = 0;
+        for (size_t i = 0; i < count; i += BlockSize) {
+            const size_t blockcount = std::min<size_t>(count - i, BlockSize);
+            const uint64_t reference = static_cast<uint64_t>(load(in + 1)) << 32 | load(in);
+            const uint32_t bit = load(in + 2);
+            in += 3;
+            in = unpack(in, std::min<uint32_t>(bit, 32), packed, lows);
+            if (bit > 32)
+                in = unpack(in, bit - 32, packed, highs);
+            else
+                memset(highs, 0, sizeof(highs));
+            for (size_t j = 0; j < blockcount; ++j) {
+                const uint64_t value = (static_cast<uint64_t>(highs[j]) << 32 | lows[j]) + reference;
+                prev = Delta ? prev + value : value;
+                out[i + j] = prev;
+            }
+        }
+        nvalue = count;
+        return in;
+    }
+
+    string name() const {
+        return Delta ? "FrameOfReference64+Delta" : "FrameOfReference64";
+    }
+
+private:
+    static uint32_t load(const uint32_t *in) {
+        uint32_t word;
+        memcpy(&word, in, sizeof(word));
+        return word;
+    }
+
+    static void store(uint32_t *out, uint32_t word) {
+        memcpy(out, &word, sizeof(word));
+    }
+
+    static uint32_t bits64(uint64_t v) {
+        return v == 0 ? 0 : 64 - __builtin_clzll(v);
+    }
+
+    static uint32_t *pack(const uint32_t *in, uint32_t bit, uint32_t *packed, uint32_t *out) {
+        if (bit == 0)
+            return out;
+        simdpackwithoutmask(in, reinterpret_cast<__m128i *>(packed), bit);
+        memcpy(out, packed, 4 * bit * sizeof(uint32_t));
+        return out + 4 * bit;
+    }
+
+    static const uint32_t *unpack(const uint32_t *in, uint32_t bit, uint32_t *packed, uint32_t *out) {
+        if (bit == 0) {
+            memset(out, 0, BlockSize * sizeof(uint32_t));
+            return in;
+        }
+        memcpy(packed, in, 4 * bit * sizeof(uint32_t));
+        simdunpack(reinterpret_cast<const __m128i *>(packed), out, bit);
+        return in + 4 * bit;
+    }
+};
+
+#endif /* CODECS64_H_ */
@@ -11,6 +11,56 @@
 #include "util.h"
 #include "codecs.h"
 
+/**
+ * Chains the cursor of the first codec of a CompositeCodec with one of the
+ * second codec, created over the words left once the first is exhausted.
+ */
+class CompositeCursor: public IntegerCursor {
+public:
+    CompositeCursor(unique_ptr<IntegerCursor> first, IntegerCODEC &codec2,
+                    const uint32_t *final, const size_t expected2) :
+        first(std::move(first)), second(), codec2(codec2), final(final),
+        expected2(expected2) {
+    }
+
+    size_t nextBlock(const uint32_t *&span) {
+        if (!second) {
+            const size_t length = first->nextBlock(span);
+            if (length > 0 or !startSecond())
+                return length;
+        }
+        return second->nextBlock(span);
+    }
+
+    size_t skipTo(uint32_t target, const uint32_t *&span) {
+        if (!second) {
+            const size_t length = first->skipTo(target, span);
+            if (length > 0 or !startSecond())
+                return length;
+        }
+        return second->skipTo(target, span);
+    }
+
+    const uint32_t *end() const {
+        return second ? second->end() : first->end();
+    }
+
+private:
+    unique_ptr<IntegerCursor> first;
+    unique_ptr<IntegerCursor> second;
+    IntegerCODEC &codec2;
+    const uint32_t *final;
+    const size_t expected2;
+
+    bool startSecond() {
+        const uint32_t *const in = first->end();
+        if (in >= final)
+            return false;
+        second = codec2.newCursor(in, final - in, expected2);
+        return true;
+    }
+};
+
 /**
  * This is a useful class for CODEC that only compress
  * data having length a multiple of some unit length.
@@ -58,6 +108,14 @@ public:
         assert(initin + length >= in2);
         return in2;
     }
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t expected) {
+        const size_t roundedlength = expected / Codec1::BlockSize
+                                     * Codec1::BlockSize;
+        return unique_ptr<IntegerCursor>(new CompositeCursor(
+                                             codec1.newCursor(in, length, roundedlength), codec2,
+                                             in + length, expected - roundedlength));
+    }
     string name() const {
         ostringstream convert;
         convert << codec1.name() << "+" << codec2.name();
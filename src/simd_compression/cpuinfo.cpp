@@ -0,0 +1,93 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cpuid.h>
+#include "cpuinfo.h"
+
+static cpufeatures detectcpufeatures() {
+    cpufeatures features;
+    memset(&features, 0, sizeof(features));
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return features;
+    features.sse2 = (edx & bit_SSE2) != 0;
+    features.ssse3 = (ecx & bit_SSSE3) != 0;
+    features.sse41 = (ecx & bit_SSE4_1) != 0;
+    features.sse42 = (ecx & bit_SSE4_2) != 0;
+    features.popcnt = (ecx & bit_POPCNT) != 0;
+
+    // the ymm registers are only usable if the operating system saves them
+    bool ymm = false;
+    if ((ecx & bit_OSXSAVE) != 0) {
+        uint32_t xcr0lo, xcr0hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+        ymm = (xcr0lo & 0x6) == 0x6;
+    }
+    features.avx = ymm && (ecx & bit_AVX) != 0;
+    if (features.avx && __get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        features.avx2 = (ebx & bit_AVX2) != 0;
+    }
+    return features;
+}
+
+const cpufeatures &getcpufeatures() {
+    static const cpufeatures features = detectcpufeatures();
+    return features;
+}
+
+static simdlevel detectsimdlevel() {
+    const cpufeatures &features = getcpufeatures();
+    simdlevel level = SIMD_SCALAR;
+    if (features.sse42 && features.popcnt)
+        level = SIMD_SSE42;
+    if (level == SIMD_SSE42 && features.avx2)
+        level = SIMD_AVX2;
+
+    const char *requested = getenv("HELLCAT_SIMD");
+    if (requested == NULL)
+        return level;
+    for (int cap = SIMD_SCALAR; cap <= SIMD_AVX2; ++cap) {
+        if (strcmp(requested, simdlevelname(static_cast<simdlevel>(cap))) == 0)
+            return cap < level ? static_cast<simdlevel>(cap) : level;
+    }
+    return level;
+}
+
+simdlevel getsimdlevel() {
+    static const simdlevel level = detectsimdlevel();
+    return level;
+}
+
+const char *simdlevelname(simdlevel level) {
+    switch (level) {
+    case SIMD_AVX2:
+        return "avx2";
+    case SIMD_SSE42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+bool cpusupportsbaseline() {
+    const cpufeatures &features = getcpufeatures();
+    return features.sse2 && features.ssse3 && features.sse41 && features.sse42 && features.popcnt;
+}
+
+string describecpu() {
+    const cpufeatures &features = getcpufeatures();
+    ostringstream convert;
+    convert << "cpu:";
+    if (features.sse2) convert << " sse2";
+    if (features.ssse3) convert << " ssse3";
+    if (features.sse41) convert << " sse4.1";
+    if (features.sse42) convert << " sse4.2";
+    if (features.popcnt) convert << " popcnt";
+    if (features.avx) convert << " avx";
+    if (features.avx2) convert << " avx2";
+    convert << ", kernels: " << simdlevelname(getsimdlevel());
+    return convert.str();
+}
@@ -0,0 +1,60 @@
+
+
+#ifndef CPUINFO_H_
+#define CPUINFO_H_
+
+#include "common.h"
+
+using namespace std;
+
+/**
+ * What the processor (and the operating system, for the AVX state) supports,
+ * read once with cpuid.
+ *
+ * The tree is built for SSE4.2 and POPCNT, anything wider is compiled into
+ * files of its own and only called after checking these.
+ */
+struct cpufeatures {
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool sse42;
+    bool popcnt;
+    bool avx;
+    bool avx2;
+};
+
+const cpufeatures &getcpufeatures();
+
+/**
+ * Kernel families come in one variant per level. The scalar ones run
+ * anywhere and are what the others are checked against.
+ */
+enum simdlevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE42 = 1,
+    SIMD_AVX2 = 2
+};
+
+/**
+ * The best level the processor supports, lowered to the value of the
+ * HELLCAT_SIMD environment variable (scalar, sse4.2 or avx2) when it is set,
+ * e.g. to compare variants on one host. Only picks between kernels that give
+ * the same results, the codecs available still follow the processor.
+ */
+simdlevel getsimdlevel();
+
+const char *simdlevelname(simdlevel level);
+
+/**
+ * False if the processor lacks what the tree is built for. Called first
+ * thing in main, there is no point going further.
+ */
+bool cpusupportsbaseline();
+
+/**
+ * One line for the log, e.g. "cpu: sse2 ssse3 sse4.1 sse4.2 popcnt avx avx2, kernels: avx2".
+ */
+string describecpu();
+
+#endif /* CPUINFO_H_ */
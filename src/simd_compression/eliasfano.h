@@ -0,0 +1,395 @@
+
+
+#ifndef ELIASFANO_H_
+#define ELIASFANO_H_
+
+#include "codecs.h"
+#include "simdbitpackinghelpers.h"
+#include "util.h"
+
+/**
+ * Partitioned Elias-Fano for sorted integers, with partitions of 128
+ * integers (uniform partitions, not the optimal ones of Ottaviano and
+ * Venturini). Every partition is coded relative to its first integer,
+ * base, and spans u = last - base. An integer v is split into l low bits,
+ * l = floor(log2(u / n)), and the high part h = (v - base) >> l: the low
+ * bits of the partition are bit packed with the SIMD packers, the high
+ * parts are written in unary, integer j setting bit h + j of the upper
+ * bits. That is about 2 + l bits per integer. Layout:
+ *
+ *   length
+ *   size of the data, in words
+ *   one header of 2 words per partition: base, (offset << 6) | l, the
+ *   offset being in words from the start of the data
+ *   CookiePadder up to a multiple of 4 words
+ *   per partition, 4 * l words of low bits then the upper bits, read 64
+ *   bits at a time
+ *
+ * The i-th integer is found without decoding anything else: its low bits
+ * are read out of the packed words and its high part is the position of
+ * the (i % 128)-th set bit of the upper bits minus i % 128, found with a
+ * broadword select. lowerBound and findAndAdvance pick the partition from
+ * the bases, then select the (h - 1)-th zero of the upper bits to reach
+ * the first integer with high part h in one step.
+ *
+ * Input must be sorted. No pointer needs to be aligned.
+ */
+class EliasFano: public IntegerCODEC, public RandomAccessCODEC {
+public:
+    static const uint32_t CookiePadder = 123456;// just some made up number
+    static const uint32_t PartitionSize = 128;
+    static const uint32_t BlockSize = 1;
+
+    void encodeArray(uint32_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        const size_t partitions = partitionCount(length);
+        const size_t headerwords = headerWords(partitions);
+        for (size_t i = 2 + 2 * partitions; i < headerwords; ++i)
+            store(out, i, CookiePadder);
+        uint32_t *const data = out + headerwords;
+        ALIGN16 uint32_t low[PartitionSize];
+        ALIGN16 uint32_t packed[PartitionSize];
+        uint64_t upper[3 * PartitionSize / 64 + 1];
+        uint32_t offset = 0;
+        for (size_t p = 0; p < partitions; ++p) {
+            const uint32_t *const partition = in + p * PartitionSize;
+            const size_t count = min(length - p * PartitionSize, static_cast<size_t>(PartitionSize));
+            const uint32_t base = partition[0];
+            const uint32_t l = lowBits(partition[count - 1] - base, count);
+            memset(low, 0, sizeof(low));
+            memset(upper, 0, sizeof(upper));
+            uint32_t bits = 0;
+            for (size_t j = 0; j < count; ++j) {
+                const uint32_t v = partition[j] - base;
+                low[j] = v;
+                bits = (v >> l) + static_cast<uint32_t>(j);
+                upper[bits / 64] |= uint64_t(1) << (bits % 64);
+            }
+            simdpack(low, reinterpret_cast<__m128i *>(packed), l);
+            memcpy(data + offset, packed, 4 * l * sizeof(uint32_t));
+            // one zero past the last set bit, so select0 of any high part
+            // up to the last one stays within the upper bits
+            const uint32_t upperwords = (bits + 1) / 32 + 1;
+            memcpy(data + offset + 4 * l, upper, upperwords * sizeof(uint32_t));
+            store(out, 2 + 2 * p, base);
+            store(out, 3 + 2 * p, (offset << 6) | l);
+            offset += 4 * l + upperwords;
+        }
+        store(out, 0, static_cast<uint32_t>(length));
+        store(out, 1, offset);
+        nvalue = headerwords + offset;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t /*length*/,
+                                uint32_t *out, size_t &nvalue) {
+        const size_t length = load(in, 0);
+        if (length > nvalue)
+            throw NotEnoughStorage(length);
+        const size_t partitions = partitionCount(length);
+        ALIGN16 uint32_t buffer[PartitionSize];
+        for (size_t p = 0; p < partitions; ++p) {
+            const size_t count = decodePartition(in, length, p, buffer);
+            memcpy(out + p * PartitionSize, buffer, count * sizeof(uint32_t));
+        }
+        nvalue = length;
+        return in + headerWords(partitions) + load(in, 1);
+    }
+
+    uint32_t select(const uint32_t *in, size_t index) {
+        const size_t p = index / PartitionSize;
+        const Partition partition(in, load(in, 0), p);
+        return partition.get(static_cast<uint32_t>(index % PartitionSize));
+    }
+
+    size_t lowerBound(const uint32_t *in, uint32_t key, uint32_t *presult) {
+        return findAndAdvance(in, key, 0, presult);
+    }
+
+    size_t findAndAdvance(const uint32_t *in, uint32_t key, size_t from, uint32_t *presult) {
+        const size_t length = load(in, 0);
+        if (from >= length)
+            return length;
+        const size_t partitions = partitionCount(length);
+        const size_t p = findPartition(in, partitions, from / PartitionSize, key);
+        const Partition partition(in, length, p);
+        const uint32_t start = p == from / PartitionSize ? from % PartitionSize : 0;
+        const uint32_t lower = partition.lowerBound(key);
+        const uint32_t j = max(lower, start);
+        if (j < partition.count) {
+            *presult = partition.get(j);
+            return p * PartitionSize + j;
+        }
+        if (p + 1 < partitions) {
+            // everything in p is below key and the next partition starts
+            // with its base
+            *presult = base(in, p + 1);
+            return (p + 1) * PartitionSize;
+        }
+        return length;
+    }
+
+    size_t encodedLength(const uint32_t *in) {
+        return load(in, 0);
+    }
+
+    /**
+     * Decodes one partition at a time, skipTo finds the partition from the
+     * bases without decoding the ones passed over.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        Cursor(const uint32_t *in, const size_t length) :
+            in(in), partitions(0), partition(0), length(0), final(in) {
+            if (length == 0)
+                return;
+            this->length = load(in, 0);
+            partitions = partitionCount(this->length);
+            final = in + headerWords(partitions) + load(in, 1);
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            if (partition == partitions)
+                return 0;
+            span = buffer;
+            return decodePartition(in, length, partition++, buffer);
+        }
+
+        size_t skipTo(uint32_t target, const uint32_t *&span) {
+            if (partition < partitions)
+                partition = findPartition(in, partitions, partition, target);
+            return nextBlock(span);
+        }
+
+        const uint32_t *end() const {
+            return final;
+        }
+
+    private:
+        const uint32_t *in;
+        size_t partitions;
+        size_t partition;
+        size_t length;
+        const uint32_t *final;
+        ALIGN16 uint32_t buffer[PartitionSize];
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
+    string name() const {
+        return "EliasFano128";
+    }
+
+private:
+    /**
+     * Where one partition lives in a stream, for the single integer
+     * lookups. The words are read in place with memcpy.
+     */
+    struct Partition {
+        const uint32_t *low;
+        const uint32_t *upper;
+        uint32_t base;
+        uint32_t l;
+        uint32_t count;
+        uint32_t upperwords;
+
+        Partition(const uint32_t *in, size_t length, size_t p) {
+            const size_t partitions = partitionCount(length);
+            const uint32_t *const data = in + headerWords(partitions);
+            const uint32_t header = load(in, 3 + 2 * p);
+            const uint32_t end = p + 1 < partitions ? load(in, 3 + 2 * (p + 1)) >> 6 : load(in, 1);
+            base = load(in, 2 + 2 * p);
+            l = header & 63;
+            low = data + (header >> 6);
+            upper = low + 4 * l;
+            upperwords = static_cast<uint32_t>(data + end - upper);
+            count = static_cast<uint32_t>(min(length - p * PartitionSize, static_cast<size_t>(PartitionSize)));
+        }
+
+        /**
+         * Bits 64 * i to 64 * i + 63 of the upper bits, the last word
+         * might only be half there.
+         */
+        uint64_t word(uint32_t i) const {
+            uint64_t w = 0;
+            memcpy(&w, upper + 2 * i, 2 * i + 1 < upperwords ? sizeof(w) : sizeof(uint32_t));
+            return w;
+        }
+
+        /**
+         * The low bits of integer j, out of the 4 interleaved lanes of the
+         * SIMD packers: lane j % 4 holds it at position j / 4.
+         */
+        uint32_t lowBits(uint32_t j) const {
+            if (l == 0)
+                return 0;
+            const uint32_t bit = (j / 4) * l;
+            const uint32_t w = (bit / 32) * 4 + j % 4;
+            uint64_t value = load(low, w) >> (bit % 32);
+            if (bit % 32 + l > 32)
+                value |= static_cast<uint64_t>(load(low, w + 4)) << (32 - bit % 32);
+            return static_cast<uint32_t>(value & ((uint64_t(1) << l) - 1));
+        }
+
+        /**
+         * Position in the upper bits of the rank-th set bit, or with
+         * zeros of the rank-th clear bit, -1 if there is none.
+         */
+        template <bool zeros>
+        int64_t selectBit(uint32_t rank) const {
+            for (uint32_t i = 0; 2 * i < upperwords; ++i) {
+                const uint64_t w = zeros ? ~word(i) : word(i);
+                const uint32_t ones = static_cast<uint32_t>(_mm_popcnt_u64(w));
+                if (rank < ones)
+                    return 64 * i + select64(w, rank);
+                rank -= ones;
+            }
+            return -1;
+        }
+
+        uint32_t get(uint32_t j) const {
+            const uint32_t high = static_cast<uint32_t>(selectBit<false>(j)) - j;
+            return base + ((high << l) | lowBits(j));
+        }
+
+        /**
+         * Index in the partition of the first integer >= key, count if
+         * there is none.
+         */
+        uint32_t lowerBound(uint32_t key) const {
+            if (key <= base)
+                return 0;
+            const uint64_t high = static_cast<uint64_t>(key - base) >> l;
+            // the integers before the high-th zero are those with a
+            // smaller high part
+            uint32_t j;
+            int64_t position;
+            if (high == 0) {
+                j = 0;
+                position = 0;
+            } else {
+                position = selectBit<true>(static_cast<uint32_t>(high - 1));
+                if (position < 0)
+                    return count;
+                j = static_cast<uint32_t>(position + 1 - high);
+                ++position;
+            }
+            // walk the integers with the same high part, a clear bit ends
+            // them and the integers after it are larger than key
+            for (; j < count; ++j, ++position) {
+                if (!((word(static_cast<uint32_t>(position / 64)) >> (position % 64)) & 1))
+                    return j;
+                if (base + ((static_cast<uint32_t>(high) << l) | lowBits(j)) >= key)
+                    return j;
+            }
+            return count;
+        }
+    };
+
+    static size_t partitionCount(size_t length) {
+        return (length + PartitionSize - 1) / PartitionSize;
+    }
+
+    static size_t headerWords(size_t partitions) {
+        return (2 + 2 * partitions + 3) / 4 * 4;
+    }
+
+    static uint32_t load(const uint32_t *in, size_t index) {
+        uint32_t word;
+        memcpy(&word, in + index, sizeof(word));
+        return word;
+    }
+
+    static void store(uint32_t *out, size_t index, uint32_t word) {
+        memcpy(out + index, &word, sizeof(word));
+    }
+
+    static uint32_t base(const uint32_t *in, size_t p) {
+        return load(in, 2 + 2 * p);
+    }
+
+    static uint32_t lowBits(uint32_t u, size_t count) {
+        return u > count ? gccbits(static_cast<uint32_t>(u / count)) - 1 : 0;
+    }
+
+    /**
+     * Position of the rank-th set bit of w (Vigna, "Broadword
+     * implementation of rank/select queries"): byte-wise popcounts summed
+     * by a multiplication locate the byte, then a few bits are cleared
+     * within it.
+     */
+    static uint32_t select64(uint64_t w, uint32_t rank) {
+        const uint64_t ones = 0x0101010101010101ULL;
+        uint64_t sums = w - ((w >> 1) & 0x5555555555555555ULL);
+        sums = (sums & 0x3333333333333333ULL) + ((sums >> 2) & 0x3333333333333333ULL);
+        sums = ((sums + (sums >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * ones;
+        const uint64_t below = ((rank * ones | 0x8080808080808080ULL) - sums) & 0x8080808080808080ULL;
+        const uint32_t place = static_cast<uint32_t>(_mm_popcnt_u64(below)) * 8;
+        uint32_t left = rank - static_cast<uint32_t>(((sums << 8) >> place) & 0xFF);
+        uint64_t byte = (w >> place) & 0xFF;
+        for (; left > 0; --left)
+            byte &= byte - 1;
+        return place + __builtin_ctzll(byte);
+    }
+
+    /**
+     * The last partition at or after p whose base is below key, the first
+     * integer >= key is in it or starts the next one. Gallops from p.
+     */
+    static size_t findPartition(const uint32_t *in, size_t partitions, size_t p, uint32_t key) {
+        if (p + 1 < partitions and base(in, p + 1) < key) {
+            size_t lower = p + 1;
+            size_t step = 1;
+            while (lower + step < partitions and base(in, lower + step) < key) {
+                lower += step;
+                step *= 2;
+            }
+            size_t upper = min(lower + step, partitions);
+            while (lower + 1 < upper) {
+                const size_t mid = (lower + upper) / 2;
+                if (base(in, mid) < key)
+                    lower = mid;
+                else
+                    upper = mid;
+            }
+            p = lower;
+        }
+        return p;
+    }
+
+    /**
+     * Decodes partition p into out, which must be aligned and have room
+     * for 128 integers. The low bits are unpacked with the SIMD packers,
+     * the high parts are read off the set bits and the two are put
+     * together 4 at a time.
+     */
+    static size_t decodePartition(const uint32_t *in, size_t length, size_t p, uint32_t *out) {
+        const Partition partition(in, length, p);
+        ALIGN16 uint32_t packed[PartitionSize];
+        ALIGN16 uint32_t high[PartitionSize];
+        memcpy(packed, partition.low, 4 * partition.l * sizeof(uint32_t));
+        simdunpack(reinterpret_cast<const __m128i *>(packed), out, partition.l);
+        memset(high, 0, sizeof(high));
+        uint32_t j = 0;
+        for (uint32_t i = 0; 2 * i < partition.upperwords and j < partition.count; ++i) {
+            uint64_t w = partition.word(i);
+            while (w != 0 and j < partition.count) {
+                high[j] = 64 * i + __builtin_ctzll(w) - j;
+                ++j;
+                w &= w - 1;
+            }
+        }
+        const __m128i base = _mm_set1_epi32(static_cast<int>(partition.base));
+        const __m128i shift = _mm_cvtsi32_si128(static_cast<int>(partition.l));
+        for (uint32_t k = 0; k < PartitionSize; k += 4) {
+            const __m128i h = _mm_sll_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(high + k)), shift);
+            const __m128i v = _mm_or_si128(h, _mm_load_si128(reinterpret_cast<const __m128i *>(out + k)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(out + k), _mm_add_epi32(v, base));
+        }
+        return partition.count;
+    }
+};
+
+#endif /* ELIASFANO_H_ */
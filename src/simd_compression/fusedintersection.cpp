@@ -0,0 +1,46 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include "fusedintersection.h"
+#include "intersection.h"
+
+size_t fusedintersection(const uint32_t *compressed, const size_t compressedlength,
+                         const uint32_t *set, const size_t length, uint32_t *out) {
+    SIMDBinaryPackingBlockReader<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true> > reader(compressed, compressedlength);
+    const uint32_t *const initout(out);
+    const uint32_t *const final = set + length;
+    while (set < final) {
+        const size_t blocklength = reader.nextBlock();
+        if (blocklength == 0) break;
+        const uint32_t *block = reader.block();
+        const uint32_t last = block[blocklength - 1];
+        if (last < *set) continue;
+        // the part of set this block can match, everything after it is
+        // left for the following blocks
+        const uint32_t *upper = std::upper_bound(set, final, last);
+        out += SIMDintersection(set, upper - set, block, blocklength, out);
+        set = upper;
+    }
+    return out - initout;
+}
+
+size_t fusedintersectioncardinality(const uint32_t *compressed, const size_t compressedlength,
+                                    const uint32_t *set, const size_t length) {
+    SIMDBinaryPackingBlockReader<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true> > reader(compressed, compressedlength);
+    const uint32_t *const final = set + length;
+    size_t count = 0;
+    while (set < final) {
+        const size_t blocklength = reader.nextBlock();
+        if (blocklength == 0) break;
+        const uint32_t *block = reader.block();
+        const uint32_t last = block[blocklength - 1];
+        if (last < *set) continue;
+        const uint32_t *upper = std::upper_bound(set, final, last);
+        count += SIMDintersectionCardinality(set, upper - set, block, blocklength);
+        set = upper;
+    }
+    return count;
+}
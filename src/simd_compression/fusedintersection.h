@@ -0,0 +1,87 @@
+
+
+#ifndef FUSEDINTERSECTION_H_
+#define FUSEDINTERSECTION_H_
+
+#include "common.h"
+#include "util.h"
+#include "simdbinarypacking.h"
+#include "variablebyte.h"
+
+using namespace std;
+
+/**
+ * Walks a stream written by
+ * CompositeCodec<SIMDBinaryPacking<BlockPacker>, VariableByte<true> >
+ * one block of at most 128 integers at a time, like the cursor
+ * CompositeCodec::newCursor returns but without allocating. Only the
+ * current block is ever decoded, into a buffer small enough to stay in
+ * L1, so a list is never expanded in full and the input does not need to
+ * be aligned.
+ *
+ * With an integrated (delta) BlockPacker blocks cannot be skipped without
+ * decoding them since each one starts from the last value of the previous.
+ */
+template<class BlockPacker>
+class SIMDBinaryPackingBlockReader {
+public:
+    SIMDBinaryPackingBlockReader(const uint32_t *compressed, const size_t length) :
+        blocks(compressed, length), tail(), final(compressed + length),
+        intail(false), span(NULL) {
+    }
+
+    /**
+     * Decodes the next block and returns its size, 0 once the stream is
+     * exhausted.
+     */
+    size_t nextBlock() {
+        if (!intail) {
+            const size_t length = blocks.nextBlock(span);
+            if (length > 0)
+                return length;
+            // fewer than 128 integers are left in the variable byte tail,
+            // it is encoded on its own starting from zero
+            intail = true;
+            if (blocks.end() < final)
+                tail.reset(blocks.end(), final - blocks.end());
+        }
+        return tail.nextBlock(span);
+    }
+
+    const uint32_t *block() const {
+        return span;
+    }
+
+private:
+    typename SIMDBinaryPacking<BlockPacker>::Cursor blocks;
+    VariableByte<true>::Cursor tail;
+    const uint32_t *final;
+    bool intail;
+    const uint32_t *span;
+};
+
+/*
+ * Intersects the sorted array set with a compressed sorted array written
+ * by the "s4-bp128-1" codec, i.e.
+ * CompositeCodec<SIMDBinaryPacking<SIMDIntegratedBlockPacker<RegularDeltaSIMD, true> >, VariableByte<true> >.
+ * Returns the cardinality of the intersection.
+ *
+ * The compressed array is decoded one 128-integer block at a time and each
+ * block is intersected with SIMDintersection against the part of set it
+ * covers, so no scratch space proportional to the compressed array is
+ * needed. Blocks entirely below the current position in set are decoded
+ * (the deltas require it) but not intersected, and decoding stops as soon
+ * as set is exhausted. out must have room for length integers and must
+ * not overlap set.
+ */
+size_t fusedintersection(const uint32_t *compressed, const size_t compressedlength,
+                         const uint32_t *set, const size_t length, uint32_t *out);
+
+/*
+ * Same as fusedintersection but only returns the cardinality, nothing is
+ * written out.
+ */
+size_t fusedintersectioncardinality(const uint32_t *compressed, const size_t compressedlength,
+                                    const uint32_t *set, const size_t length);
+
+#endif /* FUSEDINTERSECTION_H_ */
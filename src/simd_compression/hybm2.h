@@ -13,7 +13,7 @@
 #include "common.h"
 #include "codecs.h"
 #include "codecfactory.h"
-#include "boolarray.h"
+#include "roaringbitmap.h"
 #include "intersection.h"
 #include "skipping.h"
 
@@ -93,7 +93,7 @@ public:
             return 0;
         }
         vector<pair<uint32_t, shared_ptr<vector<uint32_t>>>> shortlists;
-        vector<pair<uint32_t, shared_ptr<BoolArray>>> bitmaps;
+        vector<pair<uint32_t, shared_ptr<RoaringBitmap>>> bitmaps;
         //vector<uint32_t> bitmapscard;
 
         for (uint32_t id : ids) {
@@ -112,7 +112,7 @@ public:
                 return unpackVolume;
             }
 
-            BoolArray answer(mMaxId);
+            RoaringBitmap answer;
             bitmaps[0].second->intersect(*bitmaps[1].second, answer);
             unpackVolume += bitmaps[0].first + bitmaps[1].first;
             for (uint32_t i = 2; i < bitmaps.size(); ++i) {
@@ -140,7 +140,7 @@ public:
             size_t pos = 0;
             for (uint32_t i = 0; (sizeout > 0) && (i < bitmaps.size()); ++i) {
                 unpackVolume += bitmaps[i].first;
-                shared_ptr<BoolArray> &ba = bitmaps[i].second;
+                shared_ptr<RoaringBitmap> &ba = bitmaps[i].second;
                 pos = 0;
                 for (uint32_t i = 0; i < sizeout; ++i) {
                     if (!ba->get(out[i]))
@@ -180,7 +180,9 @@ private:
         size_t outlength = compressedbuffer->size();
         vector<uint32_t> tmp(data, data + length); // use the buffer because some codecs modify the input
         codec.encodeArray(tmp.data(), length, compressedbuffer->data(), outlength);
-        if (outlength * sizeof(uint32_t) < BoolArray::sizeInBytes(mMaxId)) { // we are good
+        RoaringBitmap bitmap(RoaringBitmap::fromSorted(data, length));
+        bitmap.runOptimize();
+        if (outlength * sizeof(uint32_t) < bitmap.sizeInBytes()) { // we are good
             if (recovbuffer.size() < length) recovbuffer.resize(length);
             compressedbuffer->resize(outlength);
             compressedbuffer->shrink_to_fit();
@@ -200,10 +202,9 @@ private:
      */
     size_t loadAsBitmap(const uint32_t postid, const uint32_t *data, const uint32_t length) {
         if (bitmapmap.find(postid) != bitmapmap.end()) return 0;
-        BoolArray *ba = new BoolArray(mMaxId);
-        for (uint32_t k = 0; k < length; ++k)
-            ba->set(data[k]);
-        bitmapmap[postid] = shared_ptr<BoolArray>(ba);
+        RoaringBitmap *ba = new RoaringBitmap(RoaringBitmap::fromSorted(data, length));
+        ba->runOptimize();
+        bitmapmap[postid] = shared_ptr<RoaringBitmap>(ba);
         mapuncompsizes[postid] = length;
         return ba->sizeInBytes() / sizeof(uint32_t);
     }
@@ -229,7 +230,7 @@ private:
         return compressedbuffer->size();
     }
 
-    map<uint32_t, shared_ptr<BoolArray>> bitmapmap;
+    map<uint32_t, shared_ptr<RoaringBitmap>> bitmapmap;
     map<uint32_t, shared_ptr<vector<uint32_t>>> shortlistmap;
     map<uint32_t, uint32_t> mapuncompsizes;
 
@@ -321,7 +322,7 @@ public:
             return 0;
         }
         vector<pair<uint32_t, shared_ptr<vector<uint32_t>>>> shortlists;
-        vector<pair<uint32_t, shared_ptr<BoolArray>>> bitmaps;
+        vector<pair<uint32_t, shared_ptr<RoaringBitmap>>> bitmaps;
         //vector<uint32_t> bitmapscard;
 
         for (uint32_t id : ids) {
@@ -340,7 +341,7 @@ public:
                 return unpackVolume;
             }
 
-            BoolArray answer(mMaxId);
+            RoaringBitmap answer;
             bitmaps[0].second->intersect(*bitmaps[1].second, answer);
             unpackVolume += bitmaps[0].first + bitmaps[1].first;
             for (uint32_t i = 2; i < bitmaps.size(); ++i) {
@@ -367,7 +368,7 @@ public:
             size_t pos = 0;
             for (uint32_t i = 0; (sizeout > 0) && (i < bitmaps.size()); ++i) {
                 unpackVolume += bitmaps[i].first;
-                shared_ptr<BoolArray> &ba = bitmaps[i].second;
+                shared_ptr<RoaringBitmap> &ba = bitmaps[i].second;
                 pos = 0;
                 for (uint32_t i = 0; i < sizeout; ++i) {
                     if (!ba->get(out[i]))
@@ -406,10 +407,9 @@ private:
      */
     size_t loadAsBitmap(const uint32_t postid, const uint32_t *data, const uint32_t length) {
         if (bitmapmap.find(postid) != bitmapmap.end()) return 0;
-        BoolArray *ba = new BoolArray(mMaxId);
-        for (uint32_t k = 0; k < length; ++k)
-            ba->set(data[k]);
-        bitmapmap[postid] = shared_ptr<BoolArray>(ba);
+        RoaringBitmap *ba = new RoaringBitmap(RoaringBitmap::fromSorted(data, length));
+        ba->runOptimize();
+        bitmapmap[postid] = shared_ptr<RoaringBitmap>(ba);
         mapuncompsizes[postid] = length;
         return ba->sizeInBytes() / sizeof(uint32_t);
     }
@@ -428,7 +428,7 @@ private:
         return compressedbuffer->size();
     }
 
-    map<uint32_t, shared_ptr<BoolArray>> bitmapmap;
+    map<uint32_t, shared_ptr<RoaringBitmap>> bitmapmap;
     map<uint32_t, shared_ptr<vector<uint32_t>>> shortlistmap;
     map<uint32_t, uint32_t> mapuncompsizes;
 
@@ -520,7 +520,7 @@ public:
             return 0;
         }
         vector<pair<uint32_t, shared_ptr<Skipping>>> shortlists;
-        vector<pair<uint32_t, shared_ptr<BoolArray>>> bitmaps;
+        vector<pair<uint32_t, shared_ptr<RoaringBitmap>>> bitmaps;
         for (uint32_t id : ids) {
             if (shortlistmap.find(id) != shortlistmap.end())
                 shortlists.push_back(make_pair(mapuncompsizes[id], shortlistmap[id]));
@@ -537,7 +537,7 @@ public:
                 return unpackVolume;
             }
 
-            BoolArray answer(mMaxId);
+            RoaringBitmap answer;
             bitmaps[0].second->intersect(*bitmaps[1].second, answer);
             unpackVolume += bitmaps[0].first + bitmaps[1].first;
             for (uint32_t i = 2; i < bitmaps.size(); ++i) {
@@ -564,7 +564,7 @@ public:
             size_t pos = 0;
             for (uint32_t i = 0; (sizeout > 0) && (i < bitmaps.size()); ++i) {
                 unpackVolume += bitmaps[i].first;
-                shared_ptr<BoolArray> &ba = bitmaps[i].second;
+                shared_ptr<RoaringBitmap> &ba = bitmaps[i].second;
                 pos = 0;
                 for (uint32_t i = 0; i < sizeout; ++i) {
                     if (!ba->get(out[i]))
@@ -603,10 +603,9 @@ private:
      */
     size_t loadAsBitmap(const uint32_t postid, const uint32_t *data, const uint32_t length) {
         if (bitmapmap.find(postid) != bitmapmap.end()) return 0;
-        BoolArray *ba = new BoolArray(mMaxId);
-        for (uint32_t k = 0; k < length; ++k)
-            ba->set(data[k]);
-        bitmapmap[postid] = shared_ptr<BoolArray>(ba);
+        RoaringBitmap *ba = new RoaringBitmap(RoaringBitmap::fromSorted(data, length));
+        ba->runOptimize();
+        bitmapmap[postid] = shared_ptr<RoaringBitmap>(ba);
         mapuncompsizes[postid] = length;
         return ba->sizeInBytes() / sizeof(uint32_t);
     }
@@ -625,7 +624,7 @@ private:
         return compressedbuffer->storageInBytes() / sizeof(uint32_t);
     }
 
-    map<uint32_t, shared_ptr<BoolArray>> bitmapmap;
+    map<uint32_t, shared_ptr<RoaringBitmap>> bitmapmap;
     map<uint32_t, shared_ptr<Skipping>> shortlistmap;
     map<uint32_t, uint32_t> mapuncompsizes;
 
@@ -5,6 +5,7 @@
  */
 
 #include "intersection.h"
+#include "cpuinfo.h"
 
 
 /**
@@ -573,7 +574,7 @@ FINISH_SCALAR: return (out - initout) + scalar(freq,
 /**
  * Our main heuristic.
  */
-size_t SIMDintersection(const uint32_t *set1,
+size_t SSEintersection(const uint32_t *set1,
                         const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out) {
     if ((length1 == 0) or (length2 == 0)) return 0;
 
@@ -598,14 +599,172 @@ size_t SIMDintersection(const uint32_t *set1,
         return v1(set2, length2, set1, length1, out);
 }
 
+/**
+ * Same heuristic with the scalar schemes only.
+ */
+size_t scalarintersection(const uint32_t *set1,
+                          const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out) {
+    if ((50 * length1 <= length2) or (50 * length2 <= length1))
+        return onesidedgallopingintersection(set1, length1, set2, length2, out);
+    return scalar(set1, length1, set2, length2, out);
+}
+
+/**
+ * Counting version of onesidedgallopingintersection.
+ */
+size_t gallopingintersectioncardinality(const uint32_t *smallset,
+        const size_t smalllength, const uint32_t *largeset,
+        const size_t largelength) {
+    size_t count = 0, k1 = 0;
+    for (size_t k2 = 0; k2 < smalllength; ++k2) {
+        if (largeset[k1] < smallset[k2]) {
+            k1 = __frogadvanceUntil(largeset, k1, largelength, smallset[k2]);
+            if (k1 == largelength)
+                break;
+        }
+        if (largeset[k1] == smallset[k2])
+            ++count;
+    }
+    return count;
+}
+
+/**
+ * Compares four integers of each set against each other (the second set
+ * rotated three times) and only counts the matches, so no shuffle is
+ * needed to compact them.
+ */
+static size_t blockintersectioncardinality(const uint32_t *A, const size_t lenA,
+        const uint32_t *B, const size_t lenB) {
+    size_t count = 0, i = 0, j = 0;
+    const size_t stA = lenA / 4 * 4, stB = lenB / 4 * 4;
+    while (i < stA && j < stB) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(A + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(B + j));
+        const __m128i m0 = _mm_cmpeq_epi32(a, b);
+        const __m128i m1 = _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)));
+        const __m128i m2 = _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)));
+        const __m128i m3 = _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)));
+        const __m128i m = _mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3));
+        count += _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(m)));
+        const uint32_t amax = A[i + 3];
+        const uint32_t bmax = B[j + 3];
+        if (amax <= bmax)
+            i += 4;
+        if (bmax <= amax)
+            j += 4;
+    }
+    return count + mergeintersectioncardinality(A + i, lenA - i, B + j, lenB - j);
+}
+
+size_t mergeintersectioncardinality(const uint32_t *A, const size_t lenA,
+                                    const uint32_t *B, const size_t lenB) {
+    size_t count = 0, i = 0, j = 0;
+    while (i < lenA && j < lenB) {
+        if (A[i] < B[j]) {
+            ++i;
+        } else if (A[i] > B[j]) {
+            ++j;
+        } else {
+            ++count;
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
+
+size_t SSEintersectionCardinality(const uint32_t *set1,
+                                  const size_t length1, const uint32_t *set2, const size_t length2) {
+    if ((length1 == 0) or (length2 == 0)) return 0;
+
+    if ((50 * length1 <= length2) or (50 * length2 <= length1)) {
+        if (length1 <= length2)
+            return gallopingintersectioncardinality(set1, length1, set2, length2);
+        else
+            return gallopingintersectioncardinality(set2, length2, set1, length1);
+    }
+    return blockintersectioncardinality(set1, length1, set2, length2);
+}
+
+size_t scalarintersectionCardinality(const uint32_t *set1,
+                                     const size_t length1, const uint32_t *set2, const size_t length2) {
+    if ((length1 == 0) or (length2 == 0)) return 0;
+
+    if ((50 * length1 <= length2) or (50 * length2 <= length1)) {
+        if (length1 <= length2)
+            return gallopingintersectioncardinality(set1, length1, set2, length2);
+        else
+            return gallopingintersectioncardinality(set2, length2, set1, length1);
+    }
+    return mergeintersectioncardinality(set1, length1, set2, length2);
+}
+
+/**
+ * The variants of one level, picked once, on first use.
+ */
+struct intersectionvariant {
+    simdlevel level;
+    intersectionfunction intersect;
+    intersectioncardinalityfunction count;
+};
+
+static intersectionvariant selectintersection() {
+    intersectionvariant variant;
+    variant.level = getsimdlevel();
+    switch (variant.level) {
+    case SIMD_AVX2:
+        variant.intersect = AVX2intersection;
+        variant.count = AVX2intersectionCardinality;
+        break;
+    case SIMD_SSE42:
+        variant.intersect = SSEintersection;
+        variant.count = SSEintersectionCardinality;
+        break;
+    default:
+        variant.intersect = scalarintersection;
+        variant.count = scalarintersectionCardinality;
+        break;
+    }
+    return variant;
+}
+
+static const intersectionvariant &selectedintersection() {
+    static const intersectionvariant variant = selectintersection();
+    return variant;
+}
+
+size_t SIMDintersection(const uint32_t *set1,
+                        const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out) {
+    return selectedintersection().intersect(set1, length1, set2, length2, out);
+}
+
+size_t SIMDintersectionCardinality(const uint32_t *set1,
+                                   const size_t length1, const uint32_t *set2, const size_t length2) {
+    return selectedintersection().count(set1, length1, set2, length2);
+}
+
+string IntersectionFactory::selected() {
+    return simdlevelname(selectedintersection().level);
+}
+
 inline std::map<std::string, intersectionfunction> initializeintersectionfactory() {
     std::map<std::string, intersectionfunction> schemes;
+    // "simd" is whichever of "scalar-mix", "sse" and "avx2" the processor
+    // best supports
     schemes[ "simd" ] = SIMDintersection;
     schemes[ "galloping" ] = onesidedgallopingintersection;
     schemes[ "scalar" ] = scalar;
+    schemes[ "scalar-mix" ] = scalarintersection;
+    schemes[ "sse" ] = SSEintersection;
     schemes[ "v1" ] = v1;
     schemes["v3"] = v3;
     schemes["simdgalloping"] = SIMDgalloping;
+    if (getcpufeatures().avx2) {
+        schemes["avx2"] = AVX2intersection;
+        schemes["avx2-v1"] = AVX2v1;
+        schemes["avx2-v3"] = AVX2v3;
+        schemes["avx2-galloping"] = AVX2galloping;
+    }
 
     return schemes;
 }
@@ -13,18 +13,83 @@ using namespace std;
 typedef size_t (*intersectionfunction)(const uint32_t *set1,
                                        const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
 
+typedef size_t (*intersectioncardinalityfunction)(const uint32_t *set1,
+        const size_t length1, const uint32_t *set2, const size_t length2);
+
 
 /*
  * Given two arrays, this writes the intersection to out. Returns the
  * cardinality of the intersection.
  *
- * This is a mix of very fast vectorized intersection algorithms, several
- * designed by N. Kurz, with adaptations by D. Lemire.
+ * Calls the AVX2, SSE or scalar variant below, the best one the processor
+ * supports (see cpuinfo.h). The choice is made once, on the first call.
  */
 size_t SIMDintersection(const uint32_t *set1,
                         const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
 
 
+/*
+ * Given two arrays, returns the cardinality of their intersection without
+ * writing it out. Gallops through the larger array when the sizes are far
+ * apart, otherwise compares blocks of integers. Dispatched like
+ * SIMDintersection.
+ */
+size_t SIMDintersectionCardinality(const uint32_t *set1,
+                                   const size_t length1, const uint32_t *set2, const size_t length2);
+
+
+/*
+ * This is a mix of very fast vectorized intersection algorithms, several
+ * designed by N. Kurz, with adaptations by D. Lemire: SIMDgalloping when the
+ * sizes differ by 1000 times or more, v3 when they differ by 50 times, v1
+ * otherwise.
+ */
+size_t SSEintersection(const uint32_t *set1,
+                       const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
+
+size_t SSEintersectionCardinality(const uint32_t *set1,
+                                  const size_t length1, const uint32_t *set2, const size_t length2);
+
+/*
+ * The same heuristic with 256-bit vectors, in intersectionavx2.cpp, which
+ * is the only file built with -mavx2. Only call these when the processor
+ * has AVX2.
+ */
+size_t AVX2intersection(const uint32_t *set1,
+                        const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
+
+size_t AVX2intersectionCardinality(const uint32_t *set1,
+                                   const size_t length1, const uint32_t *set2, const size_t length2);
+
+size_t AVX2v1(const uint32_t *rare, const size_t lenRare,
+              const uint32_t *freq, const size_t lenFreq, uint32_t *out);
+size_t AVX2v3(const uint32_t *rare, const size_t lenRare,
+              const uint32_t *freq, const size_t lenFreq, uint32_t *out);
+size_t AVX2galloping(const uint32_t *rare, const size_t lenRare,
+                     const uint32_t *freq, const size_t lenFreq, uint32_t *out);
+
+/*
+ * Portable fallback: onesidedgallopingintersection when the sizes differ by
+ * 50 times or more, the merge of scalar otherwise.
+ */
+size_t scalarintersection(const uint32_t *set1,
+                          const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
+
+size_t scalarintersectionCardinality(const uint32_t *set1,
+                                     const size_t length1, const uint32_t *set2, const size_t length2);
+
+/*
+ * Cardinality building blocks shared by the variants, smallset being the
+ * smaller array.
+ */
+size_t gallopingintersectioncardinality(const uint32_t *smallset,
+                                        const size_t smalllength, const uint32_t *largeset,
+                                        const size_t largelength);
+
+size_t mergeintersectioncardinality(const uint32_t *A, const size_t lenA,
+                                    const uint32_t *B, const size_t lenB);
+
+
 /*
  * Given two arrays, this writes the intersection to out. Returns the
  * cardinality of the intersection.
@@ -35,6 +100,13 @@ size_t SIMDintersection(const uint32_t *set1,
 size_t nate_scalar(const uint32_t *set1, const size_t length1,
                    const uint32_t *set2, const size_t length2, uint32_t *out);
 
+/*
+ * Fast scalar merge designed by N. Kurz, also used by the vectorized
+ * schemes to finish their tails.
+ */
+size_t scalar(const uint32_t *A, const size_t lenA,
+              const uint32_t *B, const size_t lenB, uint32_t *out);
+
 /*
  * Given two arrays, this writes the intersection to out. Returns the
  * cardinality of the intersection.
@@ -75,6 +147,11 @@ public:
         return (intersection_schemes.find(name) != intersection_schemes.end()) ;
     }
 
+    /**
+     * Level of the variant behind SIMDintersection, for the log.
+     */
+    static string selected();
+
     static intersectionfunction  getFromName(string name) {
         if (intersection_schemes.find(name) == intersection_schemes.end()) {
             cerr << "name " << name << " does not refer to an intersection procedure." << endl;
@@ -0,0 +1,89 @@
+
+
+#include "intersection64.h"
+
+size_t scalarintersection64(const uint64_t *A, const size_t lenA,
+                            const uint64_t *B, const size_t lenB, uint64_t *out) {
+    const uint64_t *const initout = out;
+    const uint64_t *const endA = A + lenA;
+    const uint64_t *const endB = B + lenB;
+    while (A < endA and B < endB) {
+        if (*A < *B) {
+            ++A;
+        } else if (*B < *A) {
+            ++B;
+        } else {
+            *out++ = *A;
+            ++A;
+            ++B;
+        }
+    }
+    return out - initout;
+}
+
+size_t SSEintersection64(const uint64_t *A, const size_t lenA,
+                         const uint64_t *B, const size_t lenB, uint64_t *out) {
+    const uint64_t *const initout = out;
+    size_t i = 0;
+    size_t j = 0;
+    if (lenA >= 2 and lenB >= 2) {
+        while (i + 2 <= lenA and j + 2 <= lenB) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(A + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(B + j));
+            // b with its two integers swapped, so each integer of a meets both
+            const __m128i bswapped = _mm_shuffle_epi32(b, 0x4E);
+            const __m128i match = _mm_or_si128(_mm_cmpeq_epi64(a, b), _mm_cmpeq_epi64(a, bswapped));
+            const int mask = _mm_movemask_pd(_mm_castsi128_pd(match));
+            if (mask & 1)
+                *out++ = A[i];
+            if (mask & 2)
+                *out++ = A[i + 1];
+            const uint64_t maxA = A[i + 1];
+            const uint64_t maxB = B[j + 1];
+            if (maxA <= maxB)
+                i += 2;
+            if (maxB <= maxA)
+                j += 2;
+        }
+    }
+    // the last block compared may hold integers that match further on
+    out += scalarintersection64(A + i, lenA - i, B + j, lenB - j, out);
+    return out - initout;
+}
+
+size_t gallopingintersection64(const uint64_t *smallset,
+                               const size_t smalllength, const uint64_t *largeset,
+                               const size_t largelength, uint64_t *out) {
+    const uint64_t *const initout = out;
+    size_t pos = 0;
+    for (size_t k = 0; k < smalllength and pos < largelength; ++k) {
+        const uint64_t target = smallset[k];
+        if (largeset[pos] < target) {
+            size_t step = 1;
+            size_t upper = pos + step;
+            while (upper < largelength and largeset[upper] < target) {
+                pos = upper;
+                step *= 2;
+                upper = pos + step;
+            }
+            if (upper > largelength)
+                upper = largelength;
+            pos = std::lower_bound(largeset + pos + 1, largeset + upper, target) - largeset;
+            if (pos == largelength)
+                break;
+        }
+        if (largeset[pos] == target)
+            *out++ = target;
+    }
+    return out - initout;
+}
+
+size_t SIMDintersection64(const uint64_t *set1,
+                          const size_t length1, const uint64_t *set2, const size_t length2, uint64_t *out) {
+    if ((length1 == 0) or (length2 == 0)) return 0;
+    if (length1 * 50 < length2)
+        return gallopingintersection64(set1, length1, set2, length2, out);
+    if (length2 * 50 < length1)
+        return gallopingintersection64(set2, length2, set1, length1, out);
+    return SSEintersection64(set1, length1, set2, length2, out);
+}
@@ -0,0 +1,42 @@
+
+
+#ifndef INTERSECTION64_H_
+#define INTERSECTION64_H_
+
+#include "common.h"
+
+using namespace std;
+/*
+ * Given two sorted arrays of 64-bit integers, this writes the intersection
+ * to out. Returns the cardinality of the intersection.
+ */
+typedef size_t (*intersectionfunction64)(const uint64_t *set1,
+        const size_t length1, const uint64_t *set2, const size_t length2, uint64_t *out);
+
+/*
+ * Gallops through the larger array when the sizes differ by 50 times or
+ * more, otherwise compares blocks of 2 integers against blocks of 2 with
+ * SSE4.1 (_mm_cmpeq_epi64), which holds half as many integers per vector
+ * as the 32-bit intersections. Ids that fit in 32 bits are better
+ * intersected as such, SIMDintersection compares 4 or 8 at a time.
+ */
+size_t SIMDintersection64(const uint64_t *set1,
+                          const size_t length1, const uint64_t *set2, const size_t length2, uint64_t *out);
+
+/*
+ * The SSE block comparison alone, and the scalar merge that finishes it.
+ */
+size_t SSEintersection64(const uint64_t *A, const size_t lenA,
+                         const uint64_t *B, const size_t lenB, uint64_t *out);
+
+size_t scalarintersection64(const uint64_t *A, const size_t lenA,
+                            const uint64_t *B, const size_t lenB, uint64_t *out);
+
+/*
+ * Exponential search of every integer of smallset in largeset.
+ */
+size_t gallopingintersection64(const uint64_t *smallset,
+                               const size_t smalllength, const uint64_t *largeset,
+                               const size_t largelength, uint64_t *out);
+
+#endif /* INTERSECTION64_H_ */
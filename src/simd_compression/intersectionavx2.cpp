@@ -0,0 +1,245 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+/**
+ * 256-bit versions of v1, v3 and SIMDgalloping from intersection.cpp. The
+ * algorithms are the same, with twice as many integers per comparison:
+ * blocks of 32 vectors are 256 integers instead of 128.
+ *
+ * This file is built with -mavx2, nothing in it may be called without
+ * checking for AVX2 first (see cpuinfo.h).
+ */
+#include "intersection.h"
+
+typedef __m256i vec;
+static const uint32_t veclen = sizeof(vec) / sizeof(uint32_t);
+static const size_t vecmax = veclen - 1;
+
+/**
+ * Whether match is among the 8 vectors at freq.
+ */
+__attribute__((always_inline))
+static inline bool contains8(const uint32_t *freq, const vec match) {
+    const vec *pfreq = reinterpret_cast<const vec *>(freq);
+    const vec Q0 = _mm256_or_si256(
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 0), match),
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 1), match));
+    const vec Q1 = _mm256_or_si256(
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 2), match),
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 3), match));
+    const vec Q2 = _mm256_or_si256(
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 4), match),
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 5), match));
+    const vec Q3 = _mm256_or_si256(
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 6), match),
+                       _mm256_cmpeq_epi32(_mm256_loadu_si256(pfreq + 7), match));
+    const vec F0 = _mm256_or_si256(_mm256_or_si256(Q0, Q1), _mm256_or_si256(Q2, Q3));
+    return !_mm256_testz_si256(F0, F0);
+}
+
+/**
+ * Whether matchRare is in the block of 32 vectors at freq, knowing it is no
+ * larger than the last integer of the block. Two comparisons pick the
+ * quarter it can be in.
+ */
+__attribute__((always_inline))
+static inline bool blockcontains(const uint32_t *freq, const uint32_t matchRare) {
+    const vec Match = _mm256_set1_epi32(static_cast<int>(matchRare));
+    if (freq[veclen * 15 + vecmax] >= matchRare) {
+        if (freq[veclen * 7 + vecmax] < matchRare)
+            return contains8(freq + veclen * 8, Match);
+        return contains8(freq, Match);
+    }
+    if (freq[veclen * 23 + vecmax] < matchRare)
+        return contains8(freq + veclen * 24, Match);
+    return contains8(freq + veclen * 16, Match);
+}
+
+size_t AVX2v1(const uint32_t *rare, const size_t lenRare,
+              const uint32_t *freq, const size_t lenFreq, uint32_t *out) {
+    if (lenFreq == 0 || lenRare == 0)
+        return 0;
+    assert(lenRare <= lenFreq);
+    const uint32_t *const initout(out);
+    const size_t freqspace = 2 * veclen - 1;
+    if (lenFreq <= freqspace) {
+        return scalar(freq, lenFreq, rare, lenRare, out);
+    }
+
+    const uint32_t *stopFreq = freq + lenFreq - freqspace;
+    const uint32_t *stopRare = rare + lenRare;
+    for (; rare < stopRare; ++rare) {
+        const uint32_t matchRare = *rare;
+        while (freq[2 * veclen - 1] < matchRare) {
+            if (freq + 2 * veclen >= stopFreq)
+                goto FINISH_SCALAR;
+            freq += 2 * veclen;
+        }
+        const vec Match = _mm256_set1_epi32(static_cast<int>(matchRare));
+        const vec F0 = _mm256_or_si256(
+                           _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const vec *>(freq)), Match),
+                           _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const vec *>(freq) + 1), Match));
+        if (!_mm256_testz_si256(F0, F0))
+            *out++ = matchRare;
+    }
+
+FINISH_SCALAR:
+    return (out - initout) + scalar(freq, stopFreq + freqspace - freq, rare, stopRare - rare, out);
+}
+
+size_t AVX2v3(const uint32_t *rare, const size_t lenRare,
+              const uint32_t *freq, const size_t lenFreq, uint32_t *out) {
+    if (lenFreq == 0 || lenRare == 0)
+        return 0;
+    assert(lenRare <= lenFreq);
+    const uint32_t *const initout(out);
+    const size_t freqspace = 32 * veclen;
+    const size_t rarespace = 1;
+
+    const uint32_t *stopFreq = freq + lenFreq - freqspace;
+    const uint32_t *stopRare = rare + lenRare - rarespace;
+    if (lenFreq < freqspace) {
+        return scalar(freq, lenFreq, rare, lenRare, out);
+    }
+    for (; rare < stopRare; ++rare) {
+        const uint32_t matchRare = *rare;
+        while (freq[veclen * 31 + vecmax] < matchRare) { // if no match possible
+            freq += veclen * 32; // advance 32 vectors
+            if (freq > stopFreq)
+                goto FINISH_SCALAR;
+        }
+        if (blockcontains(freq, matchRare))
+            *out++ = matchRare;
+    }
+
+FINISH_SCALAR:
+    return (out - initout) + scalar(freq, stopFreq + freqspace - freq, rare, stopRare + rarespace - rare, out);
+}
+
+size_t AVX2galloping(const uint32_t *rare, const size_t lenRare,
+                     const uint32_t *freq, const size_t lenFreq, uint32_t *out) {
+    if (lenFreq == 0 || lenRare == 0)
+        return 0;
+    assert(lenRare <= lenFreq);
+    const uint32_t *const initout(out);
+    const size_t freqspace = 32 * veclen;
+    const size_t rarespace = 1;
+
+    const uint32_t *stopFreq = freq + lenFreq - freqspace;
+    const uint32_t *stopRare = rare + lenRare - rarespace;
+    if (lenFreq < freqspace) {
+        return scalar(freq, lenFreq, rare, lenRare, out);
+    }
+    for (; rare < stopRare; ++rare) {
+        const uint32_t matchRare = *rare;
+
+        if (freq[veclen * 31 + vecmax] < matchRare) { // if no match possible
+            uint32_t offset = 1;
+            if (freq + veclen * 32 > stopFreq) {
+                freq += veclen * 32;
+                goto FINISH_SCALAR;
+            }
+            while (freq[veclen * offset * 32 + veclen * 31 + vecmax]
+                   < matchRare) { // if no match possible
+                if (freq + veclen * (2 * offset) * 32 <= stopFreq) {
+                    offset *= 2;
+                } else if (freq + veclen * (offset + 1) * 32 <= stopFreq) {
+                    offset = static_cast<uint32_t>((stopFreq - freq) / (veclen * 32));
+                    if (freq[veclen * offset * 32 + veclen * 31 + vecmax]
+                        < matchRare) {
+                        freq += veclen * offset * 32;
+                        goto FINISH_SCALAR;
+                    } else {
+                        break;
+                    }
+                } else {
+                    freq += veclen * offset * 32;
+                    goto FINISH_SCALAR;
+                }
+            }
+            uint32_t lower = offset / 2;
+            while (lower + 1 != offset) {
+                const uint32_t mid = (lower + offset) / 2;
+                if (freq[veclen * mid * 32 + veclen * 31 + vecmax]
+                    < matchRare)
+                    lower = mid;
+                else
+                    offset = mid;
+            }
+            freq += veclen * offset * 32;
+        }
+        if (blockcontains(freq, matchRare))
+            *out++ = matchRare;
+    }
+
+FINISH_SCALAR:
+    return (out - initout) + scalar(freq, stopFreq + freqspace - freq, rare, stopRare + rarespace - rare, out);
+}
+
+size_t AVX2intersection(const uint32_t *set1,
+                        const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out) {
+    if ((length1 == 0) or (length2 == 0)) return 0;
+
+    if ((1000 * length1 <= length2) or (1000 * length2 <= length1)) {
+        if (length1 <= length2)
+            return AVX2galloping(set1, length1, set2, length2, out);
+        else
+            return AVX2galloping(set2, length2, set1, length1, out);
+    }
+
+    if ((50 * length1 <= length2) or (50 * length2 <= length1)) {
+        if (length1 <= length2)
+            return AVX2v3(set1, length1, set2, length2, out);
+        else
+            return AVX2v3(set2, length2, set1, length1, out);
+    }
+
+    if (length1 <= length2)
+        return AVX2v1(set1, length1, set2, length2, out);
+    else
+        return AVX2v1(set2, length2, set1, length1, out);
+}
+
+/**
+ * Eight integers of each set against each other, the second set rotated
+ * seven times, only counting the matches.
+ */
+static size_t blockintersectioncardinality(const uint32_t *A, const size_t lenA,
+        const uint32_t *B, const size_t lenB) {
+    size_t count = 0, i = 0, j = 0;
+    const size_t stA = lenA / veclen * veclen, stB = lenB / veclen * veclen;
+    const vec rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i < stA && j < stB) {
+        const vec a = _mm256_loadu_si256(reinterpret_cast<const vec *>(A + i));
+        vec b = _mm256_loadu_si256(reinterpret_cast<const vec *>(B + j));
+        vec m = _mm256_cmpeq_epi32(a, b);
+        for (uint32_t r = 1; r < veclen; ++r) {
+            b = _mm256_permutevar8x32_epi32(b, rotate);
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi32(a, b));
+        }
+        count += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+        const uint32_t amax = A[i + vecmax];
+        const uint32_t bmax = B[j + vecmax];
+        if (amax <= bmax)
+            i += veclen;
+        if (bmax <= amax)
+            j += veclen;
+    }
+    return count + mergeintersectioncardinality(A + i, lenA - i, B + j, lenB - j);
+}
+
+size_t AVX2intersectionCardinality(const uint32_t *set1,
+                                   const size_t length1, const uint32_t *set2, const size_t length2) {
+    if ((length1 == 0) or (length2 == 0)) return 0;
+
+    if ((50 * length1 <= length2) or (50 * length2 <= length1)) {
+        if (length1 <= length2)
+            return gallopingintersectioncardinality(set1, length1, set2, length2);
+        else
+            return gallopingintersectioncardinality(set2, length2, set1, length1);
+    }
+    return blockintersectioncardinality(set1, length1, set2, length2);
+}
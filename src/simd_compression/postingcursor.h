@@ -0,0 +1,103 @@
+
+
+#ifndef POSTINGCURSOR_H_
+#define POSTINGCURSOR_H_
+
+#include "common.h"
+#include "codecs.h"
+
+/**
+ * Integer by integer access to a sorted list compressed by any
+ * IntegerCODEC, on top of its IntegerCursor. Only the current block is
+ * decoded, so a list of any length is walked in constant memory (except
+ * with the codecs that fall back to BufferedCursor) and stopping early
+ * saves decoding the rest.
+ *
+ *   PostingCursor cursor(*codec, compressed, compressedlength, length);
+ *   for (cursor.advance(target); cursor.valid(); cursor.next())
+ *       ... cursor.value() ...
+ *
+ * The cursor starts on the first integer, which is decoded on the first
+ * call.
+ */
+class PostingCursor {
+public:
+    PostingCursor(IntegerCODEC &codec, const uint32_t *in, const size_t length,
+                  const size_t expected) :
+        cursor(codec.newCursor(in, length, expected)), span(NULL), count(0), index(0),
+        finished(false) {
+    }
+
+    bool valid() {
+        return fill();
+    }
+
+    /**
+     * The current integer, only once valid returned true.
+     */
+    uint32_t value() const {
+        return span[index];
+    }
+
+    void next() {
+        if (fill())
+            ++index;
+    }
+
+    /**
+     * Moves to the first integer >= target, staying put if the current one
+     * already is. Blocks below target are skipped when the codec can tell
+     * without decoding them.
+     */
+    void advance(uint32_t target) {
+        if (!fill() or span[index] >= target)
+            return;
+        while (span[count - 1] < target) {
+            count = cursor->skipTo(target, span);
+            index = 0;
+            if (count == 0) {
+                finished = true;
+                return;
+            }
+        }
+        index = std::lower_bound(span + index, span + count, target) - span;
+    }
+
+    /**
+     * Points out at the integers left in the current block, valid until
+     * the next call on the cursor, and moves past them. Returns how many
+     * there are, 0 at the end of the list.
+     */
+    size_t nextBlock(const uint32_t *&out) {
+        if (!fill())
+            return 0;
+        out = span + index;
+        const size_t length = count - index;
+        index = count;
+        return length;
+    }
+
+private:
+    unique_ptr<IntegerCursor> cursor;
+    const uint32_t *span;
+    size_t count;
+    size_t index;
+    bool finished;
+
+    /**
+     * Decodes the next block once the current one is used up, the blocks
+     * handed out by nextBlock stay put until then.
+     */
+    bool fill() {
+        if (index < count)
+            return true;
+        if (finished)
+            return false;
+        count = cursor->nextBlock(span);
+        index = 0;
+        finished = count == 0;
+        return !finished;
+    }
+};
+
+#endif /* POSTINGCURSOR_H_ */
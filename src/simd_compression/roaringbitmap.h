@@ -0,0 +1,722 @@
+
+
+#ifndef ROARINGBITMAP_H_
+#define ROARINGBITMAP_H_
+
+#include "common.h"
+
+using namespace std;
+
+/**
+ * Compressed bitmap in the style of Roaring (Chambi, Lemire, Kaser and
+ * Godin, Better bitmap performance with Roaring bitmaps, 2016).
+ *
+ * The 32-bit space is cut into chunks of 65536 integers keyed by their
+ * high 16 bits. Each non-empty chunk is held by the smallest of
+ *  - an array container: sorted low 16 bits, at most 4096 of them
+ *  - a bitmap container: 1024 64-bit words
+ *  - a run container: (start, length - 1) pairs, only made by runOptimize
+ * so memory follows the number of set bits rather than the largest
+ * integer, unlike BoolArray.
+ *
+ * Array/array intersections use SSE4.2 string compares, bitmap/bitmap
+ * operations are 128-bit SSE and counted with popcnt, arrays are probed
+ * against bitmaps and runs. Runs are expanded to words when combined with
+ * anything but an array.
+ *
+ * A bitmap serialized with write() can be used in place with map(), e.g.
+ * from an mmap'ed file, without copying the containers:
+ *
+ *   [cookie][container count]
+ *   [key, type, cardinality, offset, size] per container, 16 bytes each
+ *   payloads, each 8-byte aligned from the start
+ */
+class RoaringBitmap {
+public:
+    enum { ARRAY = 0, BITMAP = 1, RUN = 2 };
+
+    static const uint32_t MaxArraySize = 4096;
+    static const uint32_t BitmapWords = 1024;
+    static const uint32_t Cookie = 0x314d4252;
+
+    RoaringBitmap() :
+        keys(), containers() {
+    }
+
+    /**
+     * Builds a bitmap out of a sorted array of distinct integers.
+     */
+    static RoaringBitmap fromSorted(const uint32_t *data, const size_t length) {
+        RoaringBitmap answer;
+        size_t i = 0;
+        while (i < length) {
+            const uint16_t key = static_cast<uint16_t>(data[i] >> 16);
+            size_t j = i;
+            while (j < length && (data[j] >> 16) == key)
+                ++j;
+            Container c;
+            if (j - i > MaxArraySize) {
+                c.type = BITMAP;
+                c.words.assign(BitmapWords, 0);
+                for (size_t k = i; k < j; ++k)
+                    c.words[(data[k] & 0xFFFF) / 64] |= static_cast<uint64_t>(1) << (data[k] % 64);
+            } else {
+                c.type = ARRAY;
+                c.shorts.resize(j - i);
+                for (size_t k = i; k < j; ++k)
+                    c.shorts[k - i] = static_cast<uint16_t>(data[k]);
+            }
+            c.cardinality = static_cast<uint32_t>(j - i);
+            answer.keys.push_back(key);
+            answer.containers.push_back(c);
+            i = j;
+        }
+        return answer;
+    }
+
+    /**
+     * Uses a serialized bitmap in place. in must stay valid and unchanged
+     * for as long as the bitmap (or a copy of it) is in use, and be 8-byte
+     * aligned. Containers are copied out on the first write.
+     */
+    static RoaringBitmap map(const char *in) {
+        RoaringBitmap answer;
+        uint32_t header[2];
+        memcpy(header, in, sizeof(header));
+        assert(header[0] == Cookie);
+        const uint32_t count = header[1];
+        answer.keys.resize(count);
+        answer.containers.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            descriptor d;
+            memcpy(&d, in + sizeof(header) + i * sizeof(descriptor), sizeof(descriptor));
+            Container &c = answer.containers[i];
+            answer.keys[i] = d.key;
+            c.type = d.type;
+            c.cardinality = d.cardinality;
+            if (c.type == BITMAP)
+                c.mappedWords = reinterpret_cast<const uint64_t *>(in + d.offset);
+            else
+                c.mappedShorts = reinterpret_cast<const uint16_t *>(in + d.offset);
+            c.mappedSize = d.size;
+        }
+        return answer;
+    }
+
+    /**
+     * Copies a serialized bitmap out of in, which doesn't need to be
+     * aligned.
+     */
+    static RoaringBitmap read(const char *in) {
+        RoaringBitmap answer;
+        uint32_t header[2];
+        memcpy(header, in, sizeof(header));
+        assert(header[0] == Cookie);
+        const uint32_t count = header[1];
+        answer.keys.resize(count);
+        answer.containers.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            descriptor d;
+            memcpy(&d, in + sizeof(header) + i * sizeof(descriptor), sizeof(descriptor));
+            Container &c = answer.containers[i];
+            answer.keys[i] = d.key;
+            c.type = d.type;
+            c.cardinality = d.cardinality;
+            if (c.type == BITMAP) {
+                c.words.resize(BitmapWords);
+                memcpy(c.words.data(), in + d.offset, BitmapWords * sizeof(uint64_t));
+            } else {
+                c.shorts.resize(d.size);
+                memcpy(c.shorts.data(), in + d.offset, d.size * sizeof(uint16_t));
+            }
+        }
+        return answer;
+    }
+
+    size_t serializedSizeInBytes() const {
+        size_t answer = 2 * sizeof(uint32_t) + containers.size() * sizeof(descriptor);
+        for (const Container &c : containers)
+            answer = align8(answer) + c.payloadInBytes();
+        return answer;
+    }
+
+    /**
+     * Writes the bitmap for map(), out needs serializedSizeInBytes() bytes.
+     * Returns the number of bytes written.
+     */
+    size_t write(char *out) const {
+        const uint32_t header[2] = { Cookie, static_cast<uint32_t>(containers.size()) };
+        memcpy(out, header, sizeof(header));
+        size_t offset = sizeof(header) + containers.size() * sizeof(descriptor);
+        for (size_t i = 0; i < containers.size(); ++i) {
+            const Container &c = containers[i];
+            const size_t aligned = align8(offset);
+            memset(out + offset, 0, aligned - offset);
+            descriptor d;
+            d.key = keys[i];
+            d.type = c.type;
+            d.padding = 0;
+            d.cardinality = c.cardinality;
+            d.offset = static_cast<uint32_t>(aligned);
+            d.size = static_cast<uint32_t>(c.type == BITMAP ? BitmapWords : c.size());
+            memcpy(out + sizeof(header) + i * sizeof(descriptor), &d, sizeof(descriptor));
+            if (c.type == BITMAP)
+                memcpy(out + aligned, c.bitmap(), c.payloadInBytes());
+            else
+                memcpy(out + aligned, c.values(), c.payloadInBytes());
+            offset = aligned + c.payloadInBytes();
+        }
+        return offset;
+    }
+
+    void add(const uint32_t x) {
+        const uint16_t key = static_cast<uint16_t>(x >> 16);
+        const uint16_t low = static_cast<uint16_t>(x);
+        vector<uint16_t>::iterator k = lower_bound(keys.begin(), keys.end(), key);
+        const size_t i = k - keys.begin();
+        if (k == keys.end() || *k != key) {
+            keys.insert(k, key);
+            containers.insert(containers.begin() + i, Container());
+        }
+        Container &c = containers[i];
+        if (containerContains(c, low))
+            return;
+        own(c);
+        if (c.type == RUN)
+            toBitmapContainer(c);
+        if (c.type == BITMAP) {
+            c.words[low / 64] |= static_cast<uint64_t>(1) << (low % 64);
+        } else {
+            c.shorts.insert(lower_bound(c.shorts.begin(), c.shorts.end(), low), low);
+            if (c.shorts.size() > MaxArraySize)
+                toBitmapContainer(c);
+        }
+        c.cardinality++;
+    }
+
+    bool contains(const uint32_t x) const {
+        const uint16_t key = static_cast<uint16_t>(x >> 16);
+        vector<uint16_t>::const_iterator k = lower_bound(keys.begin(), keys.end(), key);
+        if (k == keys.end() || *k != key)
+            return false;
+        return containerContains(containers[k - keys.begin()], static_cast<uint16_t>(x));
+    }
+
+    /**
+     * Same as contains, for code written against BoolArray.
+     */
+    bool get(const uint32_t x) const {
+        return contains(x);
+    }
+
+    size_t cardinality() const {
+        size_t answer = 0;
+        for (const Container &c : containers)
+            answer += c.cardinality;
+        return answer;
+    }
+
+    /**
+     * Memory used by the containers, mapped ones included.
+     */
+    size_t sizeInBytes() const {
+        size_t answer = keys.size() * (sizeof(uint16_t) + sizeof(Container));
+        for (const Container &c : containers)
+            answer += c.payloadInBytes();
+        return answer;
+    }
+
+    /**
+     * Writes the set bits to out in increasing order, out needs room for
+     * cardinality() integers. Returns the number of written ints.
+     */
+    size_t toInts(uint32_t *out) const {
+        size_t pos = 0;
+        for (size_t i = 0; i < containers.size(); ++i)
+            pos += decode(containers[i], static_cast<uint32_t>(keys[i]) << 16, out + pos);
+        return pos;
+    }
+
+    /**
+     * Converts containers to runs wherever that is smaller. Returns true
+     * if any container changed.
+     */
+    bool runOptimize() {
+        bool changed = false;
+        vector<uint32_t> values(1 << 16);
+        for (Container &c : containers) {
+            if (c.type == RUN)
+                continue;
+            const size_t n = decode(c, 0, values.data());
+            size_t runs = 0;
+            for (size_t i = 0; i < n; ++i)
+                if (i == 0 || values[i] != values[i - 1] + 1)
+                    ++runs;
+            if (runs * 2 * sizeof(uint16_t) >= c.payloadInBytes())
+                continue;
+            Container r;
+            r.type = RUN;
+            r.cardinality = c.cardinality;
+            for (size_t i = 0; i < n; ++i) {
+                if (i == 0 || values[i] != values[i - 1] + 1) {
+                    r.shorts.push_back(static_cast<uint16_t>(values[i]));
+                    r.shorts.push_back(0);
+                } else {
+                    r.shorts.back()++;
+                }
+            }
+            c = r;
+            changed = true;
+        }
+        return changed;
+    }
+
+    void intersect(const RoaringBitmap &other, RoaringBitmap &output) const {
+        output.keys.clear();
+        output.containers.clear();
+        size_t i = 0, j = 0;
+        while (i < keys.size() && j < other.keys.size()) {
+            if (keys[i] < other.keys[j]) {
+                ++i;
+            } else if (keys[i] > other.keys[j]) {
+                ++j;
+            } else {
+                Container c;
+                containerAnd(containers[i], other.containers[j], c);
+                if (c.cardinality > 0) {
+                    output.keys.push_back(keys[i]);
+                    output.containers.push_back(c);
+                }
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    void inplaceIntersect(const RoaringBitmap &other) {
+        RoaringBitmap answer;
+        intersect(other, answer);
+        swap(answer);
+    }
+
+    void unite(const RoaringBitmap &other, RoaringBitmap &output) const {
+        output.keys.clear();
+        output.containers.clear();
+        size_t i = 0, j = 0;
+        while (i < keys.size() || j < other.keys.size()) {
+            if (j == other.keys.size() || (i < keys.size() && keys[i] < other.keys[j])) {
+                output.keys.push_back(keys[i]);
+                output.containers.push_back(containers[i++]);
+            } else if (i == keys.size() || keys[i] > other.keys[j]) {
+                output.keys.push_back(other.keys[j]);
+                output.containers.push_back(other.containers[j++]);
+            } else {
+                Container c;
+                containerOr(containers[i], other.containers[j], c);
+                output.keys.push_back(keys[i]);
+                output.containers.push_back(c);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    void inplaceUnion(const RoaringBitmap &other) {
+        RoaringBitmap answer;
+        unite(other, answer);
+        swap(answer);
+    }
+
+    /**
+     * output = this minus other
+     */
+    void andNot(const RoaringBitmap &other, RoaringBitmap &output) const {
+        output.keys.clear();
+        output.containers.clear();
+        size_t j = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            while (j < other.keys.size() && other.keys[j] < keys[i])
+                ++j;
+            if (j == other.keys.size() || other.keys[j] != keys[i]) {
+                output.keys.push_back(keys[i]);
+                output.containers.push_back(containers[i]);
+                continue;
+            }
+            Container c;
+            containerAndNot(containers[i], other.containers[j], c);
+            if (c.cardinality > 0) {
+                output.keys.push_back(keys[i]);
+                output.containers.push_back(c);
+            }
+        }
+    }
+
+    void inplaceAndNot(const RoaringBitmap &other) {
+        RoaringBitmap answer;
+        andNot(other, answer);
+        swap(answer);
+    }
+
+    /**
+     * Cardinality of the intersection, without materializing it.
+     */
+    size_t intersectionCardinality(const RoaringBitmap &other) const {
+        size_t answer = 0;
+        size_t i = 0, j = 0;
+        while (i < keys.size() && j < other.keys.size()) {
+            if (keys[i] < other.keys[j]) {
+                ++i;
+            } else if (keys[i] > other.keys[j]) {
+                ++j;
+            } else {
+                answer += containerAndCardinality(containers[i++], other.containers[j++]);
+            }
+        }
+        return answer;
+    }
+
+    void swap(RoaringBitmap &other) {
+        keys.swap(other.keys);
+        containers.swap(other.containers);
+    }
+
+private:
+    typedef struct {
+        uint16_t key;
+        uint8_t type;
+        uint8_t padding;
+        uint32_t cardinality;
+        uint32_t offset;
+        // number of uint16_t of an array or run, words of a bitmap
+        uint32_t size;
+    } descriptor;
+
+    struct Container {
+        uint8_t type;
+        uint32_t cardinality;
+        // array values, or (start, length - 1) pairs of a run
+        vector<uint16_t> shorts;
+        vector<uint64_t> words;
+        // set instead when the container lives in a mapped buffer
+        const uint16_t *mappedShorts;
+        const uint64_t *mappedWords;
+        uint32_t mappedSize;
+
+        Container() :
+            type(ARRAY), cardinality(0), shorts(), words(),
+            mappedShorts(NULL), mappedWords(NULL), mappedSize(0) {
+        }
+
+        const uint16_t *values() const {
+            return mappedShorts != NULL ? mappedShorts : shorts.data();
+        }
+
+        size_t size() const {
+            return mappedShorts != NULL ? mappedSize : shorts.size();
+        }
+
+        const uint64_t *bitmap() const {
+            return mappedWords != NULL ? mappedWords : words.data();
+        }
+
+        size_t payloadInBytes() const {
+            return type == BITMAP ? BitmapWords * sizeof(uint64_t) : size() * sizeof(uint16_t);
+        }
+    };
+
+    vector<uint16_t> keys;
+    vector<Container> containers;
+
+    static size_t align8(const size_t offset) {
+        return (offset + 7) / 8 * 8;
+    }
+
+    static void own(Container &c) {
+        if (c.mappedShorts != NULL) {
+            c.shorts.assign(c.mappedShorts, c.mappedShorts + c.mappedSize);
+            c.mappedShorts = NULL;
+        }
+        if (c.mappedWords != NULL) {
+            c.words.assign(c.mappedWords, c.mappedWords + BitmapWords);
+            c.mappedWords = NULL;
+        }
+    }
+
+    static bool containerContains(const Container &c, const uint16_t low) {
+        if (c.type == BITMAP)
+            return (c.bitmap()[low / 64] >> (low % 64)) & 1;
+        const uint16_t *v = c.values();
+        if (c.type == ARRAY)
+            return binary_search(v, v + c.size(), low);
+        // last run starting at or before low
+        size_t lo = 0, hi = c.size() / 2;
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if (v[2 * mid] <= low)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo > 0 && low - v[2 * (lo - 1)] <= v[2 * (lo - 1) + 1];
+    }
+
+    static size_t decode(const Container &c, const uint32_t high, uint32_t *out) {
+        size_t pos = 0;
+        if (c.type == BITMAP) {
+            const uint64_t *w = c.bitmap();
+            for (uint32_t k = 0; k < BitmapWords; ++k) {
+                uint64_t word = w[k];
+                while (word != 0) {
+                    out[pos++] = high | (k * 64 + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        } else if (c.type == ARRAY) {
+            const uint16_t *v = c.values();
+            for (size_t i = 0; i < c.size(); ++i)
+                out[pos++] = high | v[i];
+        } else {
+            const uint16_t *v = c.values();
+            for (size_t i = 0; i < c.size(); i += 2)
+                for (uint32_t x = v[i]; x <= static_cast<uint32_t>(v[i]) + v[i + 1]; ++x)
+                    out[pos++] = high | x;
+        }
+        return pos;
+    }
+
+    /**
+     * The container as 1024 words, in words unless it already is a bitmap.
+     */
+    static const uint64_t *asWords(const Container &c, uint64_t *words) {
+        if (c.type == BITMAP)
+            return c.bitmap();
+        memset(words, 0, BitmapWords * sizeof(uint64_t));
+        const uint16_t *v = c.values();
+        if (c.type == ARRAY) {
+            for (size_t i = 0; i < c.size(); ++i)
+                words[v[i] / 64] |= static_cast<uint64_t>(1) << (v[i] % 64);
+        } else {
+            for (size_t i = 0; i < c.size(); i += 2) {
+                const uint32_t start = v[i];
+                const uint32_t end = start + v[i + 1] + 1;
+                for (uint32_t x = start; x < end;) {
+                    if (x % 64 == 0 && x + 64 <= end) {
+                        words[x / 64] = ~static_cast<uint64_t>(0);
+                        x += 64;
+                    } else {
+                        words[x / 64] |= static_cast<uint64_t>(1) << (x % 64);
+                        ++x;
+                    }
+                }
+            }
+        }
+        return words;
+    }
+
+    static void toBitmapContainer(Container &c) {
+        vector<uint64_t> words(BitmapWords);
+        asWords(c, words.data());
+        c.shorts.clear();
+        c.words.swap(words);
+        c.type = BITMAP;
+    }
+
+    /**
+     * Turns words into the container, an array if it is sparse enough.
+     */
+    static void fromWords(const uint64_t *words, const uint32_t cardinality, Container &c) {
+        c.cardinality = cardinality;
+        if (cardinality > MaxArraySize) {
+            c.type = BITMAP;
+            c.words.assign(words, words + BitmapWords);
+            return;
+        }
+        c.type = ARRAY;
+        c.shorts.resize(cardinality);
+        size_t pos = 0;
+        for (uint32_t k = 0; k < BitmapWords; ++k) {
+            uint64_t word = words[k];
+            while (word != 0) {
+                c.shorts[pos++] = static_cast<uint16_t>(k * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    /**
+     * Bitwise operation over two sets of 1024 words, into out. Returns the
+     * cardinality of the result.
+     */
+    template<int op>
+    static uint32_t wordsOp(const uint64_t *a, const uint64_t *b, uint64_t *out) {
+        uint32_t cardinality = 0;
+        for (uint32_t k = 0; k < BitmapWords; k += 2) {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + k));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + k));
+            const __m128i r = op == 0 ? _mm_and_si128(va, vb) : op == 1 ? _mm_or_si128(va, vb) : _mm_andnot_si128(vb, va);
+            if (out != NULL)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + k), r);
+            cardinality += static_cast<uint32_t>(_mm_popcnt_u64(static_cast<uint64_t>(_mm_cvtsi128_si64(r)))
+                                                 + _mm_popcnt_u64(static_cast<uint64_t>(_mm_extract_epi64(r, 1))));
+        }
+        return cardinality;
+    }
+
+    /**
+     * pshufb masks moving the 16-bit lanes selected by an 8-bit mask to the
+     * front. A plain array, __m128i's attributes are lost as a template
+     * argument.
+     */
+    struct ShuffleMasks {
+        __m128i masks[256];
+
+        ShuffleMasks() : masks() {
+            for (uint32_t m = 0; m < 256; ++m) {
+                uint8_t bytes[16];
+                memset(bytes, 0xFF, sizeof(bytes));
+                uint32_t pos = 0;
+                for (uint32_t lane = 0; lane < 8; ++lane) {
+                    if (m & (1 << lane)) {
+                        bytes[pos++] = static_cast<uint8_t>(2 * lane);
+                        bytes[pos++] = static_cast<uint8_t>(2 * lane + 1);
+                    }
+                }
+                masks[m] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+            }
+        }
+    };
+
+    static const __m128i *shuffleMasks() {
+        static const ShuffleMasks table;
+        return table.masks;
+    }
+
+    /**
+     * Intersection of two sorted arrays of 16-bit integers, compared eight
+     * against eight with _mm_cmpestrm (Schlegel, Willhalm and Lehner).
+     * out needs room for min(lengtha, lengthb) + 8 integers.
+     */
+    static size_t intersect16(const uint16_t *a, const size_t lengtha, const uint16_t *b, const size_t lengthb, uint16_t *out) {
+        const int mode = _SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK;
+        const __m128i *masks = shuffleMasks();
+        const size_t sta = lengtha / 8 * 8, stb = lengthb / 8 * 8;
+        size_t i = 0, j = 0, count = 0;
+        if (sta > 0 && stb > 0) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+            while (true) {
+                const __m128i r = _mm_cmpestrm(vb, 8, va, 8, mode);
+                const int matched = _mm_cvtsi128_si32(r);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + count), _mm_shuffle_epi8(va, masks[matched]));
+                count += _mm_popcnt_u32(matched);
+                const uint16_t amax = a[i + 7];
+                const uint16_t bmax = b[j + 7];
+                if (amax <= bmax) {
+                    i += 8;
+                    if (i == sta)
+                        break;
+                    va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                }
+                if (bmax <= amax) {
+                    j += 8;
+                    if (j == stb)
+                        break;
+                    vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+                }
+            }
+        }
+        while (i < lengtha && j < lengthb) {
+            if (a[i] < b[j]) {
+                ++i;
+            } else if (a[i] > b[j]) {
+                ++j;
+            } else {
+                out[count++] = a[i];
+                ++i;
+                ++j;
+            }
+        }
+        return count;
+    }
+
+    static void containerAnd(const Container &a, const Container &b, Container &out) {
+        if (a.type == ARRAY && b.type == ARRAY) {
+            out.type = ARRAY;
+            out.shorts.resize(min(a.size(), b.size()) + 8);
+            out.shorts.resize(intersect16(a.values(), a.size(), b.values(), b.size(), out.shorts.data()));
+            out.cardinality = static_cast<uint32_t>(out.shorts.size());
+            return;
+        }
+        if (a.type == ARRAY || b.type == ARRAY) {
+            const Container &array = a.type == ARRAY ? a : b;
+            const Container &other = a.type == ARRAY ? b : a;
+            const uint16_t *v = array.values();
+            out.type = ARRAY;
+            for (size_t i = 0; i < array.size(); ++i)
+                if (containerContains(other, v[i]))
+                    out.shorts.push_back(v[i]);
+            out.cardinality = static_cast<uint32_t>(out.shorts.size());
+            return;
+        }
+        vector<uint64_t> scratch(3 * BitmapWords);
+        const uint64_t *wa = asWords(a, scratch.data());
+        const uint64_t *wb = asWords(b, scratch.data() + BitmapWords);
+        uint64_t *result = scratch.data() + 2 * BitmapWords;
+        fromWords(result, wordsOp<0>(wa, wb, result), out);
+    }
+
+    static void containerOr(const Container &a, const Container &b, Container &out) {
+        if (a.type == ARRAY && b.type == ARRAY && a.size() + b.size() <= MaxArraySize) {
+            out.type = ARRAY;
+            out.shorts.resize(a.size() + b.size());
+            out.shorts.resize(set_union(a.values(), a.values() + a.size(), b.values(), b.values() + b.size(),
+                                        out.shorts.begin()) - out.shorts.begin());
+            out.cardinality = static_cast<uint32_t>(out.shorts.size());
+            return;
+        }
+        vector<uint64_t> scratch(3 * BitmapWords);
+        const uint64_t *wa = asWords(a, scratch.data());
+        const uint64_t *wb = asWords(b, scratch.data() + BitmapWords);
+        uint64_t *result = scratch.data() + 2 * BitmapWords;
+        fromWords(result, wordsOp<1>(wa, wb, result), out);
+    }
+
+    static void containerAndNot(const Container &a, const Container &b, Container &out) {
+        if (a.type == ARRAY) {
+            const uint16_t *v = a.values();
+            out.type = ARRAY;
+            for (size_t i = 0; i < a.size(); ++i)
+                if (!containerContains(b, v[i]))
+                    out.shorts.push_back(v[i]);
+            out.cardinality = static_cast<uint32_t>(out.shorts.size());
+            return;
+        }
+        vector<uint64_t> scratch(3 * BitmapWords);
+        const uint64_t *wa = asWords(a, scratch.data());
+        const uint64_t *wb = asWords(b, scratch.data() + BitmapWords);
+        uint64_t *result = scratch.data() + 2 * BitmapWords;
+        fromWords(result, wordsOp<2>(wa, wb, result), out);
+    }
+
+    static uint32_t containerAndCardinality(const Container &a, const Container &b) {
+        if (a.type == ARRAY && b.type == ARRAY) {
+            vector<uint16_t> scratch(min(a.size(), b.size()) + 8);
+            return static_cast<uint32_t>(intersect16(a.values(), a.size(), b.values(), b.size(), scratch.data()));
+        }
+        if (a.type == ARRAY || b.type == ARRAY) {
+            const Container &array = a.type == ARRAY ? a : b;
+            const Container &other = a.type == ARRAY ? b : a;
+            const uint16_t *v = array.values();
+            uint32_t answer = 0;
+            for (size_t i = 0; i < array.size(); ++i)
+                answer += containerContains(other, v[i]);
+            return answer;
+        }
+        vector<uint64_t> scratch(2 * BitmapWords);
+        const uint64_t *wa = asWords(a, scratch.data());
+        const uint64_t *wb = asWords(b, scratch.data() + BitmapWords);
+        return wordsOp<0>(wa, wb, NULL);
+    }
+};
+
+#endif /* ROARINGBITMAP_H_ */
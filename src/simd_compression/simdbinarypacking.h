@@ -228,6 +228,91 @@ public:
         return in;
     }
 
+    /**
+     * Decodes one 128-integer miniblock at a time, copying its packed words
+     * to an aligned buffer first, so unlike decodeArray the stream does not
+     * need to be aligned. With an integrated (delta) BlockPacker miniblocks
+     * cannot be skipped without decoding them since each one starts from
+     * the last integer of the previous.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        Cursor() :
+            in(NULL), remaining(0), miniblock(HowManyMiniBlocks),
+            init(_mm_set1_epi32(0)) {
+        }
+
+        Cursor(const uint32_t *in, const size_t length) {
+            reset(in, length);
+        }
+
+        void reset(const uint32_t *compressed, const size_t length) {
+            in = reinterpret_cast<const uint8_t *>(compressed);
+            remaining = 0;
+            miniblock = HowManyMiniBlocks;
+            init = _mm_set1_epi32(0);
+            if (length == 0)
+                return;
+            const uint8_t *const final = in + length * sizeof(uint32_t);
+            remaining = load();
+            // the stream was aligned when written, at most 3 words pad it
+            for (int i = 0; i < 3 and in < final and peek() == CookiePadder; ++i)
+                in += sizeof(uint32_t);
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            if (remaining == 0)
+                return 0;
+            if (miniblock == HowManyMiniBlocks) {
+                for (uint32_t i = 0; i < 4; ++i) {
+                    const uint32_t word = load();
+                    Bs[0 + 4 * i] = static_cast<uint8_t>(word >> 24);
+                    Bs[1 + 4 * i] = static_cast<uint8_t>(word >> 16);
+                    Bs[2 + 4 * i] = static_cast<uint8_t>(word >> 8);
+                    Bs[3 + 4 * i] = static_cast<uint8_t>(word);
+                }
+                miniblock = 0;
+            }
+            const uint32_t bit = Bs[miniblock++];
+            memcpy(packed, in, MiniBlockSize / 32 * bit * sizeof(uint32_t));
+            in += MiniBlockSize / 32 * bit * sizeof(uint32_t);
+            BlockPacker::unpackblock(packed, buffer, bit, init);
+            remaining -= MiniBlockSize;
+            span = buffer;
+            return MiniBlockSize;
+        }
+
+        const uint32_t *end() const {
+            return reinterpret_cast<const uint32_t *>(in);
+        }
+
+    private:
+        const uint8_t *in;
+        uint32_t remaining;
+        uint32_t miniblock;
+        __m128i init;
+        uint32_t Bs[HowManyMiniBlocks];
+        ALIGN16 uint32_t packed[MiniBlockSize];
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+
+        uint32_t peek() const {
+            uint32_t word;
+            memcpy(&word, in, sizeof(word));
+            return word;
+        }
+
+        uint32_t load() {
+            const uint32_t word = peek();
+            in += sizeof(word);
+            return word;
+        }
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
     string name() const {
         ostringstream convert;
         convert << "SIMDBinaryPacking" << "With" << BlockPacker::name() << MiniBlockSize;
@@ -18,15 +18,15 @@
 const size_t SIMDBlockSize = 128;
 
 
-void SIMD_nullunpacker32(const __m128i   *__restrict__ , uint32_t   *__restrict__  out) {
+inline void SIMD_nullunpacker32(const __m128i   *__restrict__ , uint32_t   *__restrict__  out) {
     memset(out, 0, 32 * 4 * 4);
 }
-void uSIMD_nullunpacker32(const __m128i   *__restrict__ , uint32_t   *__restrict__  out) {
+inline void uSIMD_nullunpacker32(const __m128i   *__restrict__ , uint32_t   *__restrict__  out) {
     memset(out, 0, 32 * 4 * 4);
 }
 
 
-void simdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out, const uint32_t bit) {
+inline void simdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: SIMD_nullunpacker32(in, out); return;
 
@@ -102,7 +102,7 @@ void simdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out,
 
 
 /*assumes that integers fit in the prescribed number of bits*/
-void simdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
+inline void simdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: return;
 
@@ -176,7 +176,7 @@ void simdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restric
 }
 
 /*assumes that integers fit in the prescribed number of bits*/
-void simdpack(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
+inline void simdpack(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: return;
 
@@ -250,7 +250,7 @@ void simdpack(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, c
 }
 
 
-void usimdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out, const uint32_t bit) {
+inline void usimdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: uSIMD_nullunpacker32(in, out); return;
 
@@ -326,7 +326,7 @@ void usimdunpack(const __m128i   *__restrict__ in, uint32_t   *__restrict__  out
 
 
 /*assumes that integers fit in the prescribed number of bits*/
-void usimdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
+inline void usimdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: return;
 
@@ -399,7 +399,7 @@ void usimdpackwithoutmask(const uint32_t   *__restrict__ in, __m128i   *__restri
     throw std::logic_error("number of bits is unsupported");
 }
 
-void usimdpack(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
+inline void usimdpack(const uint32_t   *__restrict__ in, __m128i   *__restrict__  out, const uint32_t bit) {
     switch (bit) {
     case 0: return;
 
@@ -0,0 +1,286 @@
+
+
+#ifndef SIMDINDEXEDBINARYPACKING_H_
+#define SIMDINDEXEDBINARYPACKING_H_
+
+#include "codecs.h"
+#include "simdbinarypacking.h"
+#include "util.h"
+
+/**
+ * SIMDBinaryPacking with a header per 128-integer block so a single block
+ * can be found and decoded on its own: select, lowerBound and
+ * findAndAdvance (see RandomAccessCODEC) decode one block, into a buffer
+ * that stays in L1, and search it in registers.
+ *
+ * In SIMDBinaryPacking an integrated (delta) block starts from the last
+ * integer of the previous one, so every block before the target has to be
+ * decoded. Here each block is coded against a base kept in its header,
+ * the integer before the block. Layout:
+ *
+ *   length
+ *   one header of 2 words per block: base, (offset << 6) | bit width, the
+ *   offset being in 128-bit words from the start of the packed data
+ *   CookiePadder up to a multiple of 4 words
+ *   the packed blocks
+ *
+ * The last block is padded by repeating its last integer, so any length
+ * can be encoded and no VariableByte tail is needed. lowerBound and
+ * findAndAdvance need sorted input and a differential BlockPacker.
+ *
+ * encodeArray and decodeArray want 128-bit aligned pointers like
+ * SIMDBinaryPacking, the random access methods do not.
+ */
+template <class BlockPacker>
+class SIMDIndexedBinaryPacking: public IntegerCODEC, public RandomAccessCODEC {
+public:
+    static const uint32_t CookiePadder = 123456;// just some made up number
+    static const uint32_t MiniBlockSize = 128;
+    static const uint32_t BlockSize = 1;
+
+    void encodeArray(uint32_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        if (needPaddingTo128Bits(out)
+            or needPaddingTo128Bits(in)) throw
+            std::runtime_error("alignment issue: pointers should be aligned on 128-bit boundaries");
+        const size_t blocks = blockCount(length);
+        const size_t headerwords = headerWords(blocks);
+        out[0] = static_cast<uint32_t>(length);
+        for (size_t i = 1 + 2 * blocks; i < headerwords; ++i)
+            out[i] = CookiePadder;
+        uint32_t *const data = out + headerwords;
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+        uint32_t offset = 0;
+        uint32_t base = 0;
+        for (size_t b = 0; b < blocks; ++b) {
+            const size_t count = min(length - b * MiniBlockSize, static_cast<size_t>(MiniBlockSize));
+            uint32_t *block = in + b * MiniBlockSize;
+            // read before packing, some packers work in place
+            const uint32_t nextbase = block[count - 1];
+            if (count < MiniBlockSize) {
+                memcpy(buffer, block, count * sizeof(uint32_t));
+                for (size_t i = count; i < MiniBlockSize; ++i)
+                    buffer[i] = block[count - 1];
+                block = buffer;
+            }
+            __m128i init = _mm_set1_epi32(static_cast<int>(base));
+            const uint32_t bit = BlockPacker::maxbits(block, init);
+            init = _mm_set1_epi32(static_cast<int>(base));
+            BlockPacker::packblockwithoutmask(block, data + offset * 4, bit, init);
+            out[1 + 2 * b] = base;
+            out[2 + 2 * b] = (offset << 6) | bit;
+            offset += bit;
+            base = nextbase;
+        }
+        nvalue = headerwords + offset * 4;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t /*length*/,
+                                uint32_t *out, size_t &nvalue) {
+        if (needPaddingTo128Bits(out)
+            or needPaddingTo128Bits(in)) throw
+            std::runtime_error("alignment issue: pointers should be aligned on 128-bit boundaries");
+        const size_t length = in[0];
+        const size_t blocks = blockCount(length);
+        const uint32_t *const data = in + headerWords(blocks);
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+        uint32_t end = 0;
+        for (size_t b = 0; b < blocks; ++b) {
+            const uint32_t bit = in[2 + 2 * b] & 63;
+            const uint32_t offset = in[2 + 2 * b] >> 6;
+            __m128i init = _mm_set1_epi32(static_cast<int>(in[1 + 2 * b]));
+            const size_t count = min(length - b * MiniBlockSize, static_cast<size_t>(MiniBlockSize));
+            if (count == MiniBlockSize) {
+                BlockPacker::unpackblock(data + offset * 4, out + b * MiniBlockSize, bit, init);
+            } else {
+                BlockPacker::unpackblock(data + offset * 4, buffer, bit, init);
+                memcpy(out + b * MiniBlockSize, buffer, count * sizeof(uint32_t));
+            }
+            end = offset + bit;
+        }
+        nvalue = length;
+        return data + end * 4;
+    }
+
+    uint32_t select(const uint32_t *in, size_t index) {
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+        decodeBlock(in, blockCount(load(in, 0)), index / MiniBlockSize, buffer);
+        return buffer[index % MiniBlockSize];
+    }
+
+    size_t lowerBound(const uint32_t *in, uint32_t key, uint32_t *presult) {
+        return findAndAdvance(in, key, 0, presult);
+    }
+
+    size_t findAndAdvance(const uint32_t *in, uint32_t key, size_t from, uint32_t *presult) {
+        const size_t length = load(in, 0);
+        if (from >= length)
+            return length;
+        const size_t blocks = blockCount(length);
+
+        // the block to search is the last one with a base below key: the
+        // integers before it are no larger than its base
+        size_t b = from / MiniBlockSize;
+        if (b + 1 < blocks && base(in, b + 1) < key) {
+            size_t lower = b + 1;
+            size_t step = 1;
+            while (lower + step < blocks && base(in, lower + step) < key) {
+                lower += step;
+                step *= 2;
+            }
+            size_t upper = min(lower + step, blocks);
+            while (lower + 1 < upper) {
+                const size_t mid = (lower + upper) / 2;
+                if (base(in, mid) < key)
+                    lower = mid;
+                else
+                    upper = mid;
+            }
+            b = lower;
+        }
+
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+        decodeBlock(in, blocks, b, buffer);
+        const size_t count = min(length - b * MiniBlockSize, static_cast<size_t>(MiniBlockSize));
+        const size_t start = b == from / MiniBlockSize ? from % MiniBlockSize : 0;
+        const size_t position = max(min(countLess(buffer, key), count), start);
+        if (position < count) {
+            *presult = buffer[position];
+            return b * MiniBlockSize + position;
+        }
+        if (b + 1 < blocks) {
+            // its base, the last integer of b, is below key, so its first
+            // integer is the answer
+            decodeBlock(in, blocks, b + 1, buffer);
+            *presult = buffer[0];
+            return (b + 1) * MiniBlockSize;
+        }
+        return length;
+    }
+
+    size_t encodedLength(const uint32_t *in) {
+        return load(in, 0);
+    }
+
+    /**
+     * Decodes one block at a time. skipTo finds the block to decode from
+     * the bases in the headers, the blocks passed over are never decoded.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        Cursor(const uint32_t *in, const size_t length) :
+            in(in), blocks(0), block(0), length(0), final(in) {
+            if (length == 0)
+                return;
+            this->length = load(in, 0);
+            blocks = blockCount(this->length);
+            final = in + headerWords(blocks);
+            if (blocks > 0) {
+                const uint32_t header = load(in, 2 * blocks);
+                final += ((header >> 6) + (header & 63)) * 4;
+            }
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            if (block == blocks)
+                return 0;
+            decodeBlock(in, blocks, block, buffer);
+            span = buffer;
+            const size_t count = min(length - block * MiniBlockSize, static_cast<size_t>(MiniBlockSize));
+            ++block;
+            return count;
+        }
+
+        size_t skipTo(uint32_t target, const uint32_t *&span) {
+            // the last integer of a block is the base of the next one, so
+            // the block wanted is the last one with a base below target
+            if (block + 1 < blocks and base(in, block + 1) < target) {
+                size_t lower = block + 1;
+                size_t step = 1;
+                while (lower + step < blocks and base(in, lower + step) < target) {
+                    lower += step;
+                    step *= 2;
+                }
+                size_t upper = min(lower + step, blocks);
+                while (lower + 1 < upper) {
+                    const size_t mid = (lower + upper) / 2;
+                    if (base(in, mid) < target)
+                        lower = mid;
+                    else
+                        upper = mid;
+                }
+                block = lower;
+            }
+            return nextBlock(span);
+        }
+
+        const uint32_t *end() const {
+            return final;
+        }
+
+    private:
+        const uint32_t *in;
+        size_t blocks;
+        size_t block;
+        size_t length;
+        const uint32_t *final;
+        ALIGN16 uint32_t buffer[MiniBlockSize];
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
+    string name() const {
+        ostringstream convert;
+        convert << "SIMDIndexedBinaryPacking" << "With" << BlockPacker::name() << MiniBlockSize;
+        return convert.str();
+    }
+
+private:
+    static size_t blockCount(size_t length) {
+        return (length + MiniBlockSize - 1) / MiniBlockSize;
+    }
+
+    static size_t headerWords(size_t blocks) {
+        return (1 + 2 * blocks + 3) / 4 * 4;
+    }
+
+    static uint32_t load(const uint32_t *in, size_t index) {
+        uint32_t word;
+        memcpy(&word, in + index, sizeof(word));
+        return word;
+    }
+
+    static uint32_t base(const uint32_t *in, size_t block) {
+        return load(in, 1 + 2 * block);
+    }
+
+    static void decodeBlock(const uint32_t *in, size_t blocks, size_t block, uint32_t *out) {
+        ALIGN16 uint32_t packed[MiniBlockSize];
+        const uint32_t header = load(in, 2 + 2 * block);
+        const uint32_t bit = header & 63;
+        memcpy(packed, in + headerWords(blocks) + (header >> 6) * 4, bit * 4 * sizeof(uint32_t));
+        __m128i init = _mm_set1_epi32(static_cast<int>(base(in, block)));
+        BlockPacker::unpackblock(packed, out, bit, init);
+    }
+
+    /**
+     * How many of the sorted block are below key, unsigned comparisons done
+     * as signed ones with the sign bits flipped.
+     */
+    static size_t countLess(const uint32_t *block, uint32_t key) {
+        const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000));
+        const __m128i K = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), flip);
+        const __m128i *pin = reinterpret_cast<const __m128i *>(block);
+        size_t count = 0;
+        for (uint32_t i = 0; i < MiniBlockSize / 4; ++i) {
+            const __m128i less = _mm_cmplt_epi32(_mm_xor_si128(_mm_load_si128(pin + i), flip), K);
+            count += _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(less)));
+        }
+        return count;
+    }
+};
+
+#endif /* SIMDINDEXEDBINARYPACKING_H_ */
@@ -0,0 +1,207 @@
+
+
+#ifndef STREAMVBYTE_H_
+#define STREAMVBYTE_H_
+
+#include "common.h"
+#include "codecs.h"
+#include "deltatemplates.h"
+#include "util.h"
+
+/**
+ * Stream VByte (Lemire, Kurz and Rupp): every integer takes 1 to 4 bytes
+ * like with VariableByte, but the lengths are kept apart as 2-bit codes,
+ * four to a control byte, ahead of the data bytes. A control byte then
+ * picks a pshufb mask from a table that spreads the next 4 integers out
+ * of the data bytes at once, there is no branch per byte. Layout:
+ *
+ *   length
+ *   (length + 3) / 4 control bytes, the code of integer i in bits
+ *   2 * (i % 4) of byte i / 4, the number of bytes minus one
+ *   the data bytes, little endian, zero padded to 32 bits
+ *
+ * DeltaHelper is one of the structs of deltatemplates.h, applied to each
+ * group of 4 integers as in SIMDBinaryPacking, NoDelta for none. No
+ * pointer needs to be aligned.
+ */
+template <class DeltaHelper>
+class StreamVByte: public IntegerCODEC {
+public:
+    static const uint32_t BlockSize = 1;
+
+    void encodeArray(uint32_t *in, const size_t length, uint32_t *out,
+                     size_t &nvalue) {
+        store(out, static_cast<uint32_t>(length));
+        uint8_t *const initbyte = reinterpret_cast<uint8_t *>(out);
+        uint8_t *control = initbyte + sizeof(uint32_t);
+        uint8_t *data = control + (length + 3) / 4;
+        __m128i prev = _mm_setzero_si128();
+        ALIGN16 uint32_t group[4];
+        for (size_t i = 0; i < length; i += 4) {
+            const size_t count = std::min<size_t>(length - i, 4);
+            memset(group, 0, sizeof(group));
+            memcpy(group, in + i, count * sizeof(uint32_t));
+            const __m128i curr = _mm_load_si128(reinterpret_cast<const __m128i *>(group));
+            _mm_store_si128(reinterpret_cast<__m128i *>(group), DeltaHelper::Delta(curr, prev));
+            prev = curr;
+            uint8_t key = 0;
+            for (size_t j = 0; j < count; ++j) {
+                const uint32_t code = (group[j] > 0xFF) + (group[j] > 0xFFFF) + (group[j] > 0xFFFFFF);
+                key |= static_cast<uint8_t>(code << (2 * j));
+                memcpy(data, &group[j], code + 1);
+                data += code + 1;
+            }
+            *control++ = key;
+        }
+        while ((data - initbyte) % 4 != 0)
+            *data++ = 0;
+        nvalue = (data - initbyte) / 4;
+    }
+
+    const uint32_t *decodeArray(const uint32_t *in, const size_t length,
+                                uint32_t *out, size_t &nvalue) {
+        if (length == 0) {
+            nvalue = 0;
+            return in;
+        }
+        const uint32_t count = load(in);
+        if (count > nvalue)
+            throw NotEnoughStorage(count);
+        const uint8_t *const initbyte = reinterpret_cast<const uint8_t *>(in);
+        const uint8_t *const control = initbyte + sizeof(uint32_t);
+        __m128i prev = _mm_setzero_si128();
+        const uint8_t *data = decode(control, control + (count + 3) / 4,
+                                     initbyte + length * sizeof(uint32_t), out, count, prev);
+        nvalue = count;
+        return in + (data - initbyte + 3) / 4;
+    }
+
+    /**
+     * Decodes 128 integers per block, 32 control bytes at a time.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        static const uint32_t BlockSize = 128;
+
+        Cursor(const uint32_t *in, const size_t length) :
+            initbyte(reinterpret_cast<const uint8_t *>(in)), control(NULL), data(NULL),
+            limit(initbyte + length * sizeof(uint32_t)), remaining(0),
+            prev(_mm_setzero_si128()) {
+            if (length == 0) {
+                data = initbyte;
+                return;
+            }
+            remaining = load(in);
+            control = initbyte + sizeof(uint32_t);
+            data = control + (remaining + 3) / 4;
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            const size_t count = std::min<size_t>(remaining, BlockSize);
+            if (count == 0)
+                return 0;
+            data = decode(control, data, limit, buffer, count, prev);
+            control += count / 4;
+            remaining -= count;
+            span = buffer;
+            return count;
+        }
+
+        const uint32_t *end() const {
+            return reinterpret_cast<const uint32_t *>(initbyte) + (data - initbyte + 3) / 4;
+        }
+
+    private:
+        const uint8_t *initbyte;
+        const uint8_t *control;
+        const uint8_t *data;
+        const uint8_t *limit;
+        size_t remaining;
+        __m128i prev;
+        ALIGN16 uint32_t buffer[BlockSize];
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
+    string name() const {
+        return string("StreamVByte+") + DeltaHelper::name();
+    }
+
+private:
+    /**
+     * For every control byte, the pshufb mask that moves the data bytes of
+     * its 4 integers into place and how many data bytes they take.
+     */
+    struct Tables {
+        ALIGN16 uint8_t shuffle[256][16];
+        uint8_t length[256];
+
+        Tables() {
+            for (uint32_t key = 0; key < 256; ++key) {
+                uint8_t offset = 0;
+                for (uint32_t j = 0; j < 4; ++j) {
+                    const uint32_t bytes = ((key >> (2 * j)) & 3) + 1;
+                    for (uint32_t k = 0; k < 4; ++k)
+                        shuffle[key][4 * j + k] = k < bytes ? offset + k : 0x80;
+                    offset += bytes;
+                }
+                length[key] = offset;
+            }
+        }
+    };
+
+    static const Tables &tables() {
+        static const Tables t;
+        return t;
+    }
+
+    static uint32_t load(const uint32_t *in) {
+        uint32_t word;
+        memcpy(&word, in, sizeof(word));
+        return word;
+    }
+
+    static void store(uint32_t *out, uint32_t word) {
+        memcpy(out, &word, sizeof(word));
+    }
+
+    /**
+     * Decodes count integers, returns the data byte after the last one.
+     * Groups whose 16-byte load could read past limit are decoded one
+     * integer at a time.
+     */
+    static const uint8_t *decode(const uint8_t *control, const uint8_t *data, const uint8_t *limit,
+                                 uint32_t *out, size_t count, __m128i &prev) {
+        const Tables &t = tables();
+        for (; count >= 4 and data + 16 <= limit; count -= 4) {
+            const uint8_t key = *control++;
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i *>(t.shuffle[key]));
+            prev = DeltaHelper::PrefixSum(_mm_shuffle_epi8(bytes, mask), prev);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), prev);
+            data += t.length[key];
+            out += 4;
+        }
+        ALIGN16 uint32_t group[4];
+        for (; count > 0; count -= std::min<size_t>(count, 4)) {
+            const uint8_t key = *control++;
+            const size_t n = std::min<size_t>(count, 4);
+            memset(group, 0, sizeof(group));
+            for (size_t j = 0; j < n; ++j) {
+                const uint32_t bytes = ((key >> (2 * j)) & 3) + 1;
+                memcpy(&group[j], data, bytes);
+                data += bytes;
+            }
+            prev = DeltaHelper::PrefixSum(_mm_load_si128(reinterpret_cast<const __m128i *>(group)), prev);
+            _mm_store_si128(reinterpret_cast<__m128i *>(group), prev);
+            memcpy(out, group, n * sizeof(uint32_t));
+            out += n;
+        }
+        return data;
+    }
+};
+
+#endif /* STREAMVBYTE_H_ */
@@ -0,0 +1,283 @@
+/**
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+
+#include "union.h"
+#include "boolarray.h"
+
+
+size_t scalarunion(const uint32_t *set1, const size_t length1,
+                   const uint32_t *set2, const size_t length2, uint32_t *out) {
+    const uint32_t *const initout(out);
+    const uint32_t *const end1 = set1 + length1;
+    const uint32_t *const end2 = set2 + length2;
+    while ((set1 != end1) and (set2 != end2)) {
+        const uint32_t v1 = *set1;
+        const uint32_t v2 = *set2;
+        if (v1 < v2) {
+            *out++ = v1;
+            ++set1;
+        } else if (v2 < v1) {
+            *out++ = v2;
+            ++set2;
+        } else {
+            *out++ = v1;
+            ++set1;
+            ++set2;
+        }
+    }
+    while (set1 != end1) *out++ = *set1++;
+    while (set2 != end2) *out++ = *set2++;
+    return out - initout;
+}
+
+
+/**
+ * Shuffle masks that pack the lanes whose bit is *not* set in the index
+ * to the front of the register.
+ */
+static const uint8_t uniqshuf32[16][16] = {
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff},
+    {0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff},
+    {0x04, 0x05, 0x06, 0x07, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xff, 0xff, 0xff},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x08, 0x09, 0x0a, 0x0b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x04, 0x05, 0x06, 0x07, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0x00, 0x01, 0x02, 0x03, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+    {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}
+};
+
+/**
+ * Merging network: given two sorted vectors, vecMin receives the 4 smallest
+ * values and vecMax the 4 largest, both sorted.
+ */
+__attribute__((always_inline))
+static inline void sse_merge32(const __m128i vInput1, const __m128i vInput2,
+                               __m128i &vecMin, __m128i &vecMax) {
+    __m128i vecTmp = _mm_min_epu32(vInput1, vInput2);
+    vecMax = _mm_max_epu32(vInput1, vInput2);
+    vecTmp = _mm_alignr_epi8(vecTmp, vecTmp, 4);
+    vecMin = _mm_min_epu32(vecTmp, vecMax);
+    vecMax = _mm_max_epu32(vecTmp, vecMax);
+    vecTmp = _mm_alignr_epi8(vecMin, vecMin, 4);
+    vecMin = _mm_min_epu32(vecTmp, vecMax);
+    vecMax = _mm_max_epu32(vecTmp, vecMax);
+    vecTmp = _mm_alignr_epi8(vecMin, vecMin, 4);
+    vecMin = _mm_min_epu32(vecTmp, vecMax);
+    vecMax = _mm_max_epu32(vecTmp, vecMax);
+    vecMin = _mm_alignr_epi8(vecMin, vecMin, 4);
+}
+
+/**
+ * Writes the values of newval that differ from their predecessor (the last
+ * lane of old for the first one). Always stores 4 integers, returns how many
+ * of them count.
+ */
+__attribute__((always_inline))
+static inline size_t store_unique32(const __m128i old, const __m128i newval, uint32_t *output) {
+    const __m128i previous = _mm_alignr_epi8(newval, old, 16 - 4);
+    const int M = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(previous, newval)));
+    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uniqshuf32[M]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_shuffle_epi8(newval, key));
+    return 4 - __builtin_popcount(M);
+}
+
+size_t SIMDunion(const uint32_t *set1, const size_t length1,
+                 const uint32_t *set2, const size_t length2, uint32_t *out) {
+    if ((length1 < 4) or (length2 < 4))
+        return scalarunion(set1, length1, set2, length2, out);
+    const uint32_t *const initout(out);
+    const size_t vlength1 = length1 / 4 * 4;
+    const size_t vlength2 = length2 / 4 * 4;
+    size_t pos1 = 4, pos2 = 4;
+
+    // anything different from the first value works as the initial predecessor
+    __m128i laststore = _mm_set1_epi32(static_cast<int>((set1[0] < set2[0] ? set1[0] : set2[0]) - 1));
+    __m128i vecMin, vecMax;
+    sse_merge32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set1)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(set2)), vecMin, vecMax);
+    out += store_unique32(laststore, vecMin, out);
+    laststore = vecMin;
+
+    while ((pos1 < vlength1) and (pos2 < vlength2)) {
+        __m128i V;
+        if (set1[pos1] <= set2[pos2]) {
+            V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set1 + pos1));
+            pos1 += 4;
+        } else {
+            V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set2 + pos2));
+            pos2 += 4;
+        }
+        sse_merge32(V, vecMax, vecMin, vecMax);
+        out += store_unique32(laststore, vecMin, out);
+        laststore = vecMin;
+    }
+
+    // Finish with a scalar merge. The side that ran out of full vectors
+    // has at most 3 values left, they go with the pending vecMax into a
+    // small sorted buffer.
+    const uint32_t lastvalue = static_cast<uint32_t>(_mm_extract_epi32(laststore, 3));
+    uint32_t buffer[16];
+    size_t leftover = store_unique32(laststore, vecMax, buffer);
+    const uint32_t *rest;
+    size_t restlength;
+    if (pos1 >= vlength1) {
+        for (; pos1 < length1; ++pos1) buffer[leftover++] = set1[pos1];
+        rest = set2 + pos2;
+        restlength = length2 - pos2;
+    } else {
+        for (; pos2 < length2; ++pos2) buffer[leftover++] = set2[pos2];
+        rest = set1 + pos1;
+        restlength = length1 - pos1;
+    }
+    sort(buffer, buffer + leftover);
+    leftover = unique(buffer, buffer + leftover) - buffer;
+    while ((restlength > 0) and (*rest == lastvalue)) {
+        ++rest;
+        --restlength;
+    }
+    out += scalarunion(buffer, leftover, rest, restlength, out);
+    return out - initout;
+}
+
+
+size_t heapmultiunion(const uint32_t **sets, const size_t *lengths,
+                      const size_t count, uint32_t *out) {
+    struct cursor {
+        uint32_t value;
+        const uint32_t *next;
+        const uint32_t *end;
+    };
+    vector<cursor> heap;
+    heap.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (lengths[i] == 0) continue;
+        cursor c = {sets[i][0], sets[i] + 1, sets[i] + lengths[i]};
+        heap.push_back(c);
+    }
+    if (heap.empty()) return 0;
+    auto greater = [](const cursor & a, const cursor & b) {
+        return a.value > b.value;
+    };
+    make_heap(heap.begin(), heap.end(), greater);
+
+    const uint32_t *const initout(out);
+    size_t heapsize = heap.size();
+    cursor *const h = heap.data();
+    while (heapsize > 0) {
+        const uint32_t v = h[0].value;
+        if (out == initout or out[-1] != v)
+            *out++ = v;
+        // replace the top instead of pop + push, one sift down per value
+        if (h[0].next == h[0].end) {
+            h[0] = h[--heapsize];
+            if (heapsize == 0) break;
+        } else {
+            h[0].value = *h[0].next++;
+        }
+        size_t i = 0;
+        while (true) {
+            size_t child = 2 * i + 1;
+            if (child >= heapsize) break;
+            if ((child + 1 < heapsize) and (h[child + 1].value < h[child].value)) ++child;
+            if (h[i].value <= h[child].value) break;
+            swap(h[i], h[child]);
+            i = child;
+        }
+    }
+    return out - initout;
+}
+
+
+size_t bitmapmultiunion(const uint32_t **sets, const size_t *lengths,
+                        const size_t count, uint32_t *out) {
+    size_t maxvalue = 0;
+    bool empty = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (lengths[i] == 0) continue;
+        empty = false;
+        if (sets[i][lengths[i] - 1] > maxvalue) maxvalue = sets[i][lengths[i] - 1];
+    }
+    if (empty) return 0;
+    BoolArray bitmap(maxvalue + 1);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t *set = sets[i];
+        for (size_t k = 0; k < lengths[i]; ++k)
+            bitmap.set(set[k]);
+    }
+    return bitmap.toInts(out);
+}
+
+
+size_t SIMDmultiunion(const uint32_t **sets, const size_t *lengths,
+                      const size_t count, uint32_t *out) {
+    if (count == 0) return 0;
+    if (count == 1) {
+        if (lengths[0] > 0) memcpy(out, sets[0], lengths[0] * sizeof(uint32_t));
+        return lengths[0];
+    }
+    if (count == 2) return SIMDunion(sets[0], lengths[0], sets[1], lengths[1], out);
+
+    size_t total = 0;
+    uint32_t maxvalue = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += lengths[i];
+        if ((lengths[i] > 0) and (sets[i][lengths[i] - 1] > maxvalue)) maxvalue = sets[i][lengths[i] - 1];
+    }
+    // same density threshold HybM2 uses to pick bitmaps
+    if (total * 32 >= static_cast<size_t>(maxvalue) + 1)
+        return bitmapmultiunion(sets, lengths, count, out);
+    if (count > 8)
+        return heapmultiunion(sets, lengths, count, out);
+
+    // Merge the two smallest lists first (as in Huffman coding) so the
+    // large lists are rewritten as few times as possible.
+    struct sizedlist {
+        size_t length;
+        const uint32_t *data;
+        shared_ptr<vector<uint32_t>> buffer; // set for intermediate results
+    };
+    auto larger = [](const sizedlist & a, const sizedlist & b) {
+        return a.length > b.length;
+    };
+    vector<sizedlist> queue;
+    for (size_t i = 0; i < count; ++i) {
+        sizedlist input = {lengths[i], sets[i], shared_ptr<vector<uint32_t>>()};
+        queue.push_back(input);
+    }
+    make_heap(queue.begin(), queue.end(), larger);
+    while (queue.size() > 2) {
+        pop_heap(queue.begin(), queue.end(), larger);
+        sizedlist a = queue.back();
+        queue.pop_back();
+        pop_heap(queue.begin(), queue.end(), larger);
+        sizedlist b = queue.back();
+        queue.pop_back();
+        sizedlist merged = {0, NULL, shared_ptr<vector<uint32_t>>(new vector<uint32_t>(a.length + b.length))};
+        merged.length = SIMDunion(a.data, a.length, b.data, b.length, merged.buffer->data());
+        merged.data = merged.buffer->data();
+        queue.push_back(merged);
+        push_heap(queue.begin(), queue.end(), larger);
+    }
+    return SIMDunion(queue[0].data, queue[0].length, queue[1].data, queue[1].length, out);
+}
+
+inline std::map<std::string, unionfunction> initializeunionfactory() {
+    std::map<std::string, unionfunction> schemes;
+    schemes[ "simd" ] = SIMDunion;
+    schemes[ "scalar" ] = scalarunion;
+
+    return schemes;
+}
+
+std::map<std::string, unionfunction> UnionFactory::union_schemes = initializeunionfactory();
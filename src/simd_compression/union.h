@@ -0,0 +1,110 @@
+
+
+#ifndef UNION_H_
+#define UNION_H_
+
+#include "common.h"
+
+using namespace std;
+/*
+ * Given two sorted arrays without duplicates, this writes the union to out.
+ * Returns the cardinality of the union. out must have room for
+ * length1 + length2 integers.
+ */
+typedef size_t (*unionfunction)(const uint32_t *set1,
+                                const size_t length1, const uint32_t *set2, const size_t length2, uint32_t *out);
+
+/*
+ * Given count sorted arrays without duplicates, this writes the union to out.
+ * Returns the cardinality of the union. out must have room for the sum of
+ * the lengths.
+ */
+typedef size_t (*multiunionfunction)(const uint32_t **sets,
+                                     const size_t *lengths, const size_t count, uint32_t *out);
+
+
+/*
+ * Given two arrays, this writes the union to out. Returns the
+ * cardinality of the union.
+ *
+ * Plain merge, one comparison per output value.
+ */
+size_t scalarunion(const uint32_t *set1, const size_t length1,
+                   const uint32_t *set2, const size_t length2, uint32_t *out);
+
+/*
+ * Given two arrays, this writes the union to out. Returns the
+ * cardinality of the union.
+ *
+ * Vectorized merge: blocks of 4 integers go through a min/max merging
+ * network and duplicates are squeezed out with a shuffle before storing.
+ * Adapted from the 16-bit version used by Roaring bitmaps (D. Lemire et al.).
+ */
+size_t SIMDunion(const uint32_t *set1, const size_t length1,
+                 const uint32_t *set2, const size_t length2, uint32_t *out);
+
+/*
+ * k-way merge of many arrays through a binary min-heap of cursors. Costs
+ * log(count) comparisons per input integer regardless of the list sizes.
+ */
+size_t heapmultiunion(const uint32_t **sets, const size_t *lengths,
+                      const size_t count, uint32_t *out);
+
+/*
+ * Sets every integer in a bitmap spanning the largest value, then
+ * writes the set bits back out. Wins when the lists are dense.
+ */
+size_t bitmapmultiunion(const uint32_t **sets, const size_t *lengths,
+                        const size_t count, uint32_t *out);
+
+/*
+ * Our main heuristic: bitmap when the lists are dense, pairwise SIMD
+ * unions (smallest lists first) for a handful of lists and the heap merge
+ * beyond that.
+ */
+size_t SIMDmultiunion(const uint32_t **sets, const size_t *lengths,
+                      const size_t count, uint32_t *out);
+
+
+
+class UnionFactory {
+public:
+    static std::map<std::string, unionfunction> union_schemes;
+
+    static vector<string> allNames() {
+        vector <string> ans;
+        for (auto i = union_schemes.begin(); i != union_schemes.end(); ++i) {
+            ans.push_back(i->first);
+        }
+        return ans;
+    }
+
+    static string getName(unionfunction  v) {
+        for (auto i = union_schemes.begin(); i != union_schemes.end() ; ++i) {
+            if (i->second == v)
+                return i->first;
+        }
+        return "UNKNOWN";
+    }
+
+    static bool valid(string name) {
+        return (union_schemes.find(name) != union_schemes.end()) ;
+    }
+
+    static unionfunction  getFromName(string name) {
+        if (union_schemes.find(name) == union_schemes.end()) {
+            cerr << "name " << name << " does not refer to a union procedure." << endl;
+            cerr << "possible choices:" << endl;
+            for (auto i = union_schemes.begin(); i != union_schemes.end(); ++i) {
+                cerr << static_cast<string>(i->first) << endl; // useless cast, but just to be clear
+            }
+            return NULL;
+        }
+        return union_schemes[name];
+    }
+
+};
+
+
+
+#endif /* UNION_H_ */
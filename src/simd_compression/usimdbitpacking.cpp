@@ -8,6 +8,8 @@
 
 using namespace std;
 
+void __uSIMD_fastpackwithoutmask0(const uint32_t   *__restrict__ , __m128i   *__restrict__) {}
+void __uSIMD_fastpack0(const uint32_t   *__restrict__ , __m128i   *__restrict__) {}
 /**
  * This is generated from simdbitpacking.cpp by replacing _mm_load_si128 with _mm_loadu_si128
  * and _mm_storeu_si128 by _mm_storeu_si128.
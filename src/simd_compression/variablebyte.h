@@ -102,6 +102,66 @@ public:
         return reinterpret_cast<const uint32_t *>(inbyte);
     }
 
+    /**
+     * Decodes up to 128 integers per block, the byte position and the
+     * running sum for delta are kept between blocks. The stream needs no
+     * alignment.
+     */
+    class Cursor: public IntegerCursor {
+    public:
+        static const uint32_t BlockSize = 128;
+
+        Cursor() :
+            initbyte(NULL), inbyte(NULL), endbyte(NULL), prev(0) {
+        }
+
+        Cursor(const uint32_t *in, const size_t length) {
+            reset(in, length);
+        }
+
+        void reset(const uint32_t *in, const size_t length) {
+            initbyte = inbyte = reinterpret_cast<const uint8_t *>(in);
+            endbyte = reinterpret_cast<const uint8_t *>(in + length);
+            prev = 0;
+        }
+
+        size_t nextBlock(const uint32_t *&span) {
+            uint32_t *out = buffer;
+            while (endbyte > inbyte and out < buffer + BlockSize) {
+                unsigned int shift = 0;
+                for (uint32_t v = 0; endbyte > inbyte; shift += 7) {
+                    uint8_t c = *inbyte++;
+                    v += ((c & 127) << shift);
+                    if ((c & 128)) {
+                        *out++ = delta ? (prev = v + prev) : v;
+                        break;
+                    }
+                }
+            }
+            span = buffer;
+            return out - buffer;
+        }
+
+        const uint32_t *end() const {
+            // padded to 32 bits from the start of the stream, which might
+            // not itself be aligned
+            return reinterpret_cast<const uint32_t *>(initbyte)
+                   + (inbyte - initbyte + 3) / 4;
+        }
+
+    private:
+        const uint8_t *initbyte;
+        const uint8_t *inbyte;
+        const uint8_t *endbyte;
+        uint32_t prev;
+        ALIGN16 uint32_t buffer[BlockSize];
+    };
+
+    unique_ptr<IntegerCursor> newCursor(const uint32_t *in, const size_t length,
+                                        const size_t /*expected*/) {
+        return unique_ptr<IntegerCursor>(new Cursor(in, length));
+    }
+
     string name() const {
         if (delta)
             return "VariableByteDelta";
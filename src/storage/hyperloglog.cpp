@@ -0,0 +1,248 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "hyperloglog.h"
+
+namespace hellcat {
+    namespace storage {
+        
+        static const size_t header_size = 2 * sizeof(uint8_t) + sizeof(uint32_t);
+        
+        static inline void locate(uint64_t hash, uint8_t bits, uint32_t* index, uint8_t* rank)
+        {
+            // The top bits pick the register, the rest give the rank: the
+            // position of their first 1 bit.
+            *index = static_cast<uint32_t>(hash >> (64 - bits));
+            uint64_t rest = hash << bits | static_cast<uint64_t>(1) << (bits - 1);
+            *rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        }
+        
+        HyperLogLog::HyperLogLog(uint8_t precision)
+        {
+            this->bits = precision < 4 ? 4 : (precision > 18 ? 18 : precision);
+            this->registers.assign(static_cast<size_t>(1) << this->bits, 0);
+        }
+        
+        HyperLogLog::~HyperLogLog()
+        {
+        }
+        
+        uint64_t HyperLogLog::hash(const void* data, size_t length)
+        {
+            // MurmurHash64A by Austin Appleby.
+            const uint64_t m = 0xc6a4a7935bd1e995ULL;
+            const int r = 47;
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            uint64_t h = 0x8445d61a4e774912ULL ^ (length * m);
+            
+            const uint8_t* end = bytes + length / 8 * 8;
+            for (; bytes != end; bytes += 8)
+            {
+                uint64_t k;
+                memcpy(&k, bytes, sizeof(k));
+                k *= m;
+                k ^= k >> r;
+                k *= m;
+                h ^= k;
+                h *= m;
+            }
+            switch (length & 7)
+            {
+                case 7: h ^= static_cast<uint64_t>(bytes[6]) << 48;
+                case 6: h ^= static_cast<uint64_t>(bytes[5]) << 40;
+                case 5: h ^= static_cast<uint64_t>(bytes[4]) << 32;
+                case 4: h ^= static_cast<uint64_t>(bytes[3]) << 24;
+                case 3: h ^= static_cast<uint64_t>(bytes[2]) << 16;
+                case 2: h ^= static_cast<uint64_t>(bytes[1]) << 8;
+                case 1: h ^= static_cast<uint64_t>(bytes[0]);
+                    h *= m;
+            }
+            h ^= h >> r;
+            h *= m;
+            h ^= h >> r;
+            return h;
+        }
+        
+        bool HyperLogLog::add(uint64_t hash)
+        {
+            uint32_t index;
+            uint8_t rank;
+            locate(hash, this->bits, &index, &rank);
+            if (this->registers[index] >= rank)
+            {
+                return false;
+            }
+            this->registers[index] = rank;
+            return true;
+        }
+        
+        bool HyperLogLog::merge(const HyperLogLog& other)
+        {
+            if (other.bits != this->bits)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < this->registers.size(); i++)
+            {
+                this->registers[i] = std::max(this->registers[i], other.registers[i]);
+            }
+            return true;
+        }
+        
+        uint64_t HyperLogLog::estimate() const
+        {
+            double m = static_cast<double>(this->registers.size());
+            double alpha = 0.7213 / (1.0 + 1.079 / m);
+            double sum = 0;
+            size_t zeros = 0;
+            for (uint8_t value : this->registers)
+            {
+                sum += ldexp(1.0, -value);
+                if (value == 0)
+                {
+                    zeros++;
+                }
+            }
+            double estimate = alpha * m * m / sum;
+            
+            // Linear counting is more accurate while many registers are
+            // still empty.
+            if (estimate <= 2.5 * m && zeros > 0)
+            {
+                estimate = m * log(m / zeros);
+            }
+            return static_cast<uint64_t>(estimate + 0.5);
+        }
+        
+        uint8_t HyperLogLog::precision() const
+        {
+            return this->bits;
+        }
+        
+        size_t HyperLogLog::sparse_count() const
+        {
+            return this->registers.size() - std::count(this->registers.begin(), this->registers.end(), 0);
+        }
+        
+        size_t HyperLogLog::serialized_size() const
+        {
+            size_t count = sparse_count();
+            if (count * sizeof(uint32_t) * 4 < this->registers.size())
+            {
+                return header_size + count * sizeof(uint32_t);
+            }
+            return header_size + this->registers.size();
+        }
+        
+        void HyperLogLog::write(uint8_t* out) const
+        {
+            uint32_t count = static_cast<uint32_t>(sparse_count());
+            bool dense = count * sizeof(uint32_t) * 4 >= this->registers.size();
+            out[0] = this->bits;
+            out[1] = dense ? 1 : 0;
+            out += 2 * sizeof(uint8_t);
+            if (dense)
+            {
+                count = static_cast<uint32_t>(this->registers.size());
+                memcpy(out, &count, sizeof(count));
+                memcpy(out + sizeof(count), this->registers.data(), this->registers.size());
+                return;
+            }
+            memcpy(out, &count, sizeof(count));
+            out += sizeof(count);
+            for (uint32_t i = 0; i < this->registers.size(); i++)
+            {
+                if (this->registers[i] != 0)
+                {
+                    uint32_t entry = i << 8 | this->registers[i];
+                    memcpy(out, &entry, sizeof(entry));
+                    out += sizeof(entry);
+                }
+            }
+        }
+        
+        bool HyperLogLog::read(const void* in, size_t length)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(in);
+            if (length < header_size)
+            {
+                return false;
+            }
+            uint32_t count;
+            memcpy(&count, bytes + 2, sizeof(count));
+            *this = HyperLogLog(bytes[0]);
+            if (this->bits != bytes[0])
+            {
+                return false;
+            }
+            if (bytes[1] == 1)
+            {
+                if (count != this->registers.size() || length < header_size + count)
+                {
+                    return false;
+                }
+                memcpy(this->registers.data(), bytes + header_size, count);
+                return true;
+            }
+            if (length < header_size + count * sizeof(uint32_t))
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t entry;
+                memcpy(&entry, bytes + header_size + i * sizeof(entry), sizeof(entry));
+                if ((entry >> 8) < this->registers.size())
+                {
+                    this->registers[entry >> 8] = static_cast<uint8_t>(entry);
+                }
+            }
+            return true;
+        }
+        
+        bool HyperLogLog::covers(const void* in, size_t length, uint64_t hash)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(in);
+            if (length < header_size)
+            {
+                return false;
+            }
+            uint32_t index;
+            uint8_t rank;
+            uint32_t count;
+            locate(hash, bytes[0], &index, &rank);
+            memcpy(&count, bytes + 2, sizeof(count));
+            if (bytes[1] == 1)
+            {
+                return index < count && length >= header_size + count && bytes[header_size + index] >= rank;
+            }
+            
+            // Binary search of the sorted sparse entries.
+            size_t low = 0;
+            size_t high = count;
+            if (length < header_size + count * sizeof(uint32_t))
+            {
+                return false;
+            }
+            while (low < high)
+            {
+                size_t middle = (low + high) / 2;
+                uint32_t entry;
+                memcpy(&entry, bytes + header_size + middle * sizeof(entry), sizeof(entry));
+                if ((entry >> 8) < index)
+                {
+                    low = middle + 1;
+                }
+                else if ((entry >> 8) > index)
+                {
+                    high = middle;
+                }
+                else
+                {
+                    return static_cast<uint8_t>(entry) >= rank;
+                }
+            }
+            return false;
+        }
+    }
+}
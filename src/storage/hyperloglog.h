@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace hellcat {
+    namespace storage {
+        
+        // HyperLogLog distinct count sketch (Flajolet et al.) with 2^precision
+        // one byte registers, standard error about 1.04 / sqrt(2^precision).
+        // Sketches of the same precision merge by taking the register maxima.
+        //
+        // Serialized sketches are sparse, a sorted list of the non-zero
+        // registers, until that gets bigger than a quarter of the dense
+        // array:
+        //
+        //   [precision][0][count][(index << 8 | value)...]   sparse
+        //   [precision][1][registers...]                     dense
+        class HyperLogLog
+        {
+        public:
+            HyperLogLog(uint8_t precision = 14);
+            ~HyperLogLog();
+            
+            static uint64_t hash(const void* data, size_t length);
+            
+            // True if a register grew, i.e. the sketch has to be written back.
+            bool add(uint64_t hash);
+            
+            // False if the precisions differ.
+            bool merge(const HyperLogLog& other);
+            
+            uint64_t estimate() const;
+            uint8_t precision() const;
+            
+            size_t serialized_size() const;
+            void write(uint8_t* out) const;
+            bool read(const void* in, size_t length);
+            
+            // True if adding hash to the serialized sketch wouldn't change
+            // it, checked without reading the whole sketch.
+            static bool covers(const void* in, size_t length, uint64_t hash);
+        private:
+            uint8_t bits;
+            std::vector<uint8_t> registers;
+            
+            size_t sparse_count() const;
+        };
+    }
+}
@@ -5,10 +5,12 @@
 #include "lmdb.h"
 #include "../string_ref.h"
 #include "../hellcat.h"
+#include "hyperloglog.h"
 #include "lmdb_store.h"
 #include "transaction.h"
 
 typedef map<string, MDB_dbi> keyspace_map;
+typedef map<string, vector<hellcat::storage::ValueIndex*>> index_map;
 
 namespace hellcat {
     namespace storage {
@@ -16,6 +18,7 @@ namespace hellcat {
         LMDBStore::LMDBStore()
         {
             keyspaces = unique_ptr<keyspace_map>(new keyspace_map());
+            indexes = unique_ptr<index_map>(new index_map());
         }
         
         LMDBStore::~LMDBStore()
@@ -34,6 +37,7 @@ namespace hellcat {
             MDB_txn *txn;
             rc = mdb_txn_begin(env, NULL, 0, &txn);
             rc = mdb_open(txn, NULL, 0, &dbi);
+            rc = mdb_open(txn, "$sketches", MDB_CREATE, &sketches);
             rc = mdb_txn_commit(txn);
             
             return HCAT_SUCCESS;
@@ -49,6 +53,7 @@ namespace hellcat {
         {
             lmdb_transaction_context* context = (lmdb_transaction_context*)transaction_context;
             int rc = mdb_txn_commit(context->transaction);
+            close_keyspaces(context->transaction, rc == 0);
             return (rc == 0 ? HCAT_SUCCESS : HCAT_FAIL);
         }
         
@@ -56,6 +61,7 @@ namespace hellcat {
         {
             lmdb_transaction_context* context = (lmdb_transaction_context*)transaction_context;
             mdb_txn_abort(context->transaction);
+            close_keyspaces(context->transaction, false);
             return HCAT_SUCCESS;
         }
         
@@ -67,19 +73,10 @@ namespace hellcat {
             MDB_dbi db_instance = dbi;
             if (pair->keyspace.length() > 0)
             {
-                db_instance = keyspaces->operator[](pair->keyspace.data());
-            
-                if (db_instance == NULL)
+                rc = open_keyspace(context, pair->keyspace, &db_instance);
+                if (rc != MDB_SUCCESS)
                 {
-                    rc = mdb_dbi_open(context->transaction, pair->keyspace.data(), MDB_CREATE, &db_instance);
-                    if (rc == MDB_SUCCESS)
-                    {
-                        keyspaces->operator[](pair->keyspace.data()) = db_instance;
-                    }
-                    else
-                    {
-                        // TODO: Return an error.
-                    }
+                    // TODO: Return an error.
                 }
             }
 
@@ -88,14 +85,161 @@ namespace hellcat {
             
             mdb_key.mv_size = pair->key.length() + 1;
             mdb_key.mv_data = (void*)pair->key.data();
+            
+            // Indexed keyspaces need the value being replaced, copy it before
+            // the put reuses its page.
+            index_map::iterator keyspace_indexes = indexes->end();
+            bool replaced = false;
+            string previous;
+            if (pair->keyspace.length() > 0)
+            {
+                keyspace_indexes = indexes->find(pair->keyspace.str());
+            }
+            if (keyspace_indexes != indexes->end())
+            {
+                rc = mdb_get(context->transaction, db_instance, &mdb_key, &mdb_value);
+                if (rc == MDB_SUCCESS)
+                {
+                    replaced = true;
+                    previous.assign((char*)mdb_value.mv_data, mdb_value.mv_size - 1);
+                }
+            }
+            
             mdb_value.mv_size = pair->value_length + 1;
             mdb_value.mv_data = pair->value;
             
             rc = mdb_put(context->transaction, db_instance, &mdb_key, &mdb_value, 0);
+            
+            // Keys starting with $ are bookkeeping of the indexes living in
+            // the keyspace, not records, and stay out of the cardinality.
+            if (rc == 0 && (pair->key.empty() || pair->key[0] != '$'))
+            {
+                update_sketch(context, pair->keyspace, pair->key);
+            }
+            
+            if (rc == 0 && keyspace_indexes != indexes->end())
+            {
+                for (ValueIndex* index : keyspace_indexes->second)
+                {
+                    index->update(pair, replaced ? previous.data() : NULL, (uint32_t)previous.size(), context->owner);
+                }
+            }
 
             return (rc == 0 ? HCAT_SUCCESS : HCAT_FAIL);
         }
         
+        int LMDBStore::open_keyspace(lmdb_transaction_context* context, std::string_ref keyspace, MDB_dbi* db_instance)
+        {
+            // Transactions run on several threads (writers, the segment
+            // merger, readers) and LMDB wants handles opened by one at a time.
+            lock_guard<mutex> lock(keyspaces_lock);
+            string name = keyspace.str();
+            keyspace_map::iterator existing = keyspaces->find(name);
+            if (existing != keyspaces->end())
+            {
+                *db_instance = existing->second;
+                return MDB_SUCCESS;
+            }
+            keyspace_map& opened = opened_keyspaces[context->transaction];
+            existing = opened.find(name);
+            if (existing != opened.end())
+            {
+                *db_instance = existing->second;
+                return MDB_SUCCESS;
+            }
+            int rc = mdb_dbi_open(context->transaction, name.c_str(), MDB_CREATE, db_instance);
+            if (rc == MDB_SUCCESS)
+            {
+                opened[name] = *db_instance;
+            }
+            return rc;
+        }
+        
+        void LMDBStore::close_keyspaces(MDB_txn* transaction, bool committed)
+        {
+            // LMDB closes the handles of a transaction that doesn't commit.
+            lock_guard<mutex> lock(keyspaces_lock);
+            map<MDB_txn*, keyspace_map>::iterator opened = opened_keyspaces.find(transaction);
+            if (opened == opened_keyspaces.end())
+            {
+                return;
+            }
+            if (committed)
+            {
+                keyspaces->insert(opened->second.begin(), opened->second.end());
+            }
+            opened_keyspaces.erase(opened);
+        }
+        
+        void LMDBStore::update_sketch(lmdb_transaction_context* context, std::string_ref keyspace, std::string_ref key)
+        {
+            // One HyperLogLog of the keys per keyspace, in the $sketches
+            // database under the keyspace name. Once it has warmed up most
+            // keys don't raise a register and the sketch is only read.
+            string name = keyspace.str();
+            uint64_t hash = HyperLogLog::hash(key.data(), key.length());
+            MDB_val mdb_key;
+            MDB_val mdb_value;
+            mdb_key.mv_size = name.length() + 1;
+            mdb_key.mv_data = (void*)name.c_str();
+            
+            HyperLogLog sketch;
+            int rc = mdb_get(context->transaction, sketches, &mdb_key, &mdb_value);
+            if (rc == MDB_SUCCESS)
+            {
+                if (HyperLogLog::covers(mdb_value.mv_data, mdb_value.mv_size, hash))
+                {
+                    return;
+                }
+                sketch.read(mdb_value.mv_data, mdb_value.mv_size);
+            }
+            sketch.add(hash);
+            
+            vector<uint8_t> value(sketch.serialized_size());
+            sketch.write(value.data());
+            mdb_value.mv_size = value.size();
+            mdb_value.mv_data = value.data();
+            mdb_put(context->transaction, sketches, &mdb_key, &mdb_value, 0);
+        }
+        
+        int LMDBStore::cardinality(std::string_ref keyspace, uint64_t* estimate)
+        {
+            string name = keyspace.str();
+            MDB_val mdb_key;
+            MDB_val mdb_value;
+            mdb_key.mv_size = name.length() + 1;
+            mdb_key.mv_data = (void*)name.c_str();
+            
+            *estimate = 0;
+            MDB_txn* txn;
+            if (mdb_txn_begin(env, NULL, MDB_RDONLY, &txn) != MDB_SUCCESS)
+            {
+                return HCAT_FAIL;
+            }
+            int return_code = HCAT_SUCCESS;
+            HyperLogLog sketch;
+            int rc = mdb_get(txn, sketches, &mdb_key, &mdb_value);
+            if (rc == MDB_NOTFOUND)
+            {
+                return_code = HCAT_KEYSPACENOTFOUND;
+            }
+            else if (rc != MDB_SUCCESS || !sketch.read(mdb_value.mv_data, mdb_value.mv_size))
+            {
+                return_code = HCAT_FAIL;
+            }
+            else
+            {
+                *estimate = sketch.estimate();
+            }
+            mdb_txn_abort(txn);
+            return return_code;
+        }
+        
+        void LMDBStore::add_index(std::string_ref keyspace, ValueIndex* index)
+        {
+            indexes->operator[](keyspace.str()).push_back(index);
+        }
+        
         int LMDBStore::get(hcat_keypair* pair, void* transaction_context)
         {
             int rc;
@@ -104,14 +248,8 @@ namespace hellcat {
             MDB_dbi db_instance = dbi;
             if (pair->keyspace.length() > 0)
             {
-                db_instance = keyspaces->operator[](pair->keyspace.data());
-
-                rc = mdb_dbi_open(context->transaction, pair->keyspace.data(), MDB_CREATE, &db_instance);
-                if (rc == MDB_SUCCESS)
-                {
-                    keyspaces->operator[](pair->keyspace.data()) = db_instance;
-                }
-                else
+                rc = open_keyspace(context, pair->keyspace, &db_instance);
+                if (rc != MDB_SUCCESS)
                 {
                     // TODO: Return an error.
                 }
@@ -176,6 +314,45 @@ namespace hellcat {
             return return_code;
         }
         
+        int LMDBStore::scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit, void* transaction_context)
+        {
+            lmdb_transaction_context* context = (lmdb_transaction_context*)transaction_context;
+
+            MDB_dbi db_instance = dbi;
+            if (pair->keyspace.length() > 0 && open_keyspace(context, pair->keyspace, &db_instance) != MDB_SUCCESS)
+            {
+                return HCAT_KEYSPACENOTFOUND;
+            }
+
+            MDB_cursor* cursor;
+            if (mdb_cursor_open(context->transaction, db_instance, &cursor) != MDB_SUCCESS)
+            {
+                return HCAT_FAIL;
+            }
+            
+            // Stored keys end with the zero set adds, the key without it sorts
+            // right before them. An empty key can't be sought, it starts at
+            // the first pair.
+            MDB_val mdb_key;
+            MDB_val mdb_value;
+            mdb_key.mv_size = pair->key.length();
+            mdb_key.mv_data = (void*)pair->key.data();
+            int rc = mdb_cursor_get(cursor, &mdb_key, &mdb_value, pair->key.empty() ? MDB_FIRST : MDB_SET_RANGE);
+            while (rc == MDB_SUCCESS)
+            {
+                pair->key = string_ref((const char*)mdb_key.mv_data, mdb_key.mv_size - 1);
+                pair->value = mdb_value.mv_data;
+                pair->value_length = mdb_value.mv_size;
+                if (!visit(pair))
+                {
+                    break;
+                }
+                rc = mdb_cursor_get(cursor, &mdb_key, &mdb_value, MDB_NEXT);
+            }
+            mdb_cursor_close(cursor);
+            return HCAT_SUCCESS;
+        }
+        
         int LMDBStore::begin_transaction(hcat_transaction** tx, int read_only)
         {
             int rc;
@@ -193,6 +370,7 @@ namespace hellcat {
             lmdb_transaction_context* context = new lmdb_transaction_context();
             context->transaction = txn;
             Transaction* trans = new Transaction(this, context);
+            context->owner = trans;
             *tx = trans;
             
             return HCAT_SUCCESS;
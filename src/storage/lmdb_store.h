@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
 #include <map>
+#include <mutex>
+#include <vector>
 #include "lmdb.h"
 #include "../hellcat.h"
 #include "store.h"
@@ -13,6 +15,8 @@ namespace hellcat {
         typedef struct
         {
             MDB_txn* transaction;
+            // The transaction handed out for it, value indexes update in it.
+            hcat_transaction* owner;
         } lmdb_transaction_context;
         
         class LMDBStore : public Store
@@ -24,14 +28,27 @@ namespace hellcat {
             void close();
             int get(hcat_keypair* pair, void* transaction_context);
             int set(hcat_keypair* pair, void* transaction_context);
+            int scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit, void* transaction_context);
             int begin_transaction(hcat_transaction** transaction, int read_only);
             int commit_transaction(void* transaction_context);
             int abort_transaction(void* transaction_context);
             int sync();
+            void add_index(std::string_ref keyspace, ValueIndex* index);
+            int cardinality(std::string_ref keyspace, uint64_t* estimate);
         private:
             MDB_env* env;
             MDB_dbi dbi;
+            MDB_dbi sketches;
             unique_ptr<map<string, MDB_dbi>> keyspaces;
+            // Handles only outlive the transaction that opened them if it
+            // commits, until then they are kept apart.
+            map<MDB_txn*, map<string, MDB_dbi>> opened_keyspaces;
+            mutex keyspaces_lock;
+            unique_ptr<map<string, vector<ValueIndex*>>> indexes;
+            
+            int open_keyspace(lmdb_transaction_context* context, std::string_ref keyspace, MDB_dbi* db_instance);
+            void close_keyspaces(MDB_txn* transaction, bool committed);
+            void update_sketch(lmdb_transaction_context* context, std::string_ref keyspace, std::string_ref key);
         };
         
     }
@@ -4,6 +4,16 @@
 namespace hellcat {
     namespace storage {
         
+        // Keeps something derived from the values of a keyspace up to date.
+        // Called after every set in the keyspace with the value it replaced,
+        // NULL if there was none, inside the writing transaction.
+        class ValueIndex
+        {
+        public:
+            virtual ~ValueIndex() { };
+            virtual void update(hcat_keypair* pair, const void* previous_value, uint32_t previous_length, hcat_transaction* tx) = 0;
+        };
+        
         class Store
         {
         public:
@@ -11,10 +21,16 @@ namespace hellcat {
             virtual void close() = 0;
             virtual int get(hcat_keypair* pair, void* transaction_context) = 0;
             virtual int set(hcat_keypair* pair, void* transaction_context) = 0;
+            virtual int scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit, void* transaction_context) = 0;
             virtual int begin_transaction(hcat_transaction** tx, int read_only) = 0;
             virtual int commit_transaction(void* transaction_context) = 0;
             virtual int abort_transaction(void* transaction_context) = 0;
             virtual int sync() = 0;
+            virtual void add_index(std::string_ref keyspace, ValueIndex* index) = 0;
+            
+            // Estimated number of distinct keys ever set in the keyspace, read
+            // in a transaction of its own. Keys starting with $ aren't counted.
+            virtual int cardinality(std::string_ref keyspace, uint64_t* estimate) = 0;
         };
     }
 }
\ No newline at end of file
@@ -7,26 +7,52 @@
 namespace hellcat {
     namespace storage {
         
-        Transaction::Transaction(Store* store, void* transaction_context)
+        Transaction::Transaction(Store* store, void* transaction_context, bool owns_context)
         {
             this->store = store;
             this->transaction_context = transaction_context;
+            this->owns_context = owns_context;
         }
         
         Transaction::~Transaction()
         {
-            free(this->transaction_context);
+            if (this->owns_context)
+            {
+                free(this->transaction_context);
+            }
         }
         
         int Transaction::commit()
         {
-            this->store->commit_transaction(this->transaction_context);
-            return HCAT_SUCCESS;
+            // A listener may still write and add listeners while committing.
+            for (size_t i = 0; i < this->listeners.size(); i++)
+            {
+                this->listeners[i]->committing(this);
+            }
+            int rc = this->store->commit_transaction(this->transaction_context);
+            for (auto listener : this->listeners)
+            {
+                if (rc == HCAT_SUCCESS)
+                {
+                    listener->committed(this);
+                }
+                else
+                {
+                    listener->aborted(this);
+                }
+            }
+            this->listeners.clear();
+            return rc;
         }
         
         int Transaction::abort()
         {
             this->store->abort_transaction(this->transaction_context);
+            for (auto listener : this->listeners)
+            {
+                listener->aborted(this);
+            }
+            this->listeners.clear();
             return HCAT_SUCCESS;
         }
         
@@ -41,5 +67,22 @@ namespace hellcat {
             this->store->set(pair, this->transaction_context);
             return HCAT_SUCCESS;
         }
+        
+        int Transaction::scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit)
+        {
+            return this->store->scan(pair, visit, this->transaction_context);
+        }
+        
+        void Transaction::add_listener(hcat_transaction_listener* listener)
+        {
+            for (auto added : this->listeners)
+            {
+                if (added == listener)
+                {
+                    return;
+                }
+            }
+            this->listeners.push_back(listener);
+        }
     }
 }
\ No newline at end of file
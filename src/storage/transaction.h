@@ -1,5 +1,6 @@
 #pragma once
 #include <stdlib.h>
+#include <vector>
 #include "store.h"
 
 namespace hellcat {
@@ -8,16 +9,20 @@ namespace hellcat {
         class Transaction : public hcat_transaction
         {
         public:
-            Transaction(Store* store, void* transaction_context);
+            Transaction(Store* store, void* transaction_context, bool owns_context = true);
             ~Transaction();
             int commit();
             int abort();
             int get(hcat_keypair* pair);
             int set(hcat_keypair* pair);
+            int scan(hcat_keypair* pair, std::function<bool(hcat_keypair* pair)> visit);
+            void add_listener(hcat_transaction_listener* listener);
             
         private:
             Store* store;
             void* transaction_context;
+            bool owns_context;
+            std::vector<hcat_transaction_listener*> listeners;
         };
         
     }
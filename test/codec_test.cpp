@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/simd_compression/codecfactory.h"
+#include "../src/simd_compression/fusedintersection.h"
+#include "../src/simd_compression/intersection.h"
+#include "../src/simd_compression/postingcursor.h"
+#include "../src/indexing/ranked_postings.h"
+
+using namespace std;
+using namespace hellcat::indexing;
+
+static int failures = 0;
+
+static void check(bool condition, const string& message)
+{
+    if (!condition)
+    {
+        cerr << "FAILED: " << message << endl;
+        failures++;
+    }
+}
+
+// Lengths around the 128 integer blocks most codecs use, and long enough
+// for several of them.
+static const size_t lengths[] = { 1, 127, 128, 129, 255, 256, 257, 1000, 5000 };
+
+// Sorted distinct integers, mostly small gaps with a few large jumps so
+// blocks need different bit widths.
+static vector<uint32_t> sorted_integers(size_t length, mt19937& random)
+{
+    vector<uint32_t> integers(length);
+    uint32_t value = random() % 100;
+    for (size_t i = 0; i < length; i++)
+    {
+        integers[i] = value;
+        value += 1 + (random() % 16 == 0 ? random() % 100000 : random() % 8);
+    }
+    return integers;
+}
+
+static void codec_round_trips()
+{
+    mt19937 random(1);
+    for (auto& name : CODECFactory::allNames())
+    {
+        IntegerCODEC& codec = *CODECFactory::getFromName(name);
+        for (size_t length : lengths)
+        {
+            vector<uint32_t> integers = sorted_integers(length, random);
+            string label = name + " with " + to_string(length) + " integers";
+
+            // Some codecs change their input while encoding.
+            vector<uint32_t> input(integers);
+            vector<uint32_t> compressed(2 * length + 1024);
+            size_t words = compressed.size();
+            codec.encodeArray(input.data(), length, compressed.data(), words);
+            compressed.resize(words);
+
+            vector<uint32_t> decoded(length + 1024);
+            size_t count = decoded.size();
+            codec.decodeArray(compressed.data(), words, decoded.data(), count);
+            decoded.resize(count);
+            check(decoded == integers, label + " round trips");
+
+            vector<uint32_t> walked;
+            PostingCursor cursor(codec, compressed.data(), words, length);
+            for (; cursor.valid(); cursor.next())
+            {
+                walked.push_back(cursor.value());
+            }
+            check(walked == integers, label + " walked by a cursor");
+
+            // Targets on both sides of every block edge, each from a new
+            // cursor and all of them in order from one cursor.
+            PostingCursor forward(codec, compressed.data(), words, length);
+            uint32_t next_target = 0;
+            for (size_t i = 0; i < length; i += (i % 128 == 0 || i % 128 == 127) ? 1 : 63)
+            {
+                for (uint32_t target = max(next_target, integers[i] == 0 ? 0 : integers[i] - 1); target <= integers[i] + 1; target++)
+                {
+                    next_target = target;
+                    auto expected = lower_bound(integers.begin(), integers.end(), target);
+                    PostingCursor fresh(codec, compressed.data(), words, length);
+                    fresh.advance(target);
+                    check(expected == integers.end() ? !fresh.valid() : fresh.valid() && fresh.value() == *expected,
+                          label + ", advance to " + to_string(target));
+                    forward.advance(target);
+                    check(expected == integers.end() ? !forward.valid() : forward.valid() && forward.value() == *expected,
+                          label + ", advance in order to " + to_string(target));
+                }
+            }
+            forward.advance(integers.back() + 1);
+            check(!forward.valid(), label + ", advance past the end");
+        }
+    }
+}
+
+static void codec64_round_trips()
+{
+    mt19937 random(2);
+    for (auto& name : CODEC64Factory::allNames())
+    {
+        unique_ptr<IntegerCODEC64> codec = CODEC64Factory::newFromName(name);
+        for (size_t length : lengths)
+        {
+            // Crosses a few high halves, ids of partitioned indexes.
+            vector<uint64_t> integers;
+            vector<uint32_t> lows = sorted_integers(length, random);
+            for (size_t i = 0; i < length; i++)
+            {
+                integers.push_back(static_cast<uint64_t>(i * 4 / length) << 32 | lows[i]);
+            }
+            string label = name + " with " + to_string(length) + " integers";
+
+            vector<uint32_t> compressed(4 * length + 1024);
+            size_t words = compressed.size();
+            codec->encodeArray(integers.data(), length, compressed.data(), words);
+            vector<uint64_t> decoded(length + 1024);
+            size_t count = decoded.size();
+            codec->decodeArray(compressed.data(), words, decoded.data(), count);
+            decoded.resize(count);
+            check(decoded == integers, label + " round trips");
+        }
+    }
+}
+
+static void ranked_postings_round_trips()
+{
+    mt19937 random(3);
+    for (size_t length : lengths)
+    {
+        vector<uint32_t> records = sorted_integers(length, random);
+        vector<uint32_t> frequencies(length);
+        vector<uint32_t> document_lengths(length);
+        for (size_t i = 0; i < length; i++)
+        {
+            frequencies[i] = 1 + random() % (i % 128 == 0 ? 1000 : 4);
+            document_lengths[i] = frequencies[i] + random() % 500;
+        }
+        string label = "ranked postings with " + to_string(length) + " records";
+
+        vector<uint8_t> value;
+        RankedPostings::Encode(records.data(), frequencies.data(), document_lengths.data(), length, value);
+        vector<uint32_t> decoded_records, decoded_frequencies, decoded_lengths;
+        RankedPostings::Decode(value.data(), value.size(), decoded_records, decoded_frequencies, decoded_lengths);
+        check(decoded_records == records, label + " round trip their records");
+        check(decoded_frequencies == frequencies, label + " round trip their frequencies");
+        for (size_t i = 0; i < length; i++)
+        {
+            check(decoded_lengths[i] <= document_lengths[i], label + " bound the length of " + to_string(records[i]));
+        }
+
+        for (size_t i = 0; i < length; i += (i % 128 == 0 || i % 128 == 127) ? 1 : 63)
+        {
+            RankedPostingsCursor cursor(value.data(), value.size());
+            cursor.NextGEQ(records[i] + 1);
+            check(i + 1 == length ? !cursor.Valid() : cursor.Record() == records[i + 1] && cursor.Frequency() == frequencies[i + 1],
+                  label + ", NextGEQ past " + to_string(records[i]));
+        }
+
+        // Appending the second half gives the same postings as encoding
+        // them all at once.
+        size_t half = length / 2;
+        vector<uint8_t> first;
+        vector<uint8_t> appended;
+        RankedPostings::Encode(records.data(), frequencies.data(), document_lengths.data(), half, first);
+        check(RankedPostings::Append(first.data(), first.size(), records.data() + half, frequencies.data() + half,
+                                     document_lengths.data() + half, length - half, appended),
+              label + " append");
+        RankedPostings::Decode(appended.data(), appended.size(), decoded_records, decoded_frequencies, decoded_lengths);
+        check(decoded_records == records && decoded_frequencies == frequencies, label + " after appending");
+        check(half == 0 || !RankedPostings::Append(appended.data(), appended.size(), records.data(), frequencies.data(),
+                                                   document_lengths.data(), 1, value),
+              label + " refuse to append a record they already hold");
+    }
+}
+
+static void fused_intersections()
+{
+    mt19937 random(4);
+    IntegerCODEC& codec = *CODECFactory::getFromName("s4-bp128-1");
+    for (size_t length : lengths)
+    {
+        vector<uint32_t> compressed_integers = sorted_integers(length, random);
+        vector<uint32_t> input(compressed_integers);
+        vector<uint32_t> compressed(2 * length + 1024);
+        size_t words = compressed.size();
+        codec.encodeArray(input.data(), length, compressed.data(), words);
+
+        // Sets much smaller, about as large and larger than the compressed
+        // list, drawn from around its values.
+        for (size_t set_length : { length / 16 + 1, length, 4 * length })
+        {
+            vector<uint32_t> set;
+            for (size_t i = 0; i < set_length; i++)
+            {
+                set.push_back(random() % (compressed_integers.back() + 2));
+            }
+            sort(set.begin(), set.end());
+            set.erase(unique(set.begin(), set.end()), set.end());
+            string label = "fused intersection of " + to_string(length) + " and " + to_string(set.size()) + " integers";
+
+            vector<uint32_t> expected(set.size());
+            expected.resize(SIMDintersection(set.data(), set.size(), compressed_integers.data(), compressed_integers.size(),
+                                             expected.data()));
+            vector<uint32_t> fused(set.size());
+            fused.resize(fusedintersection(compressed.data(), words, set.data(), set.size(), fused.data()));
+            check(fused == expected, label);
+            check(fusedintersectioncardinality(compressed.data(), words, set.data(), set.size()) == expected.size(),
+                  label + ", counted");
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    codec_round_trips();
+    codec64_round_trips();
+    ranked_postings_round_trips();
+    fused_intersections();
+    return failures == 0 ? 0 : 1;
+}
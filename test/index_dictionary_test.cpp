@@ -0,0 +1,88 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include "../src/hellcat.h"
+#include "../src/storage/store.h"
+#include "../src/storage/lmdb_store.h"
+#include "../src/indexing/index_dictionary.h"
+
+using namespace std;
+using namespace hellcat::storage;
+using namespace hellcat::indexing;
+
+static int failures = 0;
+
+static void check(bool condition, const string& message)
+{
+    if (!condition)
+    {
+        cerr << "FAILED: " << message << endl;
+        failures++;
+    }
+}
+
+static string term_name(uint32_t i)
+{
+    return "term" + to_string(i);
+}
+
+// Flushes enough batches through LMDB that lexicon levels carry more than
+// once, the emptied levels are rewritten every time.
+static void flush_batches(Store* store)
+{
+    const uint32_t batch_size = 4;
+    const uint32_t batches = 7;
+    const uint32_t terms = batch_size * batches;
+    vector<uint32_t> ids(terms);
+
+    IndexDictionary writer("dictionary_test", 16, batch_size);
+    for (uint32_t batch = 0; batch < batches; batch++)
+    {
+        hcat_transaction* tx;
+        store->begin_transaction(&tx, 0);
+        for (uint32_t i = batch * batch_size; i < (batch + 1) * batch_size; i++)
+        {
+            ids[i] = writer.AddTerm(term_name(i), tx);
+        }
+        writer.Flush(tx);
+        tx->commit();
+        delete tx;
+    }
+
+    // A new dictionary has nothing cached, every lookup reads the levels.
+    IndexDictionary reader("dictionary_test", 16, batch_size);
+    hcat_transaction* tx;
+    store->begin_transaction(&tx, 1);
+    for (uint32_t i = 0; i < terms; i++)
+    {
+        check(ids[i] != 0, "term id of " + term_name(i) + " is 0");
+        check(reader.GetTermId(term_name(i), tx) == ids[i], "term id of " + term_name(i) + " after flushing");
+    }
+    check(reader.GetTermId("missing", tx) == 0, "term id of a missing term");
+
+    vector<uint32_t> expanded;
+    reader.ExpandPrefix("term", tx, expanded);
+    check(expanded.size() == terms, "terms expanded from the prefix");
+    tx->abort();
+    delete tx;
+}
+
+int main(int argc, char* argv[])
+{
+    char path[] = "/tmp/hellcat_test_XXXXXX";
+    if (mkdtemp(path) == NULL)
+    {
+        cerr << "can't create " << path << endl;
+        return 1;
+    }
+
+    unique_ptr<Store> store(new LMDBStore());
+    store->open(path, false);
+
+    flush_batches(store.get());
+
+    store->close();
+    return failures == 0 ? 0 : 1;
+}
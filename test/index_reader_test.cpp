@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include "../src/hellcat.h"
+#include "../src/storage/store.h"
+#include "../src/storage/lmdb_store.h"
+#include "../src/indexing/bulk_index_builder.h"
+#include "../src/indexing/index_dictionary.h"
+#include "../src/indexing/index_reader.h"
+#include "../src/indexing/index_writer.h"
+
+using namespace std;
+using namespace hellcat::storage;
+using namespace hellcat::indexing;
+
+static int failures = 0;
+
+static void check(bool condition, const string& message)
+{
+    if (!condition)
+    {
+        cerr << "FAILED: " << message << endl;
+        failures++;
+    }
+}
+
+static vector<uint32_t> ids(const set<uint32_t>& records)
+{
+    return vector<uint32_t>(records.begin(), records.end());
+}
+
+// Small segments so the postings are split over sealed segments and the
+// open tail, some records deleted through the tombstones.
+static void and_or_with_tombstones(Store* store)
+{
+    IndexDictionary dictionary("reader_test_postings");
+    IndexWriter writer("reader_test_postings", &dictionary, NULL, 16);
+    IndexReader reader("reader_test_postings", &dictionary);
+    mt19937 random(1);
+    const char* terms[] = { "red", "green", "blue" };
+    map<string, set<uint32_t>> postings;
+    set<uint32_t> deleted;
+
+    hcat_transaction* tx;
+    store->begin_transaction(&tx, 0);
+    for (uint32_t record_id = 1; record_id <= 2000; record_id++)
+    {
+        for (auto term : terms)
+        {
+            if (random() % 2 == 0)
+            {
+                writer.SetRecord(term, record_id, tx);
+                postings[term].insert(record_id);
+            }
+        }
+        if (random() % 10 == 0)
+        {
+            writer.DeleteRecord(record_id, tx);
+            deleted.insert(record_id);
+        }
+    }
+    dictionary.Flush(tx);
+    tx->commit();
+    delete tx;
+
+    store->begin_transaction(&tx, 1);
+    set<uint32_t> red_and_green;
+    set<uint32_t> red_or_blue;
+    for (uint32_t record_id : postings["red"])
+    {
+        if (postings["green"].count(record_id) != 0 && deleted.count(record_id) == 0)
+        {
+            red_and_green.insert(record_id);
+        }
+    }
+    for (auto term : { "red", "blue" })
+    {
+        for (uint32_t record_id : postings[term])
+        {
+            if (deleted.count(record_id) == 0)
+            {
+                red_or_blue.insert(record_id);
+            }
+        }
+    }
+
+    vector<uint32_t> record_ids;
+    reader.And({ "red", "green" }, tx, record_ids);
+    check(record_ids == ids(red_and_green), "red and green without the deleted records");
+    reader.Or({ "red", "blue" }, tx, record_ids);
+    check(record_ids == ids(red_or_blue), "red or blue without the deleted records");
+    reader.And({ "red", "missing" }, tx, record_ids);
+    check(record_ids.empty(), "red and a missing term");
+    tx->abort();
+    delete tx;
+}
+
+static const float bm25_k1 = 1.2f;
+static const float bm25_b = 0.75f;
+
+// TopK prunes with block maxima, its best scores have to be the ones
+// scoring every document finds.
+static void top_k_matches_bm25(Store* store)
+{
+    IndexDictionary dictionary("reader_test_ranked");
+    BulkIndexBuilder builder("reader_test_ranked", &dictionary, 2, 100, true);
+    IndexWriter writer("reader_test_ranked", &dictionary);
+    IndexReader reader("reader_test_ranked", &dictionary);
+    mt19937 random(2);
+    const char* words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+    const uint32_t documents = 3000;
+
+    vector<map<string, uint32_t>> frequencies(documents + 1);
+    vector<uint32_t> lengths(documents + 1);
+    for (uint32_t record_id = 1; record_id <= documents; record_id++)
+    {
+        // Skewed so the common words fill blocks and the rare ones don't.
+        string text;
+        uint32_t length = 1 + random() % 30;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            string word = words[min(random() % 6, random() % 6)];
+            text += word + " ";
+            frequencies[record_id][word]++;
+        }
+        lengths[record_id] = length;
+        builder.AddDocument(record_id, text);
+    }
+
+    hcat_transaction* tx;
+    store->begin_transaction(&tx, 0);
+    builder.Finish(tx);
+    set<uint32_t> deleted;
+    for (uint32_t record_id = 7; record_id <= documents; record_id += 13)
+    {
+        writer.DeleteRecord(record_id, tx);
+        deleted.insert(record_id);
+    }
+    tx->commit();
+    delete tx;
+
+    float total_length = 0;
+    map<string, float> document_frequencies;
+    for (uint32_t record_id = 1; record_id <= documents; record_id++)
+    {
+        total_length += lengths[record_id];
+        for (auto& word : frequencies[record_id])
+        {
+            document_frequencies[word.first]++;
+        }
+    }
+    float average_length = total_length / documents;
+
+    vector<vector<string>> queries = { { "alpha" }, { "zeta" }, { "beta", "epsilon" }, { "alpha", "delta", "zeta" } };
+    store->begin_transaction(&tx, 1);
+    for (auto& query : queries)
+    {
+        string label = "top 10 of";
+        vector<float> expected;
+        for (uint32_t record_id = 1; record_id <= documents; record_id++)
+        {
+            float score = 0;
+            for (auto& word : query)
+            {
+                auto frequency = frequencies[record_id].find(word);
+                if (frequency == frequencies[record_id].end())
+                {
+                    continue;
+                }
+                float df = document_frequencies[word];
+                float idf = log(1.0f + (documents - df + 0.5f) / (df + 0.5f));
+                float norm = bm25_k1 * (1.0f - bm25_b + bm25_b * lengths[record_id] / average_length);
+                score += idf * frequency->second * (bm25_k1 + 1.0f) / (frequency->second + norm);
+            }
+            if (score > 0 && deleted.count(record_id) == 0)
+            {
+                expected.push_back(score);
+            }
+        }
+        sort(expected.rbegin(), expected.rend());
+        expected.resize(min(expected.size(), static_cast<size_t>(10)));
+
+        vector<string_ref> terms;
+        for (auto& word : query)
+        {
+            label += " " + word;
+            terms.push_back(word);
+        }
+        vector<scored_record> results;
+        reader.TopK(terms, 10, tx, results);
+        check(results.size() == expected.size(), label + " has every result");
+        for (size_t i = 0; i < results.size() && i < expected.size(); i++)
+        {
+            check(fabs(results[i].score - expected[i]) <= 1e-4f * expected[i], label + ", score " + to_string(i));
+            check(deleted.count(results[i].record_id) == 0, label + " leaves out deleted records");
+        }
+    }
+    tx->abort();
+    delete tx;
+}
+
+int main(int argc, char* argv[])
+{
+    char path[] = "/tmp/hellcat_test_XXXXXX";
+    if (mkdtemp(path) == NULL)
+    {
+        cerr << "can't create " << path << endl;
+        return 1;
+    }
+
+    unique_ptr<Store> store(new LMDBStore());
+    store->open(path, false);
+
+    and_or_with_tombstones(store.get());
+    top_k_matches_bm25(store.get());
+
+    store->close();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include "../src/hellcat.h"
+#include "../src/storage/store.h"
+#include "../src/storage/lmdb_store.h"
+#include "../src/indexing/index_dictionary.h"
+#include "../src/indexing/index_reader.h"
+#include "../src/indexing/index_writer.h"
+#include "../src/indexing/segment_merger.h"
+
+using namespace std;
+using namespace hellcat::storage;
+using namespace hellcat::indexing;
+
+static int failures = 0;
+
+static void check(bool condition, const string& message)
+{
+    if (!condition)
+    {
+        cerr << "FAILED: " << message << endl;
+        failures++;
+    }
+}
+
+// The merger encodes outside the write transaction, meanwhile the writer
+// keeps sealing segments and removing records from them. A merge swapped
+// in over a segment that changed under it would bring removed records
+// back or lose added ones.
+static void merges_race_removes(Store* store)
+{
+    IndexDictionary dictionary("merger_test");
+    SegmentMerger merger(store, "merger_test", 4, 1 << 30, 100);
+    IndexWriter writer("merger_test", &dictionary, &merger, 8);
+    IndexReader reader("merger_test", &dictionary);
+    mt19937 random(1);
+    set<uint32_t> postings;
+    merger.Start();
+
+    uint32_t next_record = 1;
+    vector<uint32_t> added;
+    for (uint32_t batch = 0; batch < 1000; batch++)
+    {
+        hcat_transaction* tx;
+        store->begin_transaction(&tx, 0);
+        // Often takes the newest segment out whole before sealing the
+        // next one, which must not come back under the same id.
+        if (random() % 2 == 0)
+        {
+            for (uint32_t record_id : added)
+            {
+                writer.RemoveRecord("term", record_id, tx);
+                postings.erase(record_id);
+            }
+        }
+        added.clear();
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            writer.SetRecord("term", next_record, tx);
+            postings.insert(next_record);
+            added.push_back(next_record++);
+        }
+        dictionary.Flush(tx);
+        tx->commit();
+        delete tx;
+    }
+    this_thread::sleep_for(chrono::milliseconds(200));
+    merger.Stop();
+
+    hcat_transaction* tx;
+    store->begin_transaction(&tx, 1);
+    vector<uint32_t> record_ids;
+    reader.Or({ "term" }, tx, record_ids);
+    check(record_ids == vector<uint32_t>(postings.begin(), postings.end()), "postings after merging while removing records");
+    check(merger.GetStats().merges > 0, "segments were merged");
+    tx->abort();
+    delete tx;
+}
+
+int main(int argc, char* argv[])
+{
+    char path[] = "/tmp/hellcat_test_XXXXXX";
+    if (mkdtemp(path) == NULL)
+    {
+        cerr << "can't create " << path << endl;
+        return 1;
+    }
+
+    unique_ptr<Store> store(new LMDBStore());
+    store->open(path, false);
+
+    merges_race_removes(store.get());
+
+    store->close();
+    return failures == 0 ? 0 : 1;
+}